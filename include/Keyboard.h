@@ -31,15 +31,29 @@
 #ifndef DESKTOP_KEYBOARD_H
 # define DESKTOP_KEYBOARD_H
 
+# include <stdint.h>
+
 
 /* Keyboard */
 /* types */
 typedef enum _KeyboardMessage
 {
 	KEYBOARD_MESSAGE_SET_PAGE = 0,
-	KEYBOARD_MESSAGE_SET_VISIBLE
+	KEYBOARD_MESSAGE_SET_VISIBLE,
+	KEYBOARD_MESSAGE_TYPE_TEXT,
+	KEYBOARD_MESSAGE_GET_STATS,
+	KEYBOARD_MESSAGE_BATCH,
+	KEYBOARD_MESSAGE_TYPE_STRING
 } KeyboardMessage;
 
+/* the layouts of a page */
+typedef enum _KeyboardSection
+{
+	KEYBOARD_SECTION_LETTERS = 0,
+	KEYBOARD_SECTION_KEYPAD,
+	KEYBOARD_SECTION_SPECIAL
+} KeyboardSection;
+
 typedef enum _KeyboardPage
 {
 	KEYBOARD_PAGE_DEFAULT = 0,
@@ -47,8 +61,82 @@ typedef enum _KeyboardPage
 	KEYBOARD_PAGE_URL
 } KeyboardPage;
 
+/* latency statistics */
+typedef enum _KeyboardStatsStage
+{
+	KEYBOARD_STATS_TAP = 0,		/* button release to injection */
+	KEYBOARD_STATS_INJECT,		/* activation to injection */
+	KEYBOARD_STATS_ACK,		/* injection to server reply */
+	KEYBOARD_STATS_SHOW		/* showing to the first frame */
+} KeyboardStatsStage;
+# define KEYBOARD_STATS_LAST	KEYBOARD_STATS_SHOW
+# define KEYBOARD_STATS_COUNT	(KEYBOARD_STATS_LAST + 1)
+
+/* the durations are in microseconds */
+typedef enum _KeyboardStatsValue
+{
+	KEYBOARD_STATS_VALUE_SAMPLES = 0,
+	KEYBOARD_STATS_VALUE_P50,
+	KEYBOARD_STATS_VALUE_P99,
+	KEYBOARD_STATS_VALUE_MAX
+} KeyboardStatsValue;
+# define KEYBOARD_STATS_VALUE_LAST	KEYBOARD_STATS_VALUE_MAX
+# define KEYBOARD_STATS_VALUE_COUNT	(KEYBOARD_STATS_VALUE_LAST + 1)
+
+/* the control socket takes the messages as requests, and answers each of
+ * them in order with a reply followed by as many values as announced */
+typedef struct _KeyboardControlRequest
+{
+	uint32_t message;		/* KeyboardMessage */
+	uint32_t value1;
+	uint32_t value2;
+} KeyboardControlRequest;
+
+typedef struct _KeyboardControlReply
+{
+	int32_t status;			/* 0 on success, -1 otherwise */
+	uint32_t count;			/* the values following */
+} KeyboardControlReply;
+
 
 /* constants */
 # define KEYBOARD_CLIENT_MESSAGE	"DEFORAOS_DESKTOP_KEYBOARD_CLIENT"
 
+/* KEYBOARD_MESSAGE_TYPE_TEXT carries up to 4 bytes of UTF-8 in its first
+ * argument, and their count in the second one; the text is typed once the
+ * last chunk is flagged */
+# define KEYBOARD_TEXT_CHUNK		4
+# define KEYBOARD_TEXT_LAST		0x100
+/* the longest text typed at once, in bytes */
+# define KEYBOARD_TEXT_MAX		65536
+
+/* KEYBOARD_MESSAGE_GET_STATS is answered on this channel, with one message
+ * per stage and value: the stage, the value and then the value itself; the
+ * number of times the keymap was reloaded comes first, as an extra stage */
+# define KEYBOARD_STATS_MESSAGE	"DEFORAOS_DESKTOP_KEYBOARD_STATS"
+# define KEYBOARD_STATS_KEYMAP	KEYBOARD_STATS_COUNT
+
+/* KEYBOARD_MESSAGE_BATCH applies the changes flagged in its first argument
+ * at once, with their values packed in the second one: the modifiers held
+ * are released, the page and then the layout are selected, and the keyboard
+ * is hidden first or shown last, so that it is only redrawn once */
+# define KEYBOARD_BATCH_PAGE		0x1	/* KeyboardPage */
+# define KEYBOARD_BATCH_LAYOUT		0x2	/* KeyboardSection */
+# define KEYBOARD_BATCH_MODIFIERS	0x4	/* no value */
+# define KEYBOARD_BATCH_VISIBLE		0x8	/* 0 or 1 */
+# define KEYBOARD_BATCH_PAGE_SHIFT	0
+# define KEYBOARD_BATCH_LAYOUT_SHIFT	8
+# define KEYBOARD_BATCH_VISIBLE_SHIFT	16
+# define KEYBOARD_BATCH_VALUE(values, field) \
+	(((values) >> KEYBOARD_BATCH_ ## field ## _SHIFT) & 0xff)
+
+/* the control socket is created in $XDG_RUNTIME_DIR, or else in /tmp for
+ * every user, and only serves the user running the keyboard;
+ * KEYBOARD_MESSAGE_GET_STATS is answered with the values for every stage in
+ * turn, instead of messages, followed by the number of times the keymap was
+ * reloaded, and KEYBOARD_MESSAGE_TYPE_STRING is followed by
+ * as many bytes of UTF-8 as its first argument, typed at once */
+# define KEYBOARD_CONTROL_SOCKET	"keyboard.sock"
+# define KEYBOARD_CONTROL_SOCKET_TMP	"/tmp/keyboard-%lu.sock"
+
 #endif /* !DESKTOP_KEYBOARD_H */
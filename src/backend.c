@@ -0,0 +1,463 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+#include <sys/types.h>
+#ifdef __linux__
+# include <sys/ioctl.h>
+# include <linux/uinput.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <gdk/gdkx.h>
+#include <System.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/XTest.h>
+#include "backend.h"
+#include "../config.h"
+
+#ifndef PROGNAME_KEYBOARD
+# define PROGNAME_KEYBOARD	"keyboard"
+#endif
+
+
+/* KeyboardBackend */
+/* private */
+/* constants */
+#ifdef __linux__
+/* the X keycodes are offset by 8 from the evdev codes */
+# define KEYBOARD_BACKEND_UINPUT_OFFSET	8
+# define KEYBOARD_BACKEND_UINPUT_KEYS	(256 - KEYBOARD_BACKEND_UINPUT_OFFSET)
+# define KEYBOARD_BACKEND_UINPUT_EVENTS	64
+#endif
+
+
+/* types */
+typedef struct _KeyboardBackendDefinition
+{
+	char const * name;
+	unsigned int capabilities;
+	int (*init)(KeyboardBackend * backend);
+	void (*destroy)(KeyboardBackend * backend);
+	int (*event)(KeyboardBackend * backend, unsigned int keycode,
+			int pressed);
+	int (*flush)(KeyboardBackend * backend);
+} KeyboardBackendDefinition;
+
+struct _KeyboardBackend
+{
+	KeyboardBackendDefinition const * definition;
+	guint source;
+
+	/* xtest */
+	Display * display;
+
+#ifdef __linux__
+	/* uinput */
+	int fd;
+	struct input_event events[KEYBOARD_BACKEND_UINPUT_EVENTS];
+	size_t events_cnt;
+	/* the keys changed since the last report */
+	uint32_t frame[(KEYBOARD_BACKEND_UINPUT_KEYS + 31) / 32];
+#endif
+
+	/* null */
+	unsigned long presses;
+	unsigned long releases;
+	unsigned long flushes;
+};
+
+
+/* prototypes */
+/* callbacks */
+static gboolean _keyboard_backend_on_flush(gpointer data);
+
+/* xtest */
+static int _keyboard_backend_xtest_init(KeyboardBackend * backend);
+static void _keyboard_backend_xtest_destroy(KeyboardBackend * backend);
+static int _keyboard_backend_xtest_event(KeyboardBackend * backend,
+		unsigned int keycode, int pressed);
+static int _keyboard_backend_xtest_flush(KeyboardBackend * backend);
+
+#ifdef __linux__
+/* uinput */
+static int _keyboard_backend_uinput_init(KeyboardBackend * backend);
+static void _keyboard_backend_uinput_destroy(KeyboardBackend * backend);
+static int _keyboard_backend_uinput_event(KeyboardBackend * backend,
+		unsigned int keycode, int pressed);
+static int _keyboard_backend_uinput_flush(KeyboardBackend * backend);
+#endif
+
+/* null */
+static void _keyboard_backend_null_destroy(KeyboardBackend * backend);
+static int _keyboard_backend_null_event(KeyboardBackend * backend,
+		unsigned int keycode, int pressed);
+static int _keyboard_backend_null_flush(KeyboardBackend * backend);
+
+
+/* constants */
+/* the first one is the default */
+static const KeyboardBackendDefinition _keyboard_backend_definitions[] =
+{
+	{ "xtest", KBC_BATCH | KBC_SERVER, _keyboard_backend_xtest_init,
+		_keyboard_backend_xtest_destroy,
+		_keyboard_backend_xtest_event, _keyboard_backend_xtest_flush },
+#ifdef __linux__
+	{ "uinput", KBC_BATCH, _keyboard_backend_uinput_init,
+		_keyboard_backend_uinput_destroy,
+		_keyboard_backend_uinput_event,
+		_keyboard_backend_uinput_flush },
+#endif
+	{ "null", KBC_RECORD, NULL, _keyboard_backend_null_destroy,
+		_keyboard_backend_null_event, _keyboard_backend_null_flush }
+};
+
+
+/* public */
+/* functions */
+/* keyboard_backend_new */
+KeyboardBackend * keyboard_backend_new(char const * name)
+{
+	KeyboardBackend * backend;
+	KeyboardBackendDefinition const * definition = NULL;
+	size_t i;
+
+	for(i = 0; i < sizeof(_keyboard_backend_definitions)
+			/ sizeof(*_keyboard_backend_definitions); i++)
+		if(name == NULL || strcmp(_keyboard_backend_definitions[i].name,
+					name) == 0)
+		{
+			definition = &_keyboard_backend_definitions[i];
+			break;
+		}
+	if(definition == NULL)
+	{
+		error_set_code(1, "%s: %s", name, "Unknown backend");
+		return NULL;
+	}
+	if((backend = malloc(sizeof(*backend))) == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		return NULL;
+	}
+	memset(backend, 0, sizeof(*backend));
+	backend->definition = definition;
+#ifdef __linux__
+	backend->fd = -1;
+#endif
+	if(definition->init != NULL && definition->init(backend) != 0)
+	{
+		free(backend);
+		return NULL;
+	}
+	return backend;
+}
+
+
+/* keyboard_backend_delete */
+void keyboard_backend_delete(KeyboardBackend * backend)
+{
+	if(backend->source != 0)
+		keyboard_backend_flush(backend);
+	if(backend->definition->destroy != NULL)
+		backend->definition->destroy(backend);
+	free(backend);
+}
+
+
+/* accessors */
+/* keyboard_backend_get_capabilities */
+unsigned int keyboard_backend_get_capabilities(KeyboardBackend * backend)
+{
+	return backend->definition->capabilities;
+}
+
+
+/* keyboard_backend_get_name */
+char const * keyboard_backend_get_name(KeyboardBackend * backend)
+{
+	return backend->definition->name;
+}
+
+
+/* useful */
+/* keyboard_backend_press */
+int keyboard_backend_press(KeyboardBackend * backend, unsigned int keycode)
+{
+	return backend->definition->event(backend, keycode, 1);
+}
+
+
+/* keyboard_backend_release */
+int keyboard_backend_release(KeyboardBackend * backend, unsigned int keycode)
+{
+	return backend->definition->event(backend, keycode, 0);
+}
+
+
+/* keyboard_backend_flush */
+int keyboard_backend_flush(KeyboardBackend * backend)
+{
+	if(backend->source != 0)
+	{
+		g_source_remove(backend->source);
+		backend->source = 0;
+	}
+	return backend->definition->flush(backend);
+}
+
+
+/* keyboard_backend_flush_idle */
+void keyboard_backend_flush_idle(KeyboardBackend * backend)
+{
+	/* flush once per iteration of the main loop, before redrawing */
+	if(backend->source == 0)
+		backend->source = g_idle_add_full(G_PRIORITY_HIGH_IDLE,
+				_keyboard_backend_on_flush, backend, NULL);
+}
+
+
+/* private */
+/* functions */
+/* xtest */
+/* keyboard_backend_xtest_init */
+static int _keyboard_backend_xtest_init(KeyboardBackend * backend)
+{
+	int event;
+	int error;
+	int major;
+	int minor;
+
+	backend->display = gdk_x11_get_default_xdisplay();
+	if(XTestQueryExtension(backend->display, &event, &error, &major,
+				&minor) != True)
+		return -error_set_code(1, "%s: %s", "xtest",
+				"The XTEST extension is not available");
+	/* let the events through the grabs for the whole session */
+	XTestGrabControl(backend->display, True);
+	return 0;
+}
+
+
+/* keyboard_backend_xtest_destroy */
+static void _keyboard_backend_xtest_destroy(KeyboardBackend * backend)
+{
+	XTestGrabControl(backend->display, False);
+	XFlush(backend->display);
+}
+
+
+/* keyboard_backend_xtest_event */
+static int _keyboard_backend_xtest_event(KeyboardBackend * backend,
+		unsigned int keycode, int pressed)
+{
+	/* queued by Xlib until flushed */
+	XTestFakeKeyEvent(backend->display, keycode, pressed ? True : False,
+			CurrentTime);
+	return 0;
+}
+
+
+/* keyboard_backend_xtest_flush */
+static int _keyboard_backend_xtest_flush(KeyboardBackend * backend)
+{
+	XFlush(backend->display);
+	return 0;
+}
+
+
+#ifdef __linux__
+/* uinput */
+/* keyboard_backend_uinput_init */
+static int _keyboard_backend_uinput_init(KeyboardBackend * backend)
+{
+	char const * devices[] = { "/dev/uinput", "/dev/input/uinput" };
+	struct uinput_user_dev dev;
+	size_t i;
+	int code;
+
+	for(i = 0; backend->fd < 0
+			&& i < sizeof(devices) / sizeof(*devices); i++)
+		backend->fd = open(devices[i], O_WRONLY | O_CLOEXEC);
+	if(backend->fd < 0)
+		return -error_set_code(1, "%s: %s", devices[0],
+				strerror(errno));
+	code = KEY_ESC;
+	if(ioctl(backend->fd, UI_SET_EVBIT, EV_KEY) == 0
+			&& ioctl(backend->fd, UI_SET_EVBIT, EV_SYN) == 0)
+		for(; code < KEYBOARD_BACKEND_UINPUT_KEYS; code++)
+			if(ioctl(backend->fd, UI_SET_KEYBIT, code) != 0)
+				break;
+	memset(&dev, 0, sizeof(dev));
+	snprintf(dev.name, sizeof(dev.name), "%s", PACKAGE);
+	dev.id.bustype = BUS_VIRTUAL;
+	dev.id.version = 1;
+	if(code < KEYBOARD_BACKEND_UINPUT_KEYS
+			|| write(backend->fd, &dev, sizeof(dev))
+			!= (ssize_t)sizeof(dev)
+			|| ioctl(backend->fd, UI_DEV_CREATE) != 0)
+	{
+		error_set_code(1, "%s: %s", "uinput", strerror(errno));
+		close(backend->fd);
+		return -1;
+	}
+	backend->events_cnt = 0;
+	memset(backend->frame, 0, sizeof(backend->frame));
+	return 0;
+}
+
+
+/* keyboard_backend_uinput_destroy */
+static void _keyboard_backend_uinput_destroy(KeyboardBackend * backend)
+{
+	_keyboard_backend_uinput_flush(backend);
+	ioctl(backend->fd, UI_DEV_DESTROY);
+	close(backend->fd);
+}
+
+
+/* keyboard_backend_uinput_event */
+static void _uinput_event_queue(KeyboardBackend * backend, unsigned int type,
+		unsigned int code, int value);
+
+static int _keyboard_backend_uinput_event(KeyboardBackend * backend,
+		unsigned int keycode, int pressed)
+{
+	unsigned int code;
+	uint32_t bit;
+
+	if(keycode <= KEYBOARD_BACKEND_UINPUT_OFFSET
+			|| keycode >= KEYBOARD_BACKEND_UINPUT_OFFSET
+			+ KEYBOARD_BACKEND_UINPUT_KEYS)
+		return -error_set_code(1, "%u: %s", keycode,
+				"Unsupported keycode");
+	code = keycode - KEYBOARD_BACKEND_UINPUT_OFFSET;
+	bit = 1 << (code % 32);
+	/* keep room for a report before and after the event */
+	if(backend->events_cnt + 3 > KEYBOARD_BACKEND_UINPUT_EVENTS
+			&& _keyboard_backend_uinput_flush(backend) != 0)
+		return -1;
+	/* a key only changes once per report */
+	if(backend->frame[code / 32] & bit)
+	{
+		_uinput_event_queue(backend, EV_SYN, SYN_REPORT, 0);
+		memset(backend->frame, 0, sizeof(backend->frame));
+	}
+	_uinput_event_queue(backend, EV_KEY, code, pressed ? 1 : 0);
+	backend->frame[code / 32] |= bit;
+	return 0;
+}
+
+static void _uinput_event_queue(KeyboardBackend * backend, unsigned int type,
+		unsigned int code, int value)
+{
+	struct input_event * event;
+
+	/* the kernel sets the time */
+	event = &backend->events[backend->events_cnt++];
+	memset(event, 0, sizeof(*event));
+	event->type = type;
+	event->code = code;
+	event->value = value;
+}
+
+
+/* keyboard_backend_uinput_flush */
+static int _keyboard_backend_uinput_flush(KeyboardBackend * backend)
+{
+	size_t size;
+	ssize_t res;
+
+	if(backend->events_cnt == 0)
+		return 0;
+	_uinput_event_queue(backend, EV_SYN, SYN_REPORT, 0);
+	/* send every report in a single write */
+	size = sizeof(*backend->events) * backend->events_cnt;
+	res = write(backend->fd, backend->events, size);
+	backend->events_cnt = 0;
+	memset(backend->frame, 0, sizeof(backend->frame));
+	if(res < 0)
+		return -error_set_code(1, "%s: %s", "uinput", strerror(errno));
+	if((size_t)res != size)
+		return -error_set_code(1, "%s: %s", "uinput", "Short write");
+	return 0;
+}
+#endif
+
+
+/* null */
+/* keyboard_backend_null_destroy */
+static void _keyboard_backend_null_destroy(KeyboardBackend * backend)
+{
+	fprintf(stderr, "%s: %s: %lu presses, %lu releases, %lu flushes\n",
+			PROGNAME_KEYBOARD, backend->definition->name,
+			backend->presses, backend->releases, backend->flushes);
+}
+
+
+/* keyboard_backend_null_event */
+static int _keyboard_backend_null_event(KeyboardBackend * backend,
+		unsigned int keycode, int pressed)
+{
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s(%u, %d)\n", __func__, keycode, pressed);
+#else
+	(void) keycode;
+#endif
+	if(pressed)
+		backend->presses++;
+	else
+		backend->releases++;
+	return 0;
+}
+
+
+/* keyboard_backend_null_flush */
+static int _keyboard_backend_null_flush(KeyboardBackend * backend)
+{
+	backend->flushes++;
+	return 0;
+}
+
+
+/* callbacks */
+/* keyboard_backend_on_flush */
+static gboolean _keyboard_backend_on_flush(gpointer data)
+{
+	KeyboardBackend * backend = data;
+
+	backend->source = 0;
+	if(backend->definition->flush(backend) != 0)
+		error_print(PROGNAME_KEYBOARD);
+	return FALSE;
+}
@@ -0,0 +1,62 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+#ifndef KEYBOARD_BACKEND_H
+# define KEYBOARD_BACKEND_H
+
+
+/* KeyboardBackend */
+/* types */
+typedef struct _KeyboardBackend KeyboardBackend;
+
+typedef enum _KeyboardBackendCapability
+{
+	KBC_NONE	= 0x0,
+	KBC_BATCH	= 0x1,	/* the events are only sent when flushed */
+	KBC_SERVER	= 0x2,	/* the events go through the X connection */
+	KBC_RECORD	= 0x4	/* the events are only recorded */
+} KeyboardBackendCapability;
+
+
+/* functions */
+KeyboardBackend * keyboard_backend_new(char const * name);
+void keyboard_backend_delete(KeyboardBackend * backend);
+
+/* accessors */
+unsigned int keyboard_backend_get_capabilities(KeyboardBackend * backend);
+char const * keyboard_backend_get_name(KeyboardBackend * backend);
+
+/* useful */
+/* the keycodes are those of the X server */
+int keyboard_backend_press(KeyboardBackend * backend, unsigned int keycode);
+int keyboard_backend_release(KeyboardBackend * backend, unsigned int keycode);
+int keyboard_backend_flush(KeyboardBackend * backend);
+void keyboard_backend_flush_idle(KeyboardBackend * backend);
+
+#endif /* !KEYBOARD_BACKEND_H */
@@ -33,6 +33,12 @@
 #include "callbacks.h"
 
 
+/* private */
+/* prototypes */
+static void _on_keyboard_message_batch(Keyboard * keyboard, uint32_t changes,
+		uint32_t values);
+
+
 /* public */
 /* functions */
 /* on_keyboard_delete_event */
@@ -60,6 +66,9 @@ int on_keyboard_message(void * data, uint32_t value1, uint32_t value2,
 {
 	Keyboard * keyboard = data;
 	KeyboardMessage message = value1;
+	char buf[KEYBOARD_TEXT_CHUNK];
+	size_t i;
+	size_t len;
 
 	switch(message)
 	{
@@ -69,10 +78,48 @@ int on_keyboard_message(void * data, uint32_t value1, uint32_t value2,
 		case KEYBOARD_MESSAGE_SET_VISIBLE:
 			keyboard_show(keyboard, (value2 != 0) ? TRUE : FALSE);
 			break;
+		case KEYBOARD_MESSAGE_TYPE_TEXT:
+			/* the bytes are packed from the lowest */
+			for(i = 0; i < sizeof(buf); i++)
+				buf[i] = (value2 >> (i * 8)) & 0xff;
+			if((len = value3 & 0xff) > sizeof(buf))
+				len = sizeof(buf);
+			keyboard_type_chunk(keyboard, buf, len,
+					(value3 & KEYBOARD_TEXT_LAST)
+					? TRUE : FALSE);
+			break;
+		case KEYBOARD_MESSAGE_GET_STATS:
+			keyboard_send_stats(keyboard);
+			break;
+		case KEYBOARD_MESSAGE_BATCH:
+			_on_keyboard_message_batch(keyboard, value2, value3);
+			break;
+		case KEYBOARD_MESSAGE_TYPE_STRING:
+			/* only through the control socket */
+			break;
 	}
 	return 0;
 }
 
+static void _on_keyboard_message_batch(Keyboard * keyboard, uint32_t changes,
+		uint32_t values)
+{
+	gboolean visible = KEYBOARD_BATCH_VALUE(values, VISIBLE) ? TRUE : FALSE;
+
+	/* not redrawn in between */
+	if((changes & KEYBOARD_BATCH_VISIBLE) && visible == FALSE)
+		keyboard_show(keyboard, FALSE);
+	if(changes & KEYBOARD_BATCH_MODIFIERS)
+		keyboard_release_modifiers(keyboard);
+	if(changes & KEYBOARD_BATCH_PAGE)
+		keyboard_set_page(keyboard, KEYBOARD_BATCH_VALUE(values, PAGE));
+	if(changes & KEYBOARD_BATCH_LAYOUT)
+		keyboard_set_layout(keyboard, KEYBOARD_BATCH_VALUE(values,
+					LAYOUT));
+	if((changes & KEYBOARD_BATCH_VISIBLE) && visible == TRUE)
+		keyboard_show(keyboard, TRUE);
+}
+
 
 /* on_keyboard_set_layout_keypad */
 void on_keyboard_set_layout_keypad(gpointer data)
@@ -34,6 +34,25 @@
 
 /* public */
 /* functions */
+/* keysym_get_modifier */
+unsigned int keysym_get_modifier(unsigned int keysym)
+{
+	switch(keysym)
+	{
+		case XK_Shift_L:
+		case XK_Shift_R:
+			return KM_SHIFT;
+		case XK_Alt_R:
+		case XK_ISO_Level3_Shift:
+		case XK_Mode_switch:
+			return KM_LEVEL3;
+		case XK_Num_Lock:
+			return KM_NUMLOCK;
+	}
+	return KM_NONE;
+}
+
+
 /* keysym_is_modifier */
 int keysym_is_modifier(unsigned int keysym)
 {
@@ -41,6 +60,8 @@ int keysym_is_modifier(unsigned int keysym)
 		return 1;
 	if(keysym == XK_Control_L || keysym == XK_Control_R)
 		return 1;
+	if(keysym == XK_ISO_Level3_Shift || keysym == XK_Mode_switch)
+		return 1;
 	if(keysym == XK_Num_Lock)
 		return 1;
 	if(keysym == XK_Shift_L || keysym == XK_Shift_R)
@@ -33,7 +33,20 @@
 
 
 /* public */
+/* types */
+/* modifiers (masks) */
+typedef enum _KeyboardModifier
+{
+	KM_NONE = 0x0,
+	KM_SHIFT = 0x1,
+	KM_LEVEL3 = 0x2,
+	KM_NUMLOCK = 0x4
+} KeyboardModifier;
+# define KM_COUNT	0x8
+
+
 /* functions */
+unsigned int keysym_get_modifier(unsigned int keysym);
 int keysym_is_modifier(unsigned int keysym);
 
 #endif /* !KEYBOARD_COMMON_H */
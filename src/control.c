@@ -0,0 +1,486 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <System.h>
+#include "callbacks.h"
+#include "control.h"
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL	0
+#endif
+
+
+/* KeyboardControl */
+/* private */
+/* types */
+typedef struct _KeyboardControlClient
+{
+	KeyboardControl * control;
+	int fd;
+	guint source;
+
+	/* the request being received */
+	KeyboardControlRequest request;
+	size_t request_cnt;
+
+	/* the text of this client only, and how much more is expected */
+	char * text;
+	size_t text_cnt;
+	size_t text_left;
+} KeyboardControlClient;
+
+struct _KeyboardControl
+{
+	Keyboard * keyboard;
+	struct sockaddr_un address;
+	int fd;
+	guint source;
+
+	KeyboardControlClient ** clients;
+	size_t clients_cnt;
+};
+
+typedef struct _KeyboardControlAnswer
+{
+	KeyboardControlReply reply;
+	uint32_t values[KEYBOARD_STATS_COUNT * KEYBOARD_STATS_VALUE_COUNT + 1];
+} KeyboardControlAnswer;
+
+
+/* prototypes */
+static int _control_bind(KeyboardControl * control);
+static int _control_client_add(KeyboardControl * control, int fd);
+static void _control_client_remove(KeyboardControl * control,
+		KeyboardControlClient * client);
+static size_t _control_dispatch(KeyboardControlClient * client,
+		KeyboardControlAnswer * answer);
+static int _control_path(char * path, size_t size);
+static int _control_peer(int fd);
+static int _control_text(KeyboardControlClient * client, char const * buf,
+		size_t len);
+static int _control_type(KeyboardControlClient * client);
+
+/* callbacks */
+static gboolean _control_on_accept(GIOChannel * source,
+		GIOCondition condition, gpointer data);
+static gboolean _control_on_client(GIOChannel * source,
+		GIOCondition condition, gpointer data);
+
+
+/* public */
+/* functions */
+/* keyboard_control_new */
+KeyboardControl * keyboard_control_new(Keyboard * keyboard)
+{
+	KeyboardControl * control;
+	GIOChannel * channel;
+
+	if((control = malloc(sizeof(*control))) == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		return NULL;
+	}
+	control->keyboard = keyboard;
+	memset(&control->address, 0, sizeof(control->address));
+	control->address.sun_family = AF_UNIX;
+	control->source = 0;
+	control->clients = NULL;
+	control->clients_cnt = 0;
+	if(_control_path(control->address.sun_path,
+				sizeof(control->address.sun_path)) != 0)
+	{
+		free(control);
+		return NULL;
+	}
+	if((control->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+			|| fcntl(control->fd, F_SETFD, FD_CLOEXEC) != 0
+			|| fcntl(control->fd, F_SETFL, O_NONBLOCK) != 0)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		if(control->fd >= 0)
+			close(control->fd);
+		free(control);
+		return NULL;
+	}
+	if(_control_bind(control) != 0)
+	{
+		close(control->fd);
+		free(control);
+		return NULL;
+	}
+	channel = g_io_channel_unix_new(control->fd);
+	control->source = g_io_add_watch(channel, G_IO_IN, _control_on_accept,
+			control);
+	g_io_channel_unref(channel);
+	return control;
+}
+
+
+/* keyboard_control_delete */
+void keyboard_control_delete(KeyboardControl * control)
+{
+	while(control->clients_cnt > 0)
+		_control_client_remove(control, control->clients[0]);
+	free(control->clients);
+	if(control->source != 0)
+		g_source_remove(control->source);
+	close(control->fd);
+	unlink(control->address.sun_path);
+	free(control);
+}
+
+
+/* private */
+/* functions */
+/* control_bind */
+static int _control_bind(KeyboardControl * control)
+{
+	struct sockaddr * address = (struct sockaddr *)&control->address;
+	int fd;
+
+	if(bind(control->fd, address, sizeof(control->address)) != 0)
+	{
+		if(errno != EADDRINUSE)
+			return -error_set_code(1, "%s: %s",
+					control->address.sun_path,
+					strerror(errno));
+		/* only replace the socket of a keyboard gone */
+		if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+			return -error_set_code(1, "%s", strerror(errno));
+		if(connect(fd, address, sizeof(control->address)) == 0
+				|| errno != ECONNREFUSED)
+		{
+			close(fd);
+			return -error_set_code(1, "%s: %s",
+					control->address.sun_path,
+					"Already in use");
+		}
+		close(fd);
+		if(unlink(control->address.sun_path) != 0
+				|| bind(control->fd, address,
+					sizeof(control->address)) != 0)
+			return -error_set_code(1, "%s: %s",
+					control->address.sun_path,
+					strerror(errno));
+	}
+	/* for the current user only */
+	if(chmod(control->address.sun_path, S_IRUSR | S_IWUSR) != 0
+			|| listen(control->fd, SOMAXCONN) != 0)
+	{
+		error_set_code(1, "%s: %s", control->address.sun_path,
+				strerror(errno));
+		unlink(control->address.sun_path);
+		return -1;
+	}
+	return 0;
+}
+
+
+/* control_client_add */
+static int _control_client_add(KeyboardControl * control, int fd)
+{
+	KeyboardControlClient ** p;
+	KeyboardControlClient * client;
+	GIOChannel * channel;
+
+	if((p = realloc(control->clients, sizeof(*p)
+					* (control->clients_cnt + 1))) == NULL)
+		return -1;
+	control->clients = p;
+	if((client = malloc(sizeof(*client))) == NULL)
+		return -1;
+	client->control = control;
+	client->fd = fd;
+	client->request_cnt = 0;
+	client->text = NULL;
+	client->text_cnt = 0;
+	client->text_left = 0;
+	channel = g_io_channel_unix_new(fd);
+	client->source = g_io_add_watch(channel, G_IO_IN | G_IO_HUP
+			| G_IO_ERR, _control_on_client, client);
+	g_io_channel_unref(channel);
+	control->clients[control->clients_cnt++] = client;
+	return 0;
+}
+
+
+/* control_client_remove */
+static void _control_client_remove(KeyboardControl * control,
+		KeyboardControlClient * client)
+{
+	size_t i;
+
+	for(i = 0; i < control->clients_cnt; i++)
+		if(control->clients[i] == client)
+			break;
+	if(i == control->clients_cnt)
+		return;
+	control->clients[i] = control->clients[--control->clients_cnt];
+	if(client->source != 0)
+		g_source_remove(client->source);
+	close(client->fd);
+	free(client->text);
+	free(client);
+}
+
+
+/* control_dispatch */
+static size_t _control_dispatch(KeyboardControlClient * client,
+		KeyboardControlAnswer * answer)
+{
+	KeyboardControl * control = client->control;
+	KeyboardControlRequest * request = &client->request;
+	KeyboardStats * stats;
+	char buf[KEYBOARD_TEXT_CHUNK];
+	size_t i;
+	size_t j;
+
+	answer->reply.status = 0;
+	answer->reply.count = 0;
+	switch(request->message)
+	{
+		case KEYBOARD_MESSAGE_SET_PAGE:
+		case KEYBOARD_MESSAGE_SET_VISIBLE:
+		case KEYBOARD_MESSAGE_BATCH:
+			on_keyboard_message(control->keyboard,
+					request->message, request->value1,
+					request->value2);
+			break;
+		case KEYBOARD_MESSAGE_TYPE_TEXT:
+			/* as with the messages, but kept apart */
+			for(i = 0; i < sizeof(buf); i++)
+				buf[i] = (request->value1 >> (i * 8)) & 0xff;
+			if((j = request->value2 & 0xff) > sizeof(buf))
+				j = sizeof(buf);
+			if((answer->reply.status = _control_text(client, buf,
+							j)) == 0
+					&& (request->value2
+						& KEYBOARD_TEXT_LAST))
+				answer->reply.status = _control_type(client);
+			break;
+		case KEYBOARD_MESSAGE_TYPE_STRING:
+			/* already received along the request */
+			answer->reply.status = _control_type(client);
+			break;
+		case KEYBOARD_MESSAGE_GET_STATS:
+			/* answered directly, instead of with messages */
+			stats = keyboard_get_stats(control->keyboard);
+			for(i = 0; i < KEYBOARD_STATS_COUNT; i++)
+				for(j = 0; j < KEYBOARD_STATS_VALUE_COUNT; j++)
+					answer->values[answer->reply.count++]
+						= keyboard_stats_get(stats, i,
+								j);
+			answer->values[answer->reply.count++]
+				= keyboard_keymap_get_invalidations(
+						keyboard_get_keymap(
+							control->keyboard));
+			break;
+		default:
+			answer->reply.status = -1;
+			break;
+	}
+	return sizeof(answer->reply)
+		+ sizeof(*answer->values) * answer->reply.count;
+}
+
+
+/* control_peer */
+static int _control_peer(int fd)
+{
+	uid_t uid;
+#ifdef __linux__
+	/* as struct ucred, only declared along _GNU_SOURCE */
+	struct
+	{
+		pid_t pid;
+		uid_t uid;
+		gid_t gid;
+	} cred;
+	socklen_t len = sizeof(cred);
+
+	if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+		return -1;
+	uid = cred.uid;
+#else
+	gid_t gid;
+
+	if(getpeereid(fd, &uid, &gid) != 0)
+		return -1;
+#endif
+	/* only serve the current user */
+	return (uid == getuid()) ? 0 : -1;
+}
+
+
+/* control_path */
+static int _control_path(char * path, size_t size)
+{
+	char const * runtime;
+	int res;
+
+	if((runtime = getenv("XDG_RUNTIME_DIR")) != NULL
+			&& runtime[0] != '\0')
+		res = snprintf(path, size, "%s/%s", runtime,
+				KEYBOARD_CONTROL_SOCKET);
+	else
+		res = snprintf(path, size, KEYBOARD_CONTROL_SOCKET_TMP,
+				(unsigned long)getuid());
+	if(res < 0 || (size_t)res >= size)
+		return -error_set_code(1, "%s", "Path too long for the"
+				" control socket");
+	return 0;
+}
+
+
+/* control_text */
+static int _control_text(KeyboardControlClient * client, char const * buf,
+		size_t len)
+{
+	char * p;
+
+	if(client->text_cnt + len >= KEYBOARD_TEXT_MAX
+			|| (p = realloc(client->text, client->text_cnt + len
+					+ 1)) == NULL)
+	{
+		free(client->text);
+		client->text = NULL;
+		client->text_cnt = 0;
+		return -1;
+	}
+	client->text = p;
+	if(buf != NULL)
+		memcpy(&p[client->text_cnt], buf, len);
+	else
+		/* to be received */
+		client->text_left = len;
+	client->text_cnt += len;
+	p[client->text_cnt] = '\0';
+	return 0;
+}
+
+
+/* control_type */
+static int _control_type(KeyboardControlClient * client)
+{
+	int ret = 0;
+
+	if(client->text != NULL)
+		ret = keyboard_type(client->control->keyboard, client->text);
+	free(client->text);
+	client->text = NULL;
+	client->text_cnt = 0;
+	return ret;
+}
+
+
+/* callbacks */
+/* control_on_accept */
+static gboolean _control_on_accept(GIOChannel * source,
+		GIOCondition condition, gpointer data)
+{
+	KeyboardControl * control = data;
+	int fd;
+
+	while((fd = accept(control->fd, NULL, NULL)) >= 0)
+		if(_control_peer(fd) != 0
+				|| fcntl(fd, F_SETFD, FD_CLOEXEC) != 0
+				|| fcntl(fd, F_SETFL, O_NONBLOCK) != 0
+				|| _control_client_add(control, fd) != 0)
+			close(fd);
+	return TRUE;
+}
+
+
+/* control_on_client */
+static gboolean _control_on_client(GIOChannel * source,
+		GIOCondition condition, gpointer data)
+{
+	KeyboardControlClient * client = data;
+	KeyboardControl * control = client->control;
+	char * p = (char *)&client->request;
+	KeyboardControlAnswer answer;
+	ssize_t res;
+	size_t size;
+
+	for(;;)
+	{
+		/* the request first, and then the text following if any */
+		if(client->text_left > 0)
+			res = read(client->fd, &client->text[client->text_cnt
+					- client->text_left],
+					client->text_left);
+		else
+			res = read(client->fd, &p[client->request_cnt],
+					sizeof(client->request)
+					- client->request_cnt);
+		if(res < 0 && errno == EINTR)
+			continue;
+		if(res < 0 && errno == EAGAIN)
+			return TRUE;
+		if(res <= 0)
+			break;
+		if(client->text_left > 0)
+		{
+			if((client->text_left -= res) > 0)
+				continue;
+		}
+		else if((client->request_cnt += res)
+				< sizeof(client->request))
+			continue;
+		else if(client->request.message == KEYBOARD_MESSAGE_TYPE_STRING
+				&& client->request.value1 > 0)
+		{
+			/* the text is too long to be typed anyway */
+			if(_control_text(client, NULL, client->request.value1)
+					!= 0)
+				break;
+			continue;
+		}
+		client->request_cnt = 0;
+		/* the replies are small enough not to block */
+		size = _control_dispatch(client, &answer);
+		if(send(client->fd, &answer, size, MSG_NOSIGNAL)
+				!= (ssize_t)size)
+			break;
+	}
+	client->source = 0;
+	_control_client_remove(control, client);
+	return FALSE;
+}
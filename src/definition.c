@@ -0,0 +1,1669 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <glib.h>
+#define XK_LATIN1
+#define XK_MISCELLANY
+#define XK_LATIN9
+#define XK_CURRENCY
+#define XK_XKB_KEYS
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/XKBlib.h>
+#include <X11/keysymdef.h>
+#include <gdk/gdk.h>
+#include <System.h>
+#include "common.h"
+#include "definition.h"
+#include "../config.h"
+
+/* constants */
+#ifndef PREFIX
+# define PREFIX		"/usr/local"
+#endif
+#ifndef DATADIR
+# define DATADIR	PREFIX "/share"
+#endif
+
+
+/* KeyboardDefinition */
+/* private */
+/* constants */
+#define KEYBOARD_DEFINITION_MAGIC	"KbdL"
+#define KEYBOARD_DEFINITION_VERSION	2
+
+#define KEYBOARD_DEFINITION_CACHE	".klc"
+#define KEYBOARD_DEFINITION_SOURCE	".layout"
+
+/* bumped whenever the pages generated from XKB change */
+#define KEYBOARD_DEFINITION_XKB_VERSION	1
+
+
+/* types */
+/* compiled form */
+typedef struct _KeyboardDefinitionHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t size;
+	struct
+	{
+		uint32_t offset;
+		uint32_t count;
+	} sections[KLS_COUNT];
+	/* the layout compiled, recompiled as soon as any of these changes */
+	struct
+	{
+		uint64_t dev;
+		uint64_t ino;
+		uint64_t size;
+		int64_t mtime;
+		uint32_t path;		/* offset in the file or 0 */
+		uint32_t padding;
+	} source;
+} KeyboardDefinitionHeader;
+
+typedef struct _KeyboardDefinitionKey
+{
+	uint32_t row;
+	uint32_t width;
+	uint32_t modifier;
+	uint32_t keysym;
+	uint32_t label;			/* offset in the file or 0 */
+} KeyboardDefinitionKey;
+
+/* built-in layouts */
+typedef enum _KeyboardLayoutType
+{
+	KLT_QWERTY = 0,
+	KLT_QWERTZ,
+	KLT_AZERTY
+} KeyboardLayoutType;
+#define KLT_LAST KLT_AZERTY
+#define KLT_COUNT (KLT_LAST + 1)
+
+typedef struct _KeyboardLayoutTypeName
+{
+	KeyboardLayoutType type;
+	char const * name;
+} KeyboardLayoutTypeName;
+
+/* compilation */
+typedef struct _KeyboardDefinitionCompile
+{
+	char const * source;
+	struct stat st;
+	uint32_t path;
+	unsigned int line;
+	KeyboardDefinitionKey * keys[KLS_COUNT];
+	size_t keys_cnt[KLS_COUNT];
+	char * labels;
+	size_t labels_cnt;
+} KeyboardDefinitionCompile;
+
+/* XKB layouts */
+typedef struct _KeyboardDefinitionXkb
+{
+	KeyboardLayoutSection section;
+	unsigned int row;
+	unsigned int width;
+	unsigned int modifier;
+	char const * name;		/* XKB key name or NULL */
+	unsigned int keysym;
+	char const * label;
+} KeyboardDefinitionXkb;
+
+struct _KeyboardDefinition
+{
+	/* compiled layouts */
+	void * data;
+	size_t size;
+	KeyboardKeyDefinition * buffer;
+
+	KeyboardKeyDefinition const * keys[KLS_COUNT];
+};
+
+
+/* constants */
+static const struct
+{
+	char const * name;
+	unsigned int modifier;
+} _keyboard_definition_modifiers[] =
+{
+	{ "shift",	KM_SHIFT	},
+	{ "level3",	KM_LEVEL3	},
+	{ "numlock",	KM_NUMLOCK	}
+};
+
+static char const * _keyboard_definition_sections[KLS_COUNT] =
+{
+	"letters", "keypad", "special"
+};
+
+static const KeyboardLayoutTypeName _keyboard_layout_type_name[] =
+{
+	{ KLT_QWERTY,	"us"	},
+	{ KLT_QWERTZ,	"de"	},
+	{ KLT_AZERTY,	"fr"	}
+};
+
+
+/* the positions of the keys read from XKB, with the fixed keys in between */
+static const KeyboardDefinitionXkb _keyboard_definition_xkb[] =
+{
+	{ KLS_LETTERS, 0, 2, 0, "AD01", 0, NULL },
+	{ KLS_LETTERS, 0, 2, 0, "AD02", 0, NULL },
+	{ KLS_LETTERS, 0, 2, 0, "AD03", 0, NULL },
+	{ KLS_LETTERS, 0, 2, 0, "AD04", 0, NULL },
+	{ KLS_LETTERS, 0, 2, 0, "AD05", 0, NULL },
+	{ KLS_LETTERS, 0, 2, 0, "AD06", 0, NULL },
+	{ KLS_LETTERS, 0, 2, 0, "AD07", 0, NULL },
+	{ KLS_LETTERS, 0, 2, 0, "AD08", 0, NULL },
+	{ KLS_LETTERS, 0, 2, 0, "AD09", 0, NULL },
+	{ KLS_LETTERS, 0, 2, 0, "AD10", 0, NULL },
+	{ KLS_LETTERS, 0, 2, 0, "AD11", 0, NULL },
+	{ KLS_LETTERS, 0, 2, 0, "AD12", 0, NULL },
+	{ KLS_LETTERS, 1, 1, 0, NULL, 0, NULL },
+	{ KLS_LETTERS, 1, 2, 0, "AC01", 0, NULL },
+	{ KLS_LETTERS, 1, 2, 0, "AC02", 0, NULL },
+	{ KLS_LETTERS, 1, 2, 0, "AC03", 0, NULL },
+	{ KLS_LETTERS, 1, 2, 0, "AC04", 0, NULL },
+	{ KLS_LETTERS, 1, 2, 0, "AC05", 0, NULL },
+	{ KLS_LETTERS, 1, 2, 0, "AC06", 0, NULL },
+	{ KLS_LETTERS, 1, 2, 0, "AC07", 0, NULL },
+	{ KLS_LETTERS, 1, 2, 0, "AC08", 0, NULL },
+	{ KLS_LETTERS, 1, 2, 0, "AC09", 0, NULL },
+	{ KLS_LETTERS, 1, 2, 0, "AC10", 0, NULL },
+	{ KLS_LETTERS, 1, 2, 0, "AC11", 0, NULL },
+	{ KLS_LETTERS, 2, 2, 0, NULL, XK_Shift_L, "\xe2\x87\xa7" },
+	{ KLS_LETTERS, 2, 2, 0, "LSGT", 0, NULL },
+	{ KLS_LETTERS, 2, 2, 0, "AB01", 0, NULL },
+	{ KLS_LETTERS, 2, 2, 0, "AB02", 0, NULL },
+	{ KLS_LETTERS, 2, 2, 0, "AB03", 0, NULL },
+	{ KLS_LETTERS, 2, 2, 0, "AB04", 0, NULL },
+	{ KLS_LETTERS, 2, 2, 0, "AB05", 0, NULL },
+	{ KLS_LETTERS, 2, 2, 0, "AB06", 0, NULL },
+	{ KLS_LETTERS, 2, 2, 0, "AB07", 0, NULL },
+	{ KLS_LETTERS, 2, 2, 0, "AB08", 0, NULL },
+	{ KLS_LETTERS, 2, 2, 0, "AB09", 0, NULL },
+	{ KLS_LETTERS, 2, 2, 0, "AB10", 0, NULL },
+	{ KLS_LETTERS, 3, 3, 0, NULL, 0, NULL },
+	{ KLS_LETTERS, 3, 3, 0, NULL, XK_Control_L, "Ctrl" },
+	{ KLS_LETTERS, 3, 3, 0, NULL, XK_Alt_L, "Alt" },
+	{ KLS_LETTERS, 3, 6, 0, NULL, XK_space, " " },
+	{ KLS_LETTERS, 3, 3, 0, "RALT", 0, "Alt Gr" },
+	{ KLS_LETTERS, 3, 3, 0, NULL, XK_Return, "\xe2\x86\xb2" },
+	{ KLS_LETTERS, 3, 3, 0, NULL, XK_BackSpace, "\xe2\x8c\xab" },
+	{ KLS_SPECIAL, 0, 3, 0, NULL, XK_Escape, "Esc" },
+	{ KLS_SPECIAL, 0, 2, 0, NULL, XK_F1, "F1" },
+	{ KLS_SPECIAL, 0, 0, KM_SHIFT, NULL, XK_F5, "F5" },
+	{ KLS_SPECIAL, 0, 2, 0, NULL, XK_F2, "F2" },
+	{ KLS_SPECIAL, 0, 0, KM_SHIFT, NULL, XK_F6, "F6" },
+	{ KLS_SPECIAL, 0, 2, 0, NULL, XK_F3, "F3" },
+	{ KLS_SPECIAL, 0, 0, KM_SHIFT, NULL, XK_F7, "F7" },
+	{ KLS_SPECIAL, 0, 2, 0, NULL, XK_F4, "F4" },
+	{ KLS_SPECIAL, 0, 0, KM_SHIFT, NULL, XK_F8, "F8" },
+	{ KLS_SPECIAL, 0, 1, 0, NULL, 0, NULL },
+	{ KLS_SPECIAL, 0, 2, 0, NULL, XK_F5, "F5" },
+	{ KLS_SPECIAL, 0, 0, KM_SHIFT, NULL, XK_F9, "F9" },
+	{ KLS_SPECIAL, 0, 2, 0, NULL, XK_F6, "F6" },
+	{ KLS_SPECIAL, 0, 0, KM_SHIFT, NULL, XK_F10, "F10" },
+	{ KLS_SPECIAL, 0, 2, 0, NULL, XK_F7, "F7" },
+	{ KLS_SPECIAL, 0, 0, KM_SHIFT, NULL, XK_F11, "F11" },
+	{ KLS_SPECIAL, 0, 2, 0, NULL, XK_F8, "F8" },
+	{ KLS_SPECIAL, 0, 0, KM_SHIFT, NULL, XK_F12, "F12" },
+	{ KLS_SPECIAL, 1, 2, 0, "TLDE", 0, NULL },
+	{ KLS_SPECIAL, 1, 2, 0, "AE01", 0, NULL },
+	{ KLS_SPECIAL, 1, 2, 0, "AE02", 0, NULL },
+	{ KLS_SPECIAL, 1, 2, 0, "AE03", 0, NULL },
+	{ KLS_SPECIAL, 1, 2, 0, "AE04", 0, NULL },
+	{ KLS_SPECIAL, 1, 2, 0, "AE05", 0, NULL },
+	{ KLS_SPECIAL, 1, 2, 0, "AE06", 0, NULL },
+	{ KLS_SPECIAL, 1, 2, 0, "AE07", 0, NULL },
+	{ KLS_SPECIAL, 1, 2, 0, "AE08", 0, NULL },
+	{ KLS_SPECIAL, 1, 2, 0, "AE09", 0, NULL },
+	{ KLS_SPECIAL, 1, 2, 0, "AE10", 0, NULL },
+	{ KLS_SPECIAL, 1, 2, 0, "AE11", 0, NULL },
+	{ KLS_SPECIAL, 1, 2, 0, "AE12", 0, NULL },
+	{ KLS_SPECIAL, 2, 3, 0, NULL, XK_Tab, "\xe2\x86\xb9" },
+	{ KLS_SPECIAL, 2, 2, 0, "BKSL", 0, NULL },
+	{ KLS_SPECIAL, 3, 3, 0, NULL, 0, NULL },
+	{ KLS_SPECIAL, 3, 2, 0, NULL, XK_Shift_L, "\xe2\x87\xa7" },
+	{ KLS_SPECIAL, 3, 3, 0, NULL, XK_space, " " },
+	{ KLS_SPECIAL, 3, 0, KM_SHIFT, NULL, XK_space, " " },
+	{ KLS_SPECIAL, 3, 3, 0, NULL, XK_Return, "\xe2\x86\xb2" },
+	{ KLS_SPECIAL, 3, 3, 0, NULL, XK_BackSpace, "\xe2\x8c\xab" }
+};
+
+/* labels for the dead keys, which have no character of their own */
+static const struct
+{
+	unsigned int keysym;
+	char const * label;
+} _keyboard_definition_xkb_dead[] =
+{
+	{ XK_dead_grave,	"`"		},
+	{ XK_dead_acute,	"\xc2\xb4"	},
+	{ XK_dead_circumflex,	"^"		},
+	{ XK_dead_tilde,	"~"		},
+	{ XK_dead_diaeresis,	"\xc2\xa8"	},
+	{ XK_dead_abovering,	"\xc2\xb0"	},
+	{ XK_dead_cedilla,	"\xc2\xb8"	},
+	{ XK_dead_caron,	"\xcb\x87"	}
+};
+
+
+/* variables */
+static KeyboardKeyDefinition const _keyboard_layout_letters_qwerty[] =
+{
+	{ 0, 2, 0, XK_q, "q" },
+	{ 0, 0, KM_SHIFT, XK_Q, "Q" },
+	{ 0, 2, 0, XK_w, "w" },
+	{ 0, 0, KM_SHIFT, XK_W, "W" },
+	{ 0, 2, 0, XK_e, "e" },
+	{ 0, 0, KM_SHIFT, XK_E, "E" },
+	{ 0, 2, 0, XK_r, "r" },
+	{ 0, 0, KM_SHIFT, XK_R, "R" },
+	{ 0, 2, 0, XK_t, "t" },
+	{ 0, 0, KM_SHIFT, XK_T, "T" },
+	{ 0, 2, 0, XK_y, "y" },
+	{ 0, 0, KM_SHIFT, XK_Y, "Y" },
+	{ 0, 2, 0, XK_u, "u" },
+	{ 0, 0, KM_SHIFT, XK_U, "U" },
+	{ 0, 2, 0, XK_i, "i" },
+	{ 0, 0, KM_SHIFT, XK_I, "I" },
+	{ 0, 2, 0, XK_o, "o" },
+	{ 0, 0, KM_SHIFT, XK_O, "O" },
+	{ 0, 2, 0, XK_p, "p" },
+	{ 0, 0, KM_SHIFT, XK_P, "P" },
+	{ 1, 1, 0, 0, NULL },
+	{ 1, 2, 0, XK_a, "a" },
+	{ 1, 0, KM_SHIFT, XK_A, "A" },
+	{ 1, 2, 0, XK_s, "s" },
+	{ 1, 0, KM_SHIFT, XK_S, "S" },
+	{ 1, 2, 0, XK_d, "d" },
+	{ 1, 0, KM_SHIFT, XK_D, "D" },
+	{ 1, 2, 0, XK_f, "f" },
+	{ 1, 0, KM_SHIFT, XK_F, "F" },
+	{ 1, 2, 0, XK_g, "g" },
+	{ 1, 0, KM_SHIFT, XK_G, "G" },
+	{ 1, 2, 0, XK_h, "h" },
+	{ 1, 0, KM_SHIFT, XK_H, "H" },
+	{ 1, 2, 0, XK_j, "j" },
+	{ 1, 0, KM_SHIFT, XK_J, "J" },
+	{ 1, 2, 0, XK_k, "k" },
+	{ 1, 0, KM_SHIFT, XK_K, "K" },
+	{ 1, 2, 0, XK_l, "l" },
+	{ 1, 0, KM_SHIFT, XK_L, "L" },
+	{ 2, 2, 0, XK_Shift_L, "\xe2\x87\xa7" },
+	{ 2, 2, 0, XK_z, "z" },
+	{ 2, 0, KM_SHIFT, XK_Z, "Z" },
+	{ 2, 2, 0, XK_x, "x" },
+	{ 2, 0, KM_SHIFT, XK_X, "X" },
+	{ 2, 2, 0, XK_c, "c" },
+	{ 2, 0, KM_SHIFT, XK_C, "C" },
+	{ 2, 2, 0, XK_v, "v" },
+	{ 2, 0, KM_SHIFT, XK_V, "V" },
+	{ 2, 2, 0, XK_b, "b" },
+	{ 2, 0, KM_SHIFT, XK_B, "B" },
+	{ 2, 2, 0, XK_n, "n" },
+	{ 2, 0, KM_SHIFT, XK_N, "N" },
+	{ 2, 2, 0, XK_m, "m" },
+	{ 2, 0, KM_SHIFT, XK_M, "M" },
+	{ 2, 2, 0, XK_comma, "," },
+	{ 2, 0, KM_SHIFT, XK_comma, "<" },
+	{ 2, 2, 0, XK_period, "." },
+	{ 2, 0, KM_SHIFT, XK_period, ">" },
+	{ 3, 3, 0, 0, NULL },
+	{ 3, 3, 0, XK_Control_L, "Ctrl" },
+	{ 3, 3, 0, XK_Alt_L, "Alt" },
+	{ 3, 5, 0, XK_space, " " },
+	{ 3, 0, KM_SHIFT, XK_space, " " },
+	{ 3, 3, 0, XK_Return, "\xe2\x86\xb2" },
+	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
+	{ 0, 0, 0, 0, NULL }
+};
+
+static KeyboardKeyDefinition const _keyboard_layout_letters_qwertz[] =
+{
+	{ 0, 2, 0, XK_q, "q" },
+	{ 0, 0, KM_SHIFT, XK_Q, "Q" },
+	{ 0, 2, 0, XK_w, "w" },
+	{ 0, 0, KM_SHIFT, XK_W, "W" },
+	{ 0, 2, 0, XK_e, "e" },
+	{ 0, 0, KM_SHIFT, XK_E, "E" },
+	{ 0, 2, 0, XK_r, "r" },
+	{ 0, 0, KM_SHIFT, XK_R, "R" },
+	{ 0, 2, 0, XK_t, "t" },
+	{ 0, 0, KM_SHIFT, XK_T, "T" },
+	{ 0, 2, 0, XK_z, "z" },
+	{ 0, 0, KM_SHIFT, XK_Z, "Z" },
+	{ 0, 2, 0, XK_u, "u" },
+	{ 0, 0, KM_SHIFT, XK_U, "U" },
+	{ 0, 2, 0, XK_i, "i" },
+	{ 0, 0, KM_SHIFT, XK_I, "I" },
+	{ 0, 2, 0, XK_o, "o" },
+	{ 0, 0, KM_SHIFT, XK_O, "O" },
+	{ 0, 2, 0, XK_p, "p" },
+	{ 0, 0, KM_SHIFT, XK_P, "P" },
+	{ 1, 1, 0, 0, NULL },
+	{ 1, 2, 0, XK_a, "a" },
+	{ 1, 0, KM_SHIFT, XK_A, "A" },
+	{ 1, 2, 0, XK_s, "s" },
+	{ 1, 0, KM_SHIFT, XK_S, "S" },
+	{ 1, 2, 0, XK_d, "d" },
+	{ 1, 0, KM_SHIFT, XK_D, "D" },
+	{ 1, 2, 0, XK_f, "f" },
+	{ 1, 0, KM_SHIFT, XK_F, "F" },
+	{ 1, 2, 0, XK_g, "g" },
+	{ 1, 0, KM_SHIFT, XK_G, "G" },
+	{ 1, 2, 0, XK_h, "h" },
+	{ 1, 0, KM_SHIFT, XK_H, "H" },
+	{ 1, 2, 0, XK_j, "j" },
+	{ 1, 0, KM_SHIFT, XK_J, "J" },
+	{ 1, 2, 0, XK_k, "k" },
+	{ 1, 0, KM_SHIFT, XK_K, "K" },
+	{ 1, 2, 0, XK_l, "l" },
+	{ 1, 0, KM_SHIFT, XK_L, "L" },
+	{ 2, 2, 0, XK_Shift_L, "\xe2\x87\xa7" },
+	{ 2, 2, 0, XK_y, "y" },
+	{ 2, 0, KM_SHIFT, XK_Y, "Y" },
+	{ 2, 2, 0, XK_x, "x" },
+	{ 2, 0, KM_SHIFT, XK_X, "X" },
+	{ 2, 2, 0, XK_c, "c" },
+	{ 2, 0, KM_SHIFT, XK_C, "C" },
+	{ 2, 2, 0, XK_v, "v" },
+	{ 2, 0, KM_SHIFT, XK_V, "V" },
+	{ 2, 2, 0, XK_b, "b" },
+	{ 2, 0, KM_SHIFT, XK_B, "B" },
+	{ 2, 2, 0, XK_n, "n" },
+	{ 2, 0, KM_SHIFT, XK_N, "N" },
+	{ 2, 2, 0, XK_m, "m" },
+	{ 2, 0, KM_SHIFT, XK_M, "M" },
+	{ 2, 2, 0, XK_comma, "," },
+	{ 2, 0, KM_SHIFT, XK_comma, "<" },
+	{ 2, 2, 0, XK_period, "." },
+	{ 2, 0, KM_SHIFT, XK_period, ">" },
+	{ 3, 3, 0, 0, NULL },
+	{ 3, 3, 0, XK_Control_L, "Ctrl" },
+	{ 3, 3, 0, XK_Alt_L, "Alt" },
+	{ 3, 5, 0, XK_space, " " },
+	{ 3, 0, KM_SHIFT, XK_space, " " },
+	{ 3, 3, 0, XK_Return, "\xe2\x86\xb2" },
+	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
+	{ 0, 0, 0, 0, NULL }
+};
+
+static KeyboardKeyDefinition const _keyboard_layout_letters_azerty[] =
+{
+	{ 0, 2, 0, XK_a, "a" },
+	{ 0, 0, KM_SHIFT, XK_A, "A" },
+	{ 0, 0, KM_LEVEL3, XK_ae, "æ" },
+	{ 0, 0, KM_SHIFT | KM_LEVEL3, XK_AE, "Æ" },
+	{ 0, 2, 0, XK_z, "z" },
+	{ 0, 0, KM_SHIFT, XK_Z, "Z" },
+	{ 0, 2, 0, XK_e, "e" },
+	{ 0, 0, KM_SHIFT, XK_E, "E" },
+	{ 0, 0, KM_LEVEL3, XK_EuroSign, "€" },
+	{ 0, 0, KM_SHIFT | KM_LEVEL3, XK_cent, "¢" },
+	{ 0, 2, 0, XK_r, "r" },
+	{ 0, 0, KM_SHIFT, XK_R, "R" },
+	{ 0, 2, 0, XK_t, "t" },
+	{ 0, 0, KM_SHIFT, XK_T, "T" },
+	{ 0, 2, 0, XK_y, "y" },
+	{ 0, 0, KM_SHIFT, XK_Y, "Y" },
+	{ 0, 2, 0, XK_u, "u" },
+	{ 0, 0, KM_SHIFT, XK_U, "U" },
+	{ 0, 2, 0, XK_i, "i" },
+	{ 0, 0, KM_SHIFT, XK_I, "I" },
+	{ 0, 2, 0, XK_o, "o" },
+	{ 0, 0, KM_SHIFT, XK_O, "O" },
+	{ 0, 0, KM_LEVEL3, XK_oe, "œ" },
+	{ 0, 0, KM_SHIFT | KM_LEVEL3, XK_OE, "Œ" },
+	{ 0, 2, 0, XK_p, "p" },
+	{ 0, 0, KM_SHIFT, XK_P, "P" },
+	{ 0, 2, 0, XK_asciicircum, "^" },
+	{ 0, 0, KM_SHIFT, XK_quotedbl, "\"" },
+	{ 0, 2, 0, XK_dollar, "$" },
+	{ 0, 0, KM_SHIFT, XK_sterling, "£" },
+	{ 1, 1, 0, 0, NULL },
+	{ 1, 2, 0, XK_q, "q" },
+	{ 1, 0, KM_SHIFT, XK_Q, "Q" },
+	{ 1, 2, 0, XK_s, "s" },
+	{ 1, 0, KM_SHIFT, XK_S, "S" },
+	{ 1, 2, 0, XK_d, "d" },
+	{ 1, 0, KM_SHIFT, XK_D, "D" },
+	{ 1, 2, 0, XK_f, "f" },
+	{ 1, 0, KM_SHIFT, XK_F, "F" },
+	{ 1, 2, 0, XK_g, "g" },
+	{ 1, 0, KM_SHIFT, XK_G, "G" },
+	{ 1, 2, 0, XK_h, "h" },
+	{ 1, 0, KM_SHIFT, XK_H, "H" },
+	{ 1, 2, 0, XK_j, "j" },
+	{ 1, 0, KM_SHIFT, XK_J, "J" },
+	{ 1, 2, 0, XK_k, "k" },
+	{ 1, 0, KM_SHIFT, XK_K, "K" },
+	{ 1, 2, 0, XK_l, "l" },
+	{ 1, 0, KM_SHIFT, XK_L, "L" },
+	{ 1, 2, 0, XK_m, "m" },
+	{ 1, 0, KM_SHIFT, XK_M, "M" },
+	{ 1, 2, 0, XK_ugrave, "ù" },
+	{ 1, 0, KM_SHIFT, XK_percent, "%" },
+	{ 1, 2, 0, XK_asterisk, "*" },
+	{ 1, 0, KM_SHIFT, XK_mu, "µ" },
+	{ 2, 2, 0, XK_Shift_L, "\xe2\x87\xa7" },
+	{ 2, 2, 0, XK_less, "<" },
+	{ 2, 0, KM_SHIFT, XK_less, ">" },
+	{ 2, 2, 0, XK_w, "w" },
+	{ 2, 0, KM_SHIFT, XK_W, "W" },
+	{ 2, 2, 0, XK_x, "x" },
+	{ 2, 0, KM_SHIFT, XK_X, "X" },
+	{ 2, 2, 0, XK_c, "c" },
+	{ 2, 0, KM_SHIFT, XK_C, "C" },
+	{ 2, 2, 0, XK_v, "v" },
+	{ 2, 0, KM_SHIFT, XK_V, "V" },
+	{ 2, 2, 0, XK_b, "b" },
+	{ 2, 0, KM_SHIFT, XK_B, "B" },
+	{ 2, 2, 0, XK_n, "n" },
+	{ 2, 0, KM_SHIFT, XK_N, "N" },
+	{ 2, 2, 0, XK_comma, "," },
+	{ 2, 0, KM_SHIFT, XK_question, "?" },
+	{ 2, 2, 0, XK_semicolon, ";" },
+	{ 2, 0, KM_SHIFT, XK_period, "." },
+	{ 2, 2, 0, XK_colon, ":" },
+	{ 2, 0, KM_SHIFT, XK_slash, "/" },
+	{ 2, 2, 0, XK_exclam, "!" },
+	{ 2, 0, KM_SHIFT, XK_paragraph, "§" },
+	{ 3, 3, 0, 0, NULL },
+	{ 3, 3, 0, XK_Control_L, "Ctrl" },
+	{ 3, 3, 0, XK_Alt_L, "Alt" },
+	{ 3, 7, 0, XK_space, " " },
+	{ 3, 0, KM_SHIFT, XK_space, " " },
+	{ 3, 3, 0, XK_Alt_R, "Alt Gr" },
+	{ 3, 0, KM_SHIFT, XK_Alt_R, "Alt Gr" },
+	{ 3, 3, 0, XK_Return, "\xe2\x86\xb2" },
+	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
+	{ 0, 0, 0, 0, NULL }
+};
+
+static KeyboardKeyDefinition const * _keyboard_layout_letters_definition[KLT_COUNT] =
+{
+	_keyboard_layout_letters_qwerty,
+	_keyboard_layout_letters_qwertz,
+	_keyboard_layout_letters_azerty
+};
+
+static KeyboardKeyDefinition const _keyboard_layout_keypad[] =
+{
+	{ 0, 3, 0, XK_Num_Lock, "Num" },
+	{ 0, 1, 0, 0, NULL },
+	{ 0, 4, 0, XK_KP_Home, "\xe2\x86\x96" },
+	{ 0, 0, KM_NUMLOCK, XK_7, "7" },
+	{ 0, 4, 0, XK_KP_Up, "\xe2\x86\x91" },
+	{ 0, 0, KM_NUMLOCK, XK_8, "8" },
+	{ 0, 4, 0, XK_KP_Page_Up, "\xe2\x87\x9e" },
+	{ 0, 0, KM_NUMLOCK, XK_9, "9" },
+	{ 0, 1, 0, 0, NULL },
+	{ 0, 3, 0, XK_KP_Subtract, "-" },
+	{ 1, 3, 0, XK_KP_Divide, "/" },
+	{ 1, 1, 0, 0, NULL },
+	{ 1, 4, 0, XK_KP_Left, "\xe2\x86\x90" },
+	{ 1, 0, KM_NUMLOCK, XK_4, "4" },
+	{ 1, 4, 0, XK_5, "5" },
+	{ 1, 0, KM_NUMLOCK, XK_5, "5" },
+	{ 1, 4, 0, XK_KP_Right, "\xe2\x86\x92" },
+	{ 1, 0, KM_NUMLOCK, XK_6, "6" },
+	{ 1, 1, 0, 0, NULL },
+	{ 1, 3, 0, XK_KP_Add, "+" },
+	{ 2, 3, 0, XK_KP_Multiply, "*" },
+	{ 2, 1, 0, 0, NULL },
+	{ 2, 4, 0, XK_KP_End, "\xe2\x86\x99" },
+	{ 2, 0, KM_NUMLOCK, XK_1, "1" },
+	{ 2, 4, 0, XK_KP_Down, "\xe2\x86\x93" },
+	{ 2, 0, KM_NUMLOCK, XK_2, "2" },
+	{ 2, 4, 0, XK_KP_Page_Down, "\xe2\x87\x9f" },
+	{ 2, 0, KM_NUMLOCK, XK_3, "3" },
+	{ 2, 1, 0, 0, NULL },
+	{ 2, 3, 0, XK_KP_Enter, "\xe2\x86\xb2" },
+	{ 3, 3, 0, 0, NULL },
+	{ 3, 1, 0, 0, NULL },
+	{ 3, 8, 0, XK_KP_Insert, "Ins" },
+	{ 3, 0, KM_NUMLOCK, XK_0, "0" },
+	{ 3, 4, 0, XK_KP_Delete, "Del" },
+	{ 3, 0, KM_NUMLOCK, XK_KP_Decimal, "." },
+	{ 3, 1, 0, 0, NULL },
+	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
+	{ 0, 0, 0, 0, NULL }
+};
+
+static KeyboardKeyDefinition const _keyboard_layout_special_qwerty[] =
+{
+	{ 0, 3, 0, XK_Escape, "Esc" },
+	{ 0, 2, 0, XK_F1, "F1" },
+	{ 0, 0, KM_SHIFT, XK_F5, "F5" },
+	{ 0, 2, 0, XK_F2, "F2" },
+	{ 0, 0, KM_SHIFT, XK_F6, "F6" },
+	{ 0, 2, 0, XK_F3, "F3" },
+	{ 0, 0, KM_SHIFT, XK_F7, "F7" },
+	{ 0, 2, 0, XK_F4, "F4" },
+	{ 0, 0, KM_SHIFT, XK_F8, "F8" },
+	{ 0, 1, 0, 0, NULL },
+	{ 0, 2, 0, XK_F5, "F5" },
+	{ 0, 0, KM_SHIFT, XK_F9, "F9" },
+	{ 0, 2, 0, XK_F6, "F6" },
+	{ 0, 0, KM_SHIFT, XK_F10, "F10" },
+	{ 0, 2, 0, XK_F7, "F7" },
+	{ 0, 0, KM_SHIFT, XK_F11, "F11" },
+	{ 0, 2, 0, XK_F8, "F8" },
+	{ 0, 0, KM_SHIFT, XK_F12, "F12" },
+	{ 1, 2, 0, XK_1, "1" },
+	{ 1, 0, KM_SHIFT, XK_exclam, "!" },
+	{ 1, 2, 0, XK_2, "2" },
+	{ 1, 0, KM_SHIFT, XK_at, "@" },
+	{ 1, 2, 0, XK_3, "3" },
+	{ 1, 0, KM_SHIFT, XK_numbersign, "#" },
+	{ 1, 2, 0, XK_4, "4" },
+	{ 1, 0, KM_SHIFT, XK_dollar, "$" },
+	{ 1, 2, 0, XK_5, "5" },
+	{ 1, 0, KM_SHIFT, XK_percent, "%" },
+	{ 1, 2, 0, XK_6, "6" },
+	{ 1, 0, KM_SHIFT, XK_asciicircum, "^" },
+	{ 1, 2, 0, XK_7, "7" },
+	{ 1, 0, KM_SHIFT, XK_ampersand, "&" },
+	{ 1, 2, 0, XK_8, "8" },
+	{ 1, 0, KM_SHIFT, XK_asterisk, "*" },
+	{ 1, 2, 0, XK_9, "9" },
+	{ 1, 0, KM_SHIFT, XK_parenleft, "(" },
+	{ 1, 2, 0, XK_0, "0" },
+	{ 1, 0, KM_SHIFT, XK_parenright, ")" },
+	{ 2, 3, 0, XK_Tab, "\xe2\x86\xb9" },
+	{ 2, 2, 0, XK_grave, "`" },
+	{ 2, 0, KM_SHIFT, XK_asciitilde, "~" },
+	{ 2, 2, 0, XK_minus, "-" },
+	{ 2, 0, KM_SHIFT, XK_minus, "_" },
+	{ 2, 2, 0, XK_equal, "=" },
+	{ 2, 0, KM_SHIFT, XK_equal, "+" },
+	{ 2, 2, 0, XK_backslash, "\\" },
+	{ 2, 0, KM_SHIFT, XK_backslash, "|" },
+	{ 2, 2, 0, XK_bracketleft, "[" },
+	{ 2, 0, KM_SHIFT, XK_bracketleft, "{" },
+	{ 2, 2, 0, XK_bracketright, "]" },
+	{ 2, 0, KM_SHIFT, XK_bracketright, "}" },
+	{ 2, 2, 0, XK_semicolon, ";" },
+	{ 2, 0, KM_SHIFT, XK_semicolon, ":" },
+	{ 2, 2, 0, XK_apostrophe, "'" },
+	{ 2, 0, KM_SHIFT, XK_apostrophe, "\"" },
+	{ 3, 3, 0, 0, NULL },
+	{ 3, 2, 0, XK_Shift_L, "\xe2\x87\xa7" },
+	{ 3, 3, 0, XK_space, " " },
+	{ 3, 0, KM_SHIFT, XK_space, " " },
+	{ 3, 2, 0, XK_comma, "," },
+	{ 3, 0, KM_SHIFT, XK_comma, "<" },
+	{ 3, 2, 0, XK_period, "." },
+	{ 2, 0, KM_SHIFT, XK_period, ">" },
+	{ 3, 2, 0, XK_slash, "/" },
+	{ 3, 0, KM_SHIFT, XK_slash, "?" },
+	{ 3, 3, 0, XK_Return, "\xe2\x86\xb2" },
+	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
+	{ 0, 0, 0, 0, NULL }
+};
+
+static KeyboardKeyDefinition const _keyboard_layout_special_qwertz[] =
+{
+	{ 0, 3, 0, XK_Escape, "Esc" },
+	{ 0, 2, 0, XK_F1, "F1" },
+	{ 0, 0, KM_SHIFT, XK_F5, "F5" },
+	{ 0, 2, 0, XK_F2, "F2" },
+	{ 0, 0, KM_SHIFT, XK_F6, "F6" },
+	{ 0, 2, 0, XK_F3, "F3" },
+	{ 0, 0, KM_SHIFT, XK_F7, "F7" },
+	{ 0, 2, 0, XK_F4, "F4" },
+	{ 0, 0, KM_SHIFT, XK_F8, "F8" },
+	{ 0, 1, 0, 0, NULL },
+	{ 0, 2, 0, XK_F5, "F5" },
+	{ 0, 0, KM_SHIFT, XK_F9, "F9" },
+	{ 0, 2, 0, XK_F6, "F6" },
+	{ 0, 0, KM_SHIFT, XK_F10, "F10" },
+	{ 0, 2, 0, XK_F7, "F7" },
+	{ 0, 0, KM_SHIFT, XK_F11, "F11" },
+	{ 0, 2, 0, XK_F8, "F8" },
+	{ 0, 0, KM_SHIFT, XK_F12, "F12" },
+	{ 1, 2, 0, XK_1, "1" },
+	{ 1, 0, KM_SHIFT, XK_exclam, "!" },
+	{ 1, 2, 0, XK_2, "2" },
+	{ 1, 0, KM_SHIFT, XK_at, "@" },
+	{ 1, 2, 0, XK_3, "3" },
+	{ 1, 0, KM_SHIFT, XK_numbersign, "#" },
+	{ 1, 2, 0, XK_4, "4" },
+	{ 1, 0, KM_SHIFT, XK_dollar, "$" },
+	{ 1, 2, 0, XK_5, "5" },
+	{ 1, 0, KM_SHIFT, XK_percent, "%" },
+	{ 1, 2, 0, XK_6, "6" },
+	{ 1, 0, KM_SHIFT, XK_asciicircum, "^" },
+	{ 1, 2, 0, XK_7, "7" },
+	{ 1, 0, KM_SHIFT, XK_ampersand, "&" },
+	{ 1, 2, 0, XK_8, "8" },
+	{ 1, 0, KM_SHIFT, XK_asterisk, "*" },
+	{ 1, 2, 0, XK_9, "9" },
+	{ 1, 0, KM_SHIFT, XK_parenleft, "(" },
+	{ 1, 2, 0, XK_0, "0" },
+	{ 1, 0, KM_SHIFT, XK_parenright, ")" },
+	{ 2, 3, 0, XK_Tab, "\xe2\x86\xb9" },
+	{ 2, 2, 0, XK_grave, "`" },
+	{ 2, 0, KM_SHIFT, XK_asciitilde, "~" },
+	{ 2, 2, 0, XK_minus, "-" },
+	{ 2, 0, KM_SHIFT, XK_minus, "_" },
+	{ 2, 2, 0, XK_equal, "=" },
+	{ 2, 0, KM_SHIFT, XK_equal, "+" },
+	{ 2, 2, 0, XK_backslash, "\\" },
+	{ 2, 0, KM_SHIFT, XK_backslash, "|" },
+	{ 2, 2, 0, XK_bracketleft, "[" },
+	{ 2, 0, KM_SHIFT, XK_bracketleft, "{" },
+	{ 2, 2, 0, XK_bracketright, "]" },
+	{ 2, 0, KM_SHIFT, XK_bracketright, "}" },
+	{ 2, 2, 0, XK_semicolon, ";" },
+	{ 2, 0, KM_SHIFT, XK_semicolon, ":" },
+	{ 2, 2, 0, XK_apostrophe, "'" },
+	{ 2, 0, KM_SHIFT, XK_apostrophe, "\"" },
+	{ 3, 3, 0, 0, NULL },
+	{ 3, 2, 0, XK_Shift_L, "\xe2\x87\xa7" },
+	{ 3, 3, 0, XK_space, " " },
+	{ 3, 0, KM_SHIFT, XK_space, " " },
+	{ 3, 2, 0, XK_comma, "," },
+	{ 3, 0, KM_SHIFT, XK_comma, "<" },
+	{ 3, 2, 0, XK_period, "." },
+	{ 2, 0, KM_SHIFT, XK_period, ">" },
+	{ 3, 2, 0, XK_slash, "/" },
+	{ 3, 0, KM_SHIFT, XK_slash, "?" },
+	{ 3, 3, 0, XK_Return, "\xe2\x86\xb2" },
+	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
+	{ 0, 0, 0, 0, NULL }
+};
+
+static KeyboardKeyDefinition const _keyboard_layout_special_azerty[] =
+{
+	{ 0, 3, 0, XK_Escape, "Esc" },
+	{ 0, 1, 0, 0, NULL },
+	{ 0, 2, 0, XK_F1, "F1" },
+	{ 0, 0, KM_SHIFT, XK_F5, "F5" },
+	{ 0, 2, 0, XK_F2, "F2" },
+	{ 0, 0, KM_SHIFT, XK_F6, "F6" },
+	{ 0, 2, 0, XK_F3, "F3" },
+	{ 0, 0, KM_SHIFT, XK_F7, "F7" },
+	{ 0, 2, 0, XK_F4, "F4" },
+	{ 0, 0, KM_SHIFT, XK_F8, "F8" },
+	{ 0, 2, 0, XK_F5, "F5" },
+	{ 0, 0, KM_SHIFT, XK_F9, "F9" },
+	{ 0, 2, 0, XK_F6, "F6" },
+	{ 0, 0, KM_SHIFT, XK_F10, "F10" },
+	{ 0, 2, 0, XK_F7, "F7" },
+	{ 0, 0, KM_SHIFT, XK_F11, "F11" },
+	{ 0, 2, 0, XK_F8, "F8" },
+	{ 0, 0, KM_SHIFT, XK_F12, "F12" },
+	{ 1, 1, 0, 0, NULL },
+	{ 1, 2, 0, XK_ampersand, "&" },
+	{ 1, 0, KM_SHIFT, XK_1, "1" },
+	{ 1, 2, 0, XK_eacute, "é" },
+	{ 1, 0, KM_SHIFT, XK_2, "2" },
+	{ 1, 2, 0, XK_quotedbl, "\"" },
+	{ 1, 0, KM_SHIFT, XK_3, "3" },
+	{ 1, 2, 0, XK_apostrophe, "'" },
+	{ 1, 0, KM_SHIFT, XK_4, "4" },
+	{ 1, 2, 0, XK_parenleft, "(" },
+	{ 1, 0, KM_SHIFT, XK_5, "5" },
+	{ 1, 2, 0, XK_minus, "-" },
+	{ 1, 0, KM_SHIFT, XK_6, "6" },
+	{ 1, 2, 0, XK_egrave, "è" },
+	{ 1, 0, KM_SHIFT, XK_7, "7" },
+	{ 1, 2, 0, XK_underscore, "_" },
+	{ 1, 0, KM_SHIFT, XK_8, "8" },
+	{ 1, 2, 0, XK_ccedilla, "ç" },
+	{ 1, 0, KM_SHIFT, XK_9, "9" },
+	{ 1, 2, 0, XK_aacute, "à" },
+	{ 1, 0, KM_SHIFT, XK_0, "0" },
+	{ 2, 2, 0, XK_Tab, "\xe2\x86\xb9" },
+	{ 2, 2, 0, XK_twosuperior, "²" },
+	{ 2, 2, 0, XK_asciitilde, "~" },
+	{ 2, 2, 0, XK_numbersign, "#" },
+	{ 2, 2, 0, XK_braceleft, "{" },
+	{ 2, 2, 0, XK_bracketleft, "[" },
+	{ 2, 2, 0, XK_bracketright, "]" },
+	{ 2, 2, 0, XK_braceright, "}" },
+	{ 2, 2, 0, XK_parenright, ")" },
+	{ 2, 0, KM_SHIFT, XK_degree, "°" },
+	{ 2, 2, 0, XK_equal, "=" },
+	{ 2, 0, KM_SHIFT, XK_plus, "+" },
+	{ 3, 3, 0, 0, NULL },
+	{ 3, 2, 0, XK_Shift_L, "\xe2\x87\xa7" },
+	{ 3, 2, 0, XK_bracketleft, "|" },
+	{ 3, 2, 0, XK_grave, "`" },
+	{ 3, 2, 0, XK_backslash, "\\" },
+	{ 3, 2, 0, XK_asciicircum, "^" },
+	{ 3, 2, 0, XK_at, "@" },
+	{ 3, 3, 0, XK_Return, "\xe2\x86\xb2" },
+	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
+	{ 0, 0, 0, 0, NULL }
+};
+
+static KeyboardKeyDefinition const * _keyboard_layout_special_definition[KLT_COUNT] =
+{
+	_keyboard_layout_special_qwerty,
+	_keyboard_layout_special_qwertz,
+	_keyboard_layout_special_azerty
+};
+
+
+/* prototypes */
+static char * _keyboard_definition_cache(char const * name,
+		char const * source);
+static char * _keyboard_definition_source(char const * name);
+
+static int _compile_append(KeyboardDefinitionCompile * compile, int section,
+		KeyboardDefinitionKey * key);
+static int _compile_error(KeyboardDefinitionCompile * compile,
+		char const * token, char const * message);
+static int _compile_label(KeyboardDefinitionCompile * compile,
+		char const * label, uint32_t * offset);
+static int _compile_write(KeyboardDefinitionCompile * compile,
+		char const * filename);
+
+static uint32_t _hash_update(uint32_t hash, void const * data, size_t size);
+
+
+/* public */
+/* functions */
+/* keyboard_definition_new */
+static KeyboardDefinition * _new_cached(char const * cache,
+		char const * source, struct stat const * st);
+
+KeyboardDefinition * keyboard_definition_new(char const * name)
+{
+	KeyboardDefinition * definition = NULL;
+	char * source;
+	char * cache;
+	struct stat st;
+
+	/* only fall back to the built-in layouts when not found */
+	if((source = _keyboard_definition_source(name)) == NULL)
+	{
+		if((definition = keyboard_definition_new_builtin(name))
+				== NULL)
+			error_set_code(1, "%s: %s", name, "Layout not found");
+		return definition;
+	}
+	if((cache = _keyboard_definition_cache(name, source)) == NULL)
+	{
+		g_free(source);
+		return NULL;
+	}
+	/* (re-)compile the layout if the cache is missing or outdated */
+	if(stat(source, &st) != 0)
+		error_set_code(1, "%s: %s", source, strerror(errno));
+	else if((definition = _new_cached(cache, source, &st)) == NULL
+			&& keyboard_definition_compile(source, cache) == 0)
+		definition = keyboard_definition_new_from_file(cache);
+	g_free(cache);
+	g_free(source);
+	return definition;
+}
+
+static KeyboardDefinition * _new_cached(char const * cache,
+		char const * source, struct stat const * st)
+{
+	KeyboardDefinition * definition;
+	KeyboardDefinitionHeader const * header;
+
+	if(access(cache, R_OK) != 0 || (definition
+				= keyboard_definition_new_from_file(cache))
+			== NULL)
+		return NULL;
+	/* the very same source must have been compiled */
+	header = definition->data;
+	if(header->source.dev == (uint64_t)st->st_dev
+			&& header->source.ino == (uint64_t)st->st_ino
+			&& header->source.size == (uint64_t)st->st_size
+			&& header->source.mtime == (int64_t)st->st_mtime
+			&& header->source.path != 0
+			&& strcmp((char const *)definition->data
+				+ header->source.path, source) == 0)
+		return definition;
+	keyboard_definition_delete(definition);
+	return NULL;
+}
+
+
+/* keyboard_definition_new_builtin */
+KeyboardDefinition * keyboard_definition_new_builtin(char const * name)
+{
+	KeyboardDefinition * definition;
+	KeyboardLayoutType type = KLT_QWERTY;
+	size_t i;
+
+	if(name != NULL)
+	{
+		for(i = 0; i < sizeof(_keyboard_layout_type_name)
+				/ sizeof(*_keyboard_layout_type_name); i++)
+			if(strcasecmp(name, _keyboard_layout_type_name[i].name)
+					== 0)
+				break;
+		if(i == sizeof(_keyboard_layout_type_name)
+				/ sizeof(*_keyboard_layout_type_name))
+		{
+			error_set_code(1, "%s: %s", name, "Unsupported layout");
+			return NULL;
+		}
+		type = _keyboard_layout_type_name[i].type;
+	}
+	if((definition = malloc(sizeof(*definition))) == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		return NULL;
+	}
+	definition->data = MAP_FAILED;
+	definition->size = 0;
+	definition->buffer = NULL;
+	definition->keys[KLS_LETTERS] = _keyboard_layout_letters_definition[
+		type];
+	definition->keys[KLS_KEYPAD] = _keyboard_layout_keypad;
+	definition->keys[KLS_SPECIAL] = _keyboard_layout_special_definition[
+		type];
+	return definition;
+}
+
+
+/* keyboard_definition_new_from_file */
+static int _new_from_file_map(KeyboardDefinition * definition,
+		char const * filename);
+static int _new_from_file_check(KeyboardDefinition * definition);
+
+KeyboardDefinition * keyboard_definition_new_from_file(char const * filename)
+{
+	KeyboardDefinition * definition;
+	KeyboardDefinitionHeader const * header;
+	KeyboardDefinitionKey const * k;
+	KeyboardKeyDefinition * keys;
+	char const * data;
+	size_t cnt;
+	size_t i;
+	size_t j;
+
+	if((definition = malloc(sizeof(*definition))) == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		return NULL;
+	}
+	definition->data = MAP_FAILED;
+	definition->buffer = NULL;
+	for(i = 0; i < KLS_COUNT; i++)
+		definition->keys[i] = NULL;
+	if(_new_from_file_map(definition, filename) != 0)
+	{
+		keyboard_definition_delete(definition);
+		return NULL;
+	}
+	data = definition->data;
+	header = definition->data;
+	/* point the definitions directly to the labels mapped */
+	for(i = 0, cnt = 0; i < KLS_COUNT; i++)
+		if(header->sections[i].count > 0)
+			cnt += header->sections[i].count + 1;
+	if(cnt == 0 || (definition->buffer = malloc(sizeof(*keys) * cnt))
+			== NULL)
+	{
+		error_set_code(1, "%s: %s", filename, (cnt == 0)
+				? "Empty layout" : strerror(errno));
+		keyboard_definition_delete(definition);
+		return NULL;
+	}
+	for(i = 0, keys = definition->buffer; i < KLS_COUNT; i++)
+	{
+		if((cnt = header->sections[i].count) == 0)
+			continue;
+		definition->keys[i] = keys;
+		k = (KeyboardDefinitionKey const *)&data[
+			header->sections[i].offset];
+		for(j = 0; j < cnt; j++, keys++)
+		{
+			keys->row = k[j].row;
+			keys->width = k[j].width;
+			keys->modifier = k[j].modifier;
+			keys->keysym = k[j].keysym;
+			keys->label = (k[j].label != 0) ? &data[k[j].label]
+				: NULL;
+		}
+		memset(keys++, 0, sizeof(*keys));
+	}
+	return definition;
+}
+
+static int _new_from_file_map(KeyboardDefinition * definition,
+		char const * filename)
+{
+	int fd;
+	struct stat st;
+
+	if((fd = open(filename, O_RDONLY)) < 0)
+		return -error_set_code(1, "%s: %s", filename, strerror(errno));
+	if(fstat(fd, &st) != 0)
+	{
+		error_set_code(1, "%s: %s", filename, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	definition->size = st.st_size;
+	if(definition->size >= sizeof(KeyboardDefinitionHeader)
+			&& (definition->data = mmap(NULL, definition->size,
+					PROT_READ, MAP_PRIVATE, fd, 0))
+			== MAP_FAILED)
+	{
+		error_set_code(1, "%s: %s", filename, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	if(definition->data == MAP_FAILED
+			|| _new_from_file_check(definition) != 0)
+		return -error_set_code(1, "%s: %s", filename,
+				"Invalid layout");
+	return 0;
+}
+
+static int _new_from_file_check(KeyboardDefinition * definition)
+{
+	KeyboardDefinitionHeader const * header = definition->data;
+	char const * data = definition->data;
+	KeyboardDefinitionKey const * k;
+	size_t i;
+	size_t j;
+
+	if(memcmp(header->magic, KEYBOARD_DEFINITION_MAGIC,
+				sizeof(header->magic)) != 0
+			|| header->version != KEYBOARD_DEFINITION_VERSION
+			|| header->size != definition->size
+			|| header->source.path >= definition->size
+			/* the labels must all be terminated */
+			|| data[definition->size - 1] != '\0')
+		return -1;
+	for(i = 0; i < KLS_COUNT; i++)
+	{
+		if(header->sections[i].offset % sizeof(uint32_t) != 0
+				|| header->sections[i].offset
+				> definition->size
+				|| header->sections[i].count
+				> (definition->size
+					- header->sections[i].offset)
+				/ sizeof(*k))
+			return -1;
+		k = (KeyboardDefinitionKey const *)&data[
+			header->sections[i].offset];
+		for(j = 0; j < header->sections[i].count; j++)
+			if(k[j].label >= definition->size
+					|| (k[j].label == 0 && k[j].keysym != 0)
+					|| (j == 0 && k[j].width == 0))
+				return -1;
+	}
+	return 0;
+}
+
+
+/* keyboard_definition_new_xkb */
+static int _new_xkb_hash(Display * display, uint32_t * hash);
+static int _new_xkb_walk(KeyboardDefinitionCompile * compile,
+		Display * display);
+static int _new_xkb_walk_key(KeyboardDefinitionCompile * compile,
+		KeyboardDefinitionXkb const * x, XkbDescPtr xkb,
+		unsigned int const * masks);
+static int _new_xkb_walk_label(KeyboardDefinitionCompile * compile,
+		KeySym keysym, uint32_t * offset);
+static unsigned int _new_xkb_walk_modifier(XkbKeyTypePtr type,
+		unsigned int level, unsigned int const * masks);
+
+KeyboardDefinition * keyboard_definition_new_xkb(Display * display)
+{
+	KeyboardDefinition * definition = NULL;
+	KeyboardDefinitionCompile compile;
+	uint32_t hash;
+	char name[16];
+	char * cache;
+	size_t i;
+
+	/* the pages are cached for each keymap met */
+	if(_new_xkb_hash(display, &hash) != 0)
+		return NULL;
+	snprintf(name, sizeof(name), "xkb-%08x", hash);
+	if((cache = _keyboard_definition_cache(name, NULL)) == NULL)
+		return NULL;
+	if(access(cache, R_OK) == 0 && (definition
+				= keyboard_definition_new_from_file(cache))
+			!= NULL)
+	{
+		g_free(cache);
+		return definition;
+	}
+	/* otherwise walk the XKB description once */
+	memset(&compile, 0, sizeof(compile));
+	compile.source = "XKB";
+	compile.labels_cnt = sizeof(KeyboardDefinitionHeader);
+	if(_new_xkb_walk(&compile, display) == 0
+			&& _compile_write(&compile, cache) == 0)
+		definition = keyboard_definition_new_from_file(cache);
+	for(i = 0; i < KLS_COUNT; i++)
+		free(compile.keys[i]);
+	free(compile.labels);
+	g_free(cache);
+	return definition;
+}
+
+static int _new_xkb_hash(Display * display, uint32_t * hash)
+{
+	uint32_t version = KEYBOARD_DEFINITION_XKB_VERSION;
+	Atom atom;
+	Atom type;
+	int format;
+	unsigned long cnt;
+	unsigned long after;
+	unsigned char * names = NULL;
+	int min;
+	int max;
+	int per;
+	KeySym * keysyms;
+
+	/* FNV-1a over the rules names and the keysyms currently bound */
+	*hash = 2166136261U;
+	*hash = _hash_update(*hash, &version, sizeof(version));
+	if((atom = XInternAtom(display, "_XKB_RULES_NAMES", True)) != None
+			&& XGetWindowProperty(display,
+				DefaultRootWindow(display), atom, 0, 1024,
+				False, XA_STRING, &type, &format, &cnt, &after,
+				&names) == Success && names != NULL)
+	{
+		if(format == 8)
+			*hash = _hash_update(*hash, names, cnt);
+		XFree(names);
+	}
+	XDisplayKeycodes(display, &min, &max);
+	if((keysyms = XGetKeyboardMapping(display, min, max - min + 1, &per))
+			== NULL)
+		return -error_set_code(1, "%s", "Could not obtain the keymap");
+	*hash = _hash_update(*hash, &min, sizeof(min));
+	*hash = _hash_update(*hash, &per, sizeof(per));
+	*hash = _hash_update(*hash, keysyms, sizeof(*keysyms)
+			* (max - min + 1) * per);
+	XFree(keysyms);
+	return 0;
+}
+
+static int _new_xkb_walk(KeyboardDefinitionCompile * compile,
+		Display * display)
+{
+	int ret = 0;
+	XkbDescPtr xkb;
+	unsigned int masks[KM_COUNT];
+	size_t i;
+
+	if((xkb = XkbGetMap(display, XkbKeyTypesMask | XkbKeySymsMask,
+					XkbUseCoreKbd)) == NULL)
+		return -error_set_code(1, "%s", "Could not obtain the XKB map");
+	if(XkbGetNames(display, XkbKeyNamesMask, xkb) != Success
+			|| xkb->names == NULL || xkb->names->keys == NULL)
+	{
+		XkbFreeKeyboard(xkb, 0, True);
+		return -error_set_code(1, "%s", "Could not obtain the XKB names");
+	}
+	/* the real modifiers behind each of ours */
+	memset(masks, 0, sizeof(masks));
+	masks[KM_SHIFT] = ShiftMask;
+	masks[KM_LEVEL3] = XkbKeysymToModifiers(display, XK_ISO_Level3_Shift);
+	masks[KM_NUMLOCK] = XkbKeysymToModifiers(display, XK_Num_Lock);
+	for(i = 0; ret == 0 && i < sizeof(_keyboard_definition_xkb)
+			/ sizeof(*_keyboard_definition_xkb); i++)
+		ret = _new_xkb_walk_key(compile, &_keyboard_definition_xkb[i],
+				xkb, masks);
+	XkbFreeKeyboard(xkb, 0, True);
+	return ret;
+}
+
+static int _new_xkb_walk_key(KeyboardDefinitionCompile * compile,
+		KeyboardDefinitionXkb const * x, XkbDescPtr xkb,
+		unsigned int const * masks)
+{
+	KeyboardDefinitionKey key;
+	XkbKeyTypePtr type;
+	unsigned int found = 0;
+	unsigned int level;
+	unsigned int mask;
+	int keycode;
+
+	key.row = x->row;
+	key.width = x->width;
+	key.modifier = x->modifier;
+	/* the fixed keys */
+	if(x->name == NULL)
+	{
+		key.keysym = x->keysym;
+		key.label = 0;
+		if(x->label != NULL && _compile_label(compile, x->label,
+					&key.label) != 0)
+			return -1;
+		return _compile_append(compile, x->section, &key);
+	}
+	for(keycode = xkb->min_key_code; keycode <= xkb->max_key_code;
+			keycode++)
+		if(strncmp(xkb->names->keys[keycode].name, x->name,
+					XkbKeyNameLength) == 0)
+			break;
+	/* skip the keys missing from this keymap */
+	if(keycode > xkb->max_key_code || XkbKeyNumGroups(xkb, keycode) == 0
+			|| (key.keysym = XkbKeySymEntry(xkb, keycode, 0, 0))
+			== NoSymbol)
+		return 0;
+	/* the modifiers keep their own label and only have one level */
+	if(x->label != NULL)
+	{
+		if(keysym_get_modifier(key.keysym) == KM_NONE)
+			return 0;
+		return (_compile_label(compile, x->label, &key.label) == 0)
+			? _compile_append(compile, x->section, &key) : -1;
+	}
+	if(_new_xkb_walk_label(compile, key.keysym, &key.label) != 0
+			|| _compile_append(compile, x->section, &key) != 0)
+		return -1;
+	/* then every other level of the first group, as a variant */
+	type = XkbKeyKeyType(xkb, keycode, 0);
+	key.width = 0;
+	for(level = 1; level < type->num_levels; level++)
+	{
+		key.keysym = XkbKeySymEntry(xkb, keycode, level, 0);
+		mask = _new_xkb_walk_modifier(type, level, masks);
+		if(key.keysym == NoSymbol || mask == KM_NONE
+				|| (found & (1 << mask)))
+			continue;
+		found |= (1 << mask);
+		key.modifier = mask;
+		if(_new_xkb_walk_label(compile, key.keysym, &key.label) != 0
+				|| _compile_append(compile, x->section, &key)
+				!= 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int _new_xkb_walk_label(KeyboardDefinitionCompile * compile,
+		KeySym keysym, uint32_t * offset)
+{
+	char buf[8];
+	gunichar c;
+	char const * label;
+	size_t i;
+
+	for(i = 0; i < sizeof(_keyboard_definition_xkb_dead)
+			/ sizeof(*_keyboard_definition_xkb_dead); i++)
+		if(_keyboard_definition_xkb_dead[i].keysym == keysym)
+			return _compile_label(compile,
+					_keyboard_definition_xkb_dead[i].label,
+					offset);
+	/* the character typed, or the name of the key otherwise */
+	if((c = gdk_keyval_to_unicode(keysym)) != 0 && g_unichar_isprint(c))
+	{
+		buf[g_unichar_to_utf8(c, buf)] = '\0';
+		label = buf;
+	}
+	else if((label = XKeysymToString(keysym)) == NULL)
+		label = "?";
+	return _compile_label(compile, label, offset);
+}
+
+static unsigned int _new_xkb_walk_modifier(XkbKeyTypePtr type,
+		unsigned int level, unsigned int const * masks)
+{
+	XkbKTMapEntryPtr entry;
+	unsigned int ret;
+	unsigned int mods;
+	unsigned int i;
+	unsigned int j;
+
+	/* the first combination of our modifiers reaching this level */
+	for(i = 0; i < type->map_count; i++)
+	{
+		entry = &type->map[i];
+		if(!entry->active || entry->level != level
+				|| entry->mods.mask == 0)
+			continue;
+		for(j = 1, ret = KM_NONE, mods = 0; j < KM_COUNT; j <<= 1)
+			if(masks[j] != 0 && (entry->mods.mask & masks[j])
+					== masks[j])
+			{
+				ret |= j;
+				mods |= masks[j];
+			}
+		/* ignore the levels reached with Lock or Control */
+		if(ret != KM_NONE && mods == entry->mods.mask)
+			return ret;
+	}
+	return KM_NONE;
+}
+
+
+/* keyboard_definition_delete */
+void keyboard_definition_delete(KeyboardDefinition * definition)
+{
+	free(definition->buffer);
+	if(definition->data != MAP_FAILED)
+		munmap(definition->data, definition->size);
+	free(definition);
+}
+
+
+/* accessors */
+/* keyboard_definition_get_keys */
+KeyboardKeyDefinition const * keyboard_definition_get_keys(
+		KeyboardDefinition * definition, KeyboardLayoutSection section)
+{
+	if(section >= KLS_COUNT)
+		return NULL;
+	return definition->keys[section];
+}
+
+
+/* useful */
+/* keyboard_definition_compile */
+static int _compile_line(KeyboardDefinitionCompile * compile, int section,
+		char * line);
+static int _compile_line_label(KeyboardDefinitionCompile * compile,
+		char * label, uint32_t * offset);
+static int _compile_line_modifier(KeyboardDefinitionCompile * compile,
+		char * modifier, uint32_t * mask);
+
+int keyboard_definition_compile(char const * source, char const * filename)
+{
+	int ret = 0;
+	KeyboardDefinitionCompile compile;
+	FILE * fp;
+	char buf[256];
+	size_t len;
+	int section = -1;
+	size_t i;
+
+	if((fp = fopen(source, "r")) == NULL)
+		return -error_set_code(1, "%s: %s", source, strerror(errno));
+	memset(&compile, 0, sizeof(compile));
+	compile.source = source;
+	/* the labels start after the header so that no offset is 0 */
+	compile.labels_cnt = sizeof(KeyboardDefinitionHeader);
+	/* remember the source to detect when it changes */
+	if(fstat(fileno(fp), &compile.st) != 0)
+		ret = -error_set_code(1, "%s: %s", source, strerror(errno));
+	else
+		ret = _compile_label(&compile, source, &compile.path);
+	for(compile.line = 1; ret == 0 && fgets(buf, sizeof(buf), fp) != NULL;
+			compile.line++)
+	{
+		if((len = strlen(buf)) > 0 && buf[len - 1] != '\n'
+				&& !feof(fp))
+		{
+			ret = _compile_error(&compile, NULL, "Line too long");
+			break;
+		}
+		for(; len > 0 && isspace((unsigned char)buf[len - 1]); len--)
+			buf[len - 1] = '\0';
+		if(buf[0] == '\0' || buf[0] == '#')
+			continue;
+		if(buf[0] == '[' && buf[len - 1] == ']')
+		{
+			buf[len - 1] = '\0';
+			for(section = 0; section < KLS_COUNT; section++)
+				if(strcmp(&buf[1], _keyboard_definition_sections[
+							section]) == 0)
+					break;
+			if(section == KLS_COUNT)
+				ret = _compile_error(&compile, &buf[1],
+						"Unknown section");
+		}
+		else if(section < 0)
+			ret = _compile_error(&compile, NULL,
+					"Key outside of a section");
+		else
+			ret = _compile_line(&compile, section, buf);
+	}
+	if(ret == 0 && ferror(fp))
+		ret = -error_set_code(1, "%s: %s", source, strerror(errno));
+	fclose(fp);
+	if(ret == 0)
+		ret = _compile_write(&compile, filename);
+	for(i = 0; i < KLS_COUNT; i++)
+		free(compile.keys[i]);
+	free(compile.labels);
+	return ret;
+}
+
+static int _compile_line(KeyboardDefinitionCompile * compile, int section,
+		char * line)
+{
+	KeyboardDefinitionKey key;
+	char * fields[5];
+	size_t i;
+	char * q;
+
+	/* row, width, modifiers, keysym and the optional label */
+	for(i = 0; i < sizeof(fields) / sizeof(*fields); i++)
+	{
+		for(; isspace((unsigned char)*line); line++);
+		fields[i] = (*line != '\0') ? line : NULL;
+		if(i == 4)
+			break;
+		for(; *line != '\0' && !isspace((unsigned char)*line); line++);
+		if(*line != '\0')
+			*(line++) = '\0';
+	}
+	if(fields[3] == NULL)
+		return _compile_error(compile, NULL, "Missing fields");
+	key.row = strtoul(fields[0], &q, 10);
+	if(*q != '\0')
+		return _compile_error(compile, fields[0], "Invalid row");
+	key.width = strtoul(fields[1], &q, 10);
+	if(*q != '\0')
+		return _compile_error(compile, fields[1], "Invalid width");
+	if(_compile_line_modifier(compile, fields[2], &key.modifier) != 0)
+		return -1;
+	if(strcmp(fields[3], "-") == 0)
+		key.keysym = NoSymbol;
+	else if((key.keysym = XStringToKeysym(fields[3])) == NoSymbol)
+		return _compile_error(compile, fields[3], "Unknown key");
+	/* only the blank spaces come without a label */
+	if(key.keysym == NoSymbol && fields[4] == NULL)
+		key.label = 0;
+	else if(fields[4] == NULL)
+		return _compile_error(compile, NULL, "Missing label");
+	else if(_compile_line_label(compile, fields[4], &key.label) != 0)
+		return -1;
+	if(key.width == 0 && (compile->keys_cnt[section] == 0
+				|| key.modifier == KM_NONE))
+		return _compile_error(compile, NULL, "Variant without a key");
+	return _compile_append(compile, section, &key);
+}
+
+static int _compile_line_label(KeyboardDefinitionCompile * compile,
+		char * label, uint32_t * offset)
+{
+	size_t len = strlen(label);
+	char * p;
+	char * q;
+
+	/* labels are quoted, and may escape quotes and backslashes */
+	if(len < 2 || label[0] != '"' || label[len - 1] != '"')
+		return _compile_error(compile, label, "Invalid label");
+	label[len - 1] = '\0';
+	for(p = &label[1], q = label; *p != '\0'; p++)
+	{
+		if(*p == '\\' && (p[1] == '"' || p[1] == '\\'))
+			p++;
+		*(q++) = *p;
+	}
+	*q = '\0';
+	return _compile_label(compile, label, offset);
+}
+
+static int _compile_line_modifier(KeyboardDefinitionCompile * compile,
+		char * modifier, uint32_t * mask)
+{
+	char * p;
+	size_t i;
+
+	*mask = KM_NONE;
+	if(strcmp(modifier, "-") == 0)
+		return 0;
+	for(p = strtok(modifier, "+"); p != NULL; p = strtok(NULL, "+"))
+	{
+		for(i = 0; i < sizeof(_keyboard_definition_modifiers)
+				/ sizeof(*_keyboard_definition_modifiers); i++)
+			if(strcmp(p, _keyboard_definition_modifiers[i].name)
+					== 0)
+				break;
+		if(i == sizeof(_keyboard_definition_modifiers)
+				/ sizeof(*_keyboard_definition_modifiers))
+			return _compile_error(compile, p, "Unknown modifier");
+		*mask |= _keyboard_definition_modifiers[i].modifier;
+	}
+	return 0;
+}
+
+
+/* private */
+/* functions */
+/* compile_append */
+static int _compile_append(KeyboardDefinitionCompile * compile, int section,
+		KeyboardDefinitionKey * key)
+{
+	KeyboardDefinitionKey * p;
+
+	if((p = realloc(compile->keys[section], sizeof(*p)
+					* (compile->keys_cnt[section] + 1)))
+			== NULL)
+		return _compile_error(compile, NULL, strerror(errno));
+	compile->keys[section] = p;
+	p[compile->keys_cnt[section]++] = *key;
+	return 0;
+}
+
+
+/* compile_error */
+static int _compile_error(KeyboardDefinitionCompile * compile,
+		char const * token, char const * message)
+{
+	return -error_set_code(1, "%s:%u: %s%s%s", compile->source,
+			compile->line, (token != NULL) ? token : "",
+			(token != NULL) ? ": " : "", message);
+}
+
+
+/* compile_label */
+static int _compile_label(KeyboardDefinitionCompile * compile,
+		char const * label, uint32_t * offset)
+{
+	size_t len = strlen(label) + 1;
+	char * p;
+
+	if((p = realloc(compile->labels, compile->labels_cnt + len)) == NULL)
+		return _compile_error(compile, NULL, strerror(errno));
+	compile->labels = p;
+	memcpy(&p[compile->labels_cnt], label, len);
+	/* relative to the labels for now */
+	*offset = compile->labels_cnt;
+	compile->labels_cnt += len;
+	return 0;
+}
+
+
+/* compile_write */
+static int _compile_write(KeyboardDefinitionCompile * compile,
+		char const * filename)
+{
+	int ret = 0;
+	KeyboardDefinitionHeader header;
+	char * tmp;
+	FILE * fp;
+	size_t offset;
+	size_t labels;
+	size_t i;
+	size_t j;
+
+	/* the labels are stored after the keys */
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, KEYBOARD_DEFINITION_MAGIC, sizeof(header.magic));
+	header.version = KEYBOARD_DEFINITION_VERSION;
+	for(i = 0, offset = sizeof(header); i < KLS_COUNT; i++)
+	{
+		header.sections[i].offset = offset;
+		header.sections[i].count = compile->keys_cnt[i];
+		offset += sizeof(**compile->keys) * compile->keys_cnt[i];
+	}
+	labels = offset - sizeof(header);
+	header.size = offset + compile->labels_cnt - sizeof(header);
+	if(compile->path != 0)
+	{
+		header.source.dev = compile->st.st_dev;
+		header.source.ino = compile->st.st_ino;
+		header.source.size = compile->st.st_size;
+		header.source.mtime = compile->st.st_mtime;
+		header.source.path = compile->path + labels;
+	}
+	if(compile->labels_cnt == sizeof(header))
+		/* the file must be terminated */
+		header.size++;
+	for(i = 0; i < KLS_COUNT; i++)
+		for(j = 0; j < compile->keys_cnt[i]; j++)
+			if(compile->keys[i][j].label != 0)
+				compile->keys[i][j].label += labels;
+	/* write atomically */
+	if((tmp = g_strdup_printf("%s.%u", filename, (unsigned)getpid()))
+			== NULL)
+		return -error_set_code(1, "%s", strerror(ENOMEM));
+	if((fp = fopen(tmp, "w")) == NULL)
+	{
+		ret = -error_set_code(1, "%s: %s", tmp, strerror(errno));
+		g_free(tmp);
+		return ret;
+	}
+	if(fwrite(&header, sizeof(header), 1, fp) != 1)
+		ret = -1;
+	for(i = 0; ret == 0 && i < KLS_COUNT; i++)
+		if(compile->keys_cnt[i] > 0 && fwrite(compile->keys[i],
+					sizeof(**compile->keys),
+					compile->keys_cnt[i], fp)
+				!= compile->keys_cnt[i])
+			ret = -1;
+	if(ret == 0 && compile->labels_cnt > sizeof(header)
+			&& fwrite(&compile->labels[sizeof(header)],
+				compile->labels_cnt - sizeof(header), 1, fp)
+			!= 1)
+		ret = -1;
+	if(ret == 0 && compile->labels_cnt == sizeof(header)
+			&& fputc('\0', fp) != '\0')
+		ret = -1;
+	if(fclose(fp) != 0)
+		ret = -1;
+	if(ret != 0 || rename(tmp, filename) != 0)
+	{
+		ret = -error_set_code(1, "%s: %s", filename, strerror(errno));
+		unlink(tmp);
+	}
+	g_free(tmp);
+	return ret;
+}
+
+
+/* keyboard_definition_cache */
+static char * _keyboard_definition_cache(char const * name,
+		char const * source)
+{
+	char * dirname;
+	char * basename;
+	char * filename;
+	uint32_t hash = 2166136261U;
+
+	dirname = g_build_filename(g_get_user_cache_dir(), PACKAGE, NULL);
+	if(g_mkdir_with_parents(dirname, 0700) != 0)
+	{
+		error_set_code(1, "%s: %s", dirname, strerror(errno));
+		g_free(dirname);
+		return NULL;
+	}
+	basename = g_path_get_basename(name);
+	if(g_str_has_suffix(basename, KEYBOARD_DEFINITION_SOURCE))
+		basename[strlen(basename) - strlen(KEYBOARD_DEFINITION_SOURCE)]
+			= '\0';
+	/* the layouts of the same name may come from different places */
+	if(source != NULL)
+	{
+		hash = _hash_update(hash, source, strlen(source));
+		filename = g_strdup_printf("%s/%s-%08x%s", dirname, basename,
+				hash, KEYBOARD_DEFINITION_CACHE);
+	}
+	else
+		filename = g_strdup_printf("%s/%s%s", dirname, basename,
+				KEYBOARD_DEFINITION_CACHE);
+	g_free(basename);
+	g_free(dirname);
+	return filename;
+}
+
+
+/* keyboard_definition_source */
+static char * _keyboard_definition_source(char const * name)
+{
+	char * filename;
+	char const * dirs[2];
+	size_t i;
+
+	/* explicit paths are used as is */
+	if(strchr(name, '/') != NULL)
+		return g_strdup(name);
+	dirs[0] = g_get_user_data_dir();
+	dirs[1] = DATADIR;
+	for(i = 0; i < sizeof(dirs) / sizeof(*dirs); i++)
+	{
+		filename = g_strdup_printf("%s/%s/%s/%s%s", dirs[i], PACKAGE,
+				"layouts", name, KEYBOARD_DEFINITION_SOURCE);
+		if(access(filename, R_OK) == 0)
+			return filename;
+		g_free(filename);
+	}
+	error_set_code(1, "%s: %s", name, "Layout not found");
+	return NULL;
+}
+
+
+/* hash_update */
+static uint32_t _hash_update(uint32_t hash, void const * data, size_t size)
+{
+	unsigned char const * p = data;
+	size_t i;
+
+	/* FNV-1a */
+	for(i = 0; i < size; i++)
+	{
+		hash ^= p[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
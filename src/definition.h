@@ -0,0 +1,75 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+
+#ifndef KEYBOARD_DEFINITION_H
+# define KEYBOARD_DEFINITION_H
+
+# include <X11/Xlib.h>
+
+
+/* KeyboardDefinition */
+/* types */
+typedef struct _KeyboardDefinition KeyboardDefinition;
+
+typedef struct _KeyboardKeyDefinition
+{
+	unsigned int row;
+	unsigned int width;
+	unsigned int modifier;
+	unsigned int keysym;
+	char const * label;
+} KeyboardKeyDefinition;
+
+typedef enum _KeyboardLayoutSection
+{
+	KLS_LETTERS = 0,
+	KLS_KEYPAD,
+	KLS_SPECIAL
+} KeyboardLayoutSection;
+# define KLS_LAST KLS_SPECIAL
+# define KLS_COUNT (KLS_LAST + 1)
+
+
+/* functions */
+KeyboardDefinition * keyboard_definition_new(char const * name);
+KeyboardDefinition * keyboard_definition_new_builtin(char const * name);
+KeyboardDefinition * keyboard_definition_new_from_file(char const * filename);
+KeyboardDefinition * keyboard_definition_new_xkb(Display * display);
+void keyboard_definition_delete(KeyboardDefinition * definition);
+
+/* accessors */
+KeyboardKeyDefinition const * keyboard_definition_get_keys(
+		KeyboardDefinition * definition, KeyboardLayoutSection section);
+
+/* useful */
+int keyboard_definition_compile(char const * source, char const * filename);
+
+#endif /* !KEYBOARD_DEFINITION_H */
@@ -0,0 +1,647 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <System.h>
+#include "dictionary.h"
+#include "../config.h"
+
+/* constants */
+#ifndef PREFIX
+# define PREFIX		"/usr/local"
+#endif
+#ifndef DATADIR
+# define DATADIR	PREFIX "/share"
+#endif
+
+
+/* KeyboardDictionary */
+/* private */
+/* constants */
+#define KEYBOARD_DICTIONARY_MAGIC	"KbdD"
+#define KEYBOARD_DICTIONARY_VERSION	1
+
+#define KEYBOARD_DICTIONARY_EXTENSION	".kdc"
+
+
+/* types */
+/* compiled form */
+typedef struct _KeyboardDictionaryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t size;
+	uint32_t count;			/* the nodes, from the sentinel */
+} KeyboardDictionaryHeader;
+
+/* the children of every node are stored together, sorted */
+typedef struct _KeyboardDictionaryNode
+{
+	uint32_t parent;
+	uint32_t children;		/* the first child, or 0 */
+	uint32_t frequency;		/* 0 unless a word ends here */
+	uint32_t top[KEYBOARD_DICTIONARY_TOP];	/* the words below, or 0 */
+	uint8_t byte;
+	uint8_t count;			/* the number of children */
+	uint8_t padding[2];
+} KeyboardDictionaryNode;
+
+struct _KeyboardDictionary
+{
+	void * data;
+	size_t size;
+	KeyboardDictionaryNode const * nodes;
+	uint32_t count;
+};
+
+/* compilation */
+typedef struct _KeyboardDictionaryCompileNode
+{
+	uint32_t first;			/* the first child, or 0 */
+	uint32_t next;			/* the next sibling, or 0 */
+	uint32_t frequency;
+	unsigned char byte;
+} KeyboardDictionaryCompileNode;
+
+typedef struct _KeyboardDictionaryCompile
+{
+	char const * source;
+	unsigned int line;
+
+	/* the root comes first */
+	KeyboardDictionaryCompileNode * nodes;
+	size_t nodes_cnt;
+	size_t nodes_size;
+} KeyboardDictionaryCompile;
+
+
+/* prototypes */
+static int _dictionary_compile_error(KeyboardDictionaryCompile * compile,
+		char const * message);
+static int _dictionary_compile_insert(KeyboardDictionaryCompile * compile,
+		char const * word, uint32_t frequency);
+static int _dictionary_compile_line(KeyboardDictionaryCompile * compile,
+		char * line);
+static int _dictionary_compile_node(KeyboardDictionaryCompile * compile,
+		unsigned char c, uint32_t next);
+static int _dictionary_compile_write(KeyboardDictionaryCompile * compile,
+		char const * filename);
+
+static int _keyboard_dictionary_check(KeyboardDictionary * dictionary);
+
+
+/* public */
+/* functions */
+/* keyboard_dictionary_new */
+KeyboardDictionary * keyboard_dictionary_new(char const * name)
+{
+	KeyboardDictionary * dictionary;
+	char * filename;
+	char const * dirs[2];
+	size_t i;
+
+	/* explicit paths are used as is */
+	if(strchr(name, '/') != NULL)
+		return keyboard_dictionary_new_from_file(name);
+	dirs[0] = g_get_user_data_dir();
+	dirs[1] = DATADIR;
+	for(i = 0; i < sizeof(dirs) / sizeof(*dirs); i++)
+	{
+		filename = g_strdup_printf("%s/%s/%s/%s%s", dirs[i], PACKAGE,
+				"dictionaries", name,
+				KEYBOARD_DICTIONARY_EXTENSION);
+		if(access(filename, R_OK) == 0)
+		{
+			dictionary = keyboard_dictionary_new_from_file(
+					filename);
+			g_free(filename);
+			return dictionary;
+		}
+		g_free(filename);
+	}
+	error_set_code(1, "%s: %s", name, "Dictionary not found");
+	return NULL;
+}
+
+
+/* keyboard_dictionary_new_from_file */
+KeyboardDictionary * keyboard_dictionary_new_from_file(char const * filename)
+{
+	KeyboardDictionary * dictionary;
+	int fd;
+	struct stat st;
+
+	if((dictionary = malloc(sizeof(*dictionary))) == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		return NULL;
+	}
+	dictionary->data = MAP_FAILED;
+	if((fd = open(filename, O_RDONLY)) < 0 || fstat(fd, &st) != 0)
+	{
+		error_set_code(1, "%s: %s", filename, strerror(errno));
+		if(fd >= 0)
+			close(fd);
+		keyboard_dictionary_delete(dictionary);
+		return NULL;
+	}
+	dictionary->size = st.st_size;
+	if(dictionary->size >= sizeof(KeyboardDictionaryHeader)
+			&& (dictionary->data = mmap(NULL, dictionary->size,
+					PROT_READ, MAP_PRIVATE, fd, 0))
+			== MAP_FAILED)
+	{
+		error_set_code(1, "%s: %s", filename, strerror(errno));
+		close(fd);
+		keyboard_dictionary_delete(dictionary);
+		return NULL;
+	}
+	close(fd);
+	if(dictionary->data == MAP_FAILED
+			|| _keyboard_dictionary_check(dictionary) != 0)
+	{
+		error_set_code(1, "%s: %s", filename, "Invalid dictionary");
+		keyboard_dictionary_delete(dictionary);
+		return NULL;
+	}
+	return dictionary;
+}
+
+
+/* keyboard_dictionary_delete */
+void keyboard_dictionary_delete(KeyboardDictionary * dictionary)
+{
+	if(dictionary->data != MAP_FAILED)
+		munmap(dictionary->data, dictionary->size);
+	free(dictionary);
+}
+
+
+/* accessors */
+/* keyboard_dictionary_get_byte */
+unsigned char keyboard_dictionary_get_byte(KeyboardDictionary * dictionary,
+		uint32_t cursor)
+{
+	if(cursor == KEYBOARD_DICTIONARY_NONE || cursor >= dictionary->count)
+		return '\0';
+	return dictionary->nodes[cursor].byte;
+}
+
+
+/* keyboard_dictionary_get_children */
+uint32_t keyboard_dictionary_get_children(KeyboardDictionary * dictionary,
+		uint32_t cursor, size_t * count)
+{
+	if(cursor == KEYBOARD_DICTIONARY_NONE || cursor >= dictionary->count
+			|| dictionary->nodes[cursor].count == 0)
+	{
+		*count = 0;
+		return KEYBOARD_DICTIONARY_NONE;
+	}
+	*count = dictionary->nodes[cursor].count;
+	return dictionary->nodes[cursor].children;
+}
+
+
+/* keyboard_dictionary_get_frequency */
+uint32_t keyboard_dictionary_get_frequency(KeyboardDictionary * dictionary,
+		uint32_t cursor)
+{
+	if(cursor == KEYBOARD_DICTIONARY_NONE || cursor >= dictionary->count)
+		return 0;
+	return dictionary->nodes[cursor].frequency;
+}
+
+
+/* keyboard_dictionary_get_weight */
+uint32_t keyboard_dictionary_get_weight(KeyboardDictionary * dictionary,
+		uint32_t cursor)
+{
+	if(cursor == KEYBOARD_DICTIONARY_NONE || cursor >= dictionary->count)
+		return 0;
+	return keyboard_dictionary_get_frequency(dictionary,
+			dictionary->nodes[cursor].top[0]);
+}
+
+
+/* keyboard_dictionary_get_word */
+int keyboard_dictionary_get_word(KeyboardDictionary * dictionary,
+		uint32_t cursor, char word[KEYBOARD_DICTIONARY_WORD])
+{
+	KeyboardDictionaryNode const * nodes = dictionary->nodes;
+	size_t len;
+	size_t i;
+	uint32_t n;
+	char c;
+
+	if(cursor == KEYBOARD_DICTIONARY_NONE || cursor >= dictionary->count)
+		return -1;
+	/* spell the word backwards from its end */
+	for(n = cursor, len = 0; n > KEYBOARD_DICTIONARY_ROOT
+			&& len < KEYBOARD_DICTIONARY_WORD - 1;
+			n = nodes[n].parent)
+		word[len++] = nodes[n].byte;
+	if(n != KEYBOARD_DICTIONARY_ROOT)
+		return -1;
+	word[len] = '\0';
+	for(i = 0; i < len / 2; i++)
+	{
+		c = word[i];
+		word[i] = word[len - i - 1];
+		word[len - i - 1] = c;
+	}
+	return 0;
+}
+
+
+/* useful */
+/* keyboard_dictionary_compile */
+int keyboard_dictionary_compile(char const * source, char const * filename)
+{
+	int ret = 0;
+	KeyboardDictionaryCompile compile;
+	FILE * fp;
+	char buf[256];
+	size_t len;
+
+	if((fp = fopen(source, "r")) == NULL)
+		return -error_set_code(1, "%s: %s", source, strerror(errno));
+	compile.source = source;
+	compile.line = 0;
+	compile.nodes = NULL;
+	compile.nodes_cnt = 0;
+	compile.nodes_size = 0;
+	/* the root */
+	if(_dictionary_compile_node(&compile, '\0', 0) != 0)
+		ret = -1;
+	while(ret == 0 && fgets(buf, sizeof(buf), fp) != NULL)
+	{
+		compile.line++;
+		if((len = strlen(buf)) > 0 && buf[len - 1] == '\n')
+			buf[--len] = '\0';
+		else if(!feof(fp))
+		{
+			ret = _dictionary_compile_error(&compile,
+					"Line too long");
+			break;
+		}
+		if(len > 0 && buf[len - 1] == '\r')
+			buf[--len] = '\0';
+		ret = _dictionary_compile_line(&compile, buf);
+	}
+	if(ret == 0 && ferror(fp))
+		ret = -error_set_code(1, "%s: %s", source, strerror(errno));
+	fclose(fp);
+	if(ret == 0)
+		ret = _dictionary_compile_write(&compile, filename);
+	free(compile.nodes);
+	return ret;
+}
+
+
+/* keyboard_dictionary_next */
+uint32_t keyboard_dictionary_next(KeyboardDictionary * dictionary,
+		uint32_t cursor, unsigned char c)
+{
+	KeyboardDictionaryNode const * nodes = dictionary->nodes;
+	uint32_t first;
+	uint32_t last;
+	uint32_t i;
+
+	if(cursor == KEYBOARD_DICTIONARY_NONE || cursor >= dictionary->count
+			|| nodes[cursor].count == 0)
+		return KEYBOARD_DICTIONARY_NONE;
+	first = nodes[cursor].children;
+	last = first + nodes[cursor].count;
+	while(first < last)
+	{
+		i = first + (last - first) / 2;
+		if(nodes[i].byte == c)
+			return i;
+		else if(nodes[i].byte < c)
+			first = i + 1;
+		else
+			last = i;
+	}
+	return KEYBOARD_DICTIONARY_NONE;
+}
+
+
+/* keyboard_dictionary_complete */
+size_t keyboard_dictionary_complete(KeyboardDictionary * dictionary,
+		uint32_t cursor,
+		char words[KEYBOARD_DICTIONARY_TOP][KEYBOARD_DICTIONARY_WORD])
+{
+	KeyboardDictionaryNode const * nodes = dictionary->nodes;
+	size_t ret = 0;
+	size_t i;
+
+	if(cursor == KEYBOARD_DICTIONARY_NONE || cursor >= dictionary->count)
+		return 0;
+	for(i = 0; i < KEYBOARD_DICTIONARY_TOP
+			&& nodes[cursor].top[i] != 0; i++)
+		if(keyboard_dictionary_get_word(dictionary,
+					nodes[cursor].top[i], words[ret]) == 0)
+			ret++;
+	return ret;
+}
+
+
+/* private */
+/* functions */
+/* dictionary_compile_error */
+static int _dictionary_compile_error(KeyboardDictionaryCompile * compile,
+		char const * message)
+{
+	return -error_set_code(1, "%s:%u: %s", compile->source, compile->line,
+			message);
+}
+
+
+/* dictionary_compile_insert */
+static int _dictionary_compile_insert(KeyboardDictionaryCompile * compile,
+		char const * word, uint32_t frequency)
+{
+	KeyboardDictionaryCompileNode * nodes;
+	uint32_t node = 0;
+	uint32_t prev;
+	uint32_t child;
+	unsigned char c;
+	int n;
+
+	for(; *word != '\0'; word++)
+	{
+		c = *word;
+		nodes = compile->nodes;
+		/* keep the siblings sorted */
+		for(prev = 0, child = nodes[node].first; child != 0
+				&& nodes[child].byte < c;
+				child = nodes[child].next)
+			prev = child;
+		if(child == 0 || nodes[child].byte != c)
+		{
+			if((n = _dictionary_compile_node(compile, c, child))
+					< 0)
+				return -1;
+			child = n;
+			if(prev == 0)
+				compile->nodes[node].first = child;
+			else
+				compile->nodes[prev].next = child;
+		}
+		node = child;
+	}
+	/* the duplicates keep their highest frequency */
+	if(frequency > compile->nodes[node].frequency)
+		compile->nodes[node].frequency = frequency;
+	return 0;
+}
+
+
+/* dictionary_compile_node */
+static int _dictionary_compile_node(KeyboardDictionaryCompile * compile,
+		unsigned char c, uint32_t next)
+{
+	KeyboardDictionaryCompileNode * p;
+
+	if(compile->nodes_cnt == compile->nodes_size)
+	{
+		if(compile->nodes_size >= INT32_MAX - 4096
+				|| (p = realloc(compile->nodes, sizeof(*p)
+						* (compile->nodes_size + 4096)))
+				== NULL)
+			return -error_set_code(1, "%s", strerror(ENOMEM));
+		compile->nodes = p;
+		compile->nodes_size += 4096;
+	}
+	p = &compile->nodes[compile->nodes_cnt];
+	p->first = 0;
+	p->next = next;
+	p->frequency = 0;
+	p->byte = c;
+	return compile->nodes_cnt++;
+}
+
+
+/* dictionary_compile_line */
+static int _dictionary_compile_line(KeyboardDictionaryCompile * compile,
+		char * line)
+{
+	int ret;
+	char * word;
+	char * p;
+	unsigned long frequency = 1;
+
+	/* word [frequency] */
+	line += strspn(line, " \t");
+	if(line[0] == '\0' || line[0] == '#')
+		return 0;
+	word = line;
+	line += strcspn(line, " \t");
+	if(*line != '\0')
+	{
+		*(line++) = '\0';
+		line += strspn(line, " \t");
+	}
+	if(*line != '\0')
+	{
+		frequency = strtoul(line, &p, 10);
+		p += strspn(p, " \t");
+		if(*p != '\0' || frequency == 0 || frequency > UINT32_MAX)
+			return _dictionary_compile_error(compile,
+					"Invalid frequency");
+	}
+	if(!g_utf8_validate(word, -1, NULL))
+		return _dictionary_compile_error(compile, "Invalid word");
+	/* the prefixes are looked up in lower case */
+	if((word = g_utf8_strdown(word, -1)) == NULL)
+		return -error_set_code(1, "%s", strerror(ENOMEM));
+	if(strlen(word) >= KEYBOARD_DICTIONARY_WORD)
+		ret = _dictionary_compile_error(compile, "Word too long");
+	else
+		ret = _dictionary_compile_insert(compile, word, frequency);
+	g_free(word);
+	return ret;
+}
+
+
+/* dictionary_compile_write */
+static void _compile_write_top(KeyboardDictionaryNode * nodes,
+		uint32_t * top, uint32_t word);
+
+static int _dictionary_compile_write(KeyboardDictionaryCompile * compile,
+		char const * filename)
+{
+	int ret = 0;
+	KeyboardDictionaryHeader header;
+	KeyboardDictionaryNode * nodes;
+	uint32_t * order;
+	size_t count = compile->nodes_cnt + 1;
+	size_t i;
+	size_t j;
+	size_t n;
+	uint32_t child;
+	char * tmp;
+	FILE * fp;
+
+	if((nodes = calloc(count, sizeof(*nodes))) == NULL
+			|| (order = malloc(sizeof(*order) * count)) == NULL)
+	{
+		free(nodes);
+		return -error_set_code(1, "%s", strerror(errno));
+	}
+	/* lay the children of every node out together, breadth first */
+	order[KEYBOARD_DICTIONARY_ROOT] = 0;
+	for(i = KEYBOARD_DICTIONARY_ROOT, n = i + 1; i < count; i++)
+	{
+		child = compile->nodes[order[i]].first;
+		nodes[i].children = (child != 0) ? n : 0;
+		for(; child != 0; child = compile->nodes[child].next, n++)
+		{
+			order[n] = child;
+			nodes[n].parent = i;
+			nodes[n].frequency = compile->nodes[child].frequency;
+			nodes[n].byte = compile->nodes[child].byte;
+			nodes[i].count++;
+		}
+	}
+	/* the children come after their parent */
+	for(i = count - 1; i >= KEYBOARD_DICTIONARY_ROOT; i--)
+	{
+		if(nodes[i].frequency != 0)
+			_compile_write_top(nodes, nodes[i].top, i);
+		for(j = 0; j < nodes[i].count; j++)
+			for(n = 0; n < KEYBOARD_DICTIONARY_TOP; n++)
+				_compile_write_top(nodes, nodes[i].top,
+						nodes[nodes[i].children + j]
+						.top[n]);
+	}
+	free(order);
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, KEYBOARD_DICTIONARY_MAGIC, sizeof(header.magic));
+	header.version = KEYBOARD_DICTIONARY_VERSION;
+	header.size = sizeof(header) + sizeof(*nodes) * count;
+	header.count = count;
+	/* write atomically */
+	if((tmp = g_strdup_printf("%s.%u", filename, (unsigned)getpid()))
+			== NULL)
+	{
+		free(nodes);
+		return -error_set_code(1, "%s", strerror(ENOMEM));
+	}
+	if((fp = fopen(tmp, "w")) == NULL)
+		ret = -error_set_code(1, "%s: %s", tmp, strerror(errno));
+	else
+	{
+		if(fwrite(&header, sizeof(header), 1, fp) != 1
+				|| fwrite(nodes, sizeof(*nodes), count, fp)
+				!= count)
+			ret = -1;
+		if(fclose(fp) != 0)
+			ret = -1;
+		if(ret != 0 || rename(tmp, filename) != 0)
+		{
+			ret = -error_set_code(1, "%s: %s", filename,
+					strerror(errno));
+			unlink(tmp);
+		}
+	}
+	g_free(tmp);
+	free(nodes);
+	return ret;
+}
+
+static void _compile_write_top(KeyboardDictionaryNode * nodes,
+		uint32_t * top, uint32_t word)
+{
+	size_t i;
+	uint32_t t;
+
+	/* keep the most frequent words first, and the first ones met */
+	for(i = 0; word != 0 && i < KEYBOARD_DICTIONARY_TOP; i++)
+		if(top[i] == 0 || nodes[word].frequency
+				> nodes[top[i]].frequency)
+		{
+			t = top[i];
+			top[i] = word;
+			word = t;
+		}
+}
+
+
+/* keyboard_dictionary_check */
+static int _keyboard_dictionary_check(KeyboardDictionary * dictionary)
+{
+	KeyboardDictionaryHeader const * header = dictionary->data;
+	KeyboardDictionaryNode const * nodes;
+	uint32_t count;
+	uint32_t i;
+	size_t j;
+
+	if(memcmp(header->magic, KEYBOARD_DICTIONARY_MAGIC,
+				sizeof(header->magic)) != 0
+			|| header->version != KEYBOARD_DICTIONARY_VERSION
+			|| header->size != dictionary->size
+			|| (dictionary->size - sizeof(*header))
+			% sizeof(*nodes) != 0
+			|| (count = header->count) != (dictionary->size
+				- sizeof(*header)) / sizeof(*nodes)
+			|| count <= KEYBOARD_DICTIONARY_ROOT)
+		return -1;
+	nodes = (KeyboardDictionaryNode const *)&header[1];
+	/* the parents come first, so that spelling always ends */
+	for(i = KEYBOARD_DICTIONARY_ROOT; i < count; i++)
+	{
+		if((i == KEYBOARD_DICTIONARY_ROOT) ? nodes[i].parent != 0
+				: (nodes[i].parent < KEYBOARD_DICTIONARY_ROOT
+					|| nodes[i].parent >= i))
+			return -1;
+		/* without wrapping around on the counts */
+		if(nodes[i].count > 0 && (nodes[i].count > count
+					|| nodes[i].children <= i
+					|| nodes[i].children > count
+					- nodes[i].count))
+			return -1;
+		for(j = 0; j < KEYBOARD_DICTIONARY_TOP; j++)
+			if(nodes[i].top[j] >= count)
+				return -1;
+	}
+	dictionary->nodes = nodes;
+	dictionary->count = count;
+	return 0;
+}
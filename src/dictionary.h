@@ -0,0 +1,81 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+#ifndef KEYBOARD_DICTIONARY_H
+# define KEYBOARD_DICTIONARY_H
+
+# include <sys/types.h>
+# include <stdint.h>
+
+
+/* KeyboardDictionary */
+/* constants */
+/* the number of completions kept for every prefix */
+# define KEYBOARD_DICTIONARY_TOP	3
+/* the longest word in bytes, including the terminator */
+# define KEYBOARD_DICTIONARY_WORD	64
+
+/* the cursors */
+# define KEYBOARD_DICTIONARY_NONE	0
+# define KEYBOARD_DICTIONARY_ROOT	1
+
+
+/* types */
+typedef struct _KeyboardDictionary KeyboardDictionary;
+
+
+/* functions */
+KeyboardDictionary * keyboard_dictionary_new(char const * name);
+KeyboardDictionary * keyboard_dictionary_new_from_file(char const * filename);
+void keyboard_dictionary_delete(KeyboardDictionary * dictionary);
+
+/* accessors */
+unsigned char keyboard_dictionary_get_byte(KeyboardDictionary * dictionary,
+		uint32_t cursor);
+uint32_t keyboard_dictionary_get_children(KeyboardDictionary * dictionary,
+		uint32_t cursor, size_t * count);
+uint32_t keyboard_dictionary_get_frequency(KeyboardDictionary * dictionary,
+		uint32_t cursor);
+/* the frequency of the most frequent word from there */
+uint32_t keyboard_dictionary_get_weight(KeyboardDictionary * dictionary,
+		uint32_t cursor);
+int keyboard_dictionary_get_word(KeyboardDictionary * dictionary,
+		uint32_t cursor, char word[KEYBOARD_DICTIONARY_WORD]);
+
+/* useful */
+int keyboard_dictionary_compile(char const * source, char const * filename);
+
+/* the cursors track the prefix typed, one byte at a time */
+uint32_t keyboard_dictionary_next(KeyboardDictionary * dictionary,
+		uint32_t cursor, unsigned char c);
+size_t keyboard_dictionary_complete(KeyboardDictionary * dictionary,
+		uint32_t cursor,
+		char words[KEYBOARD_DICTIONARY_TOP][KEYBOARD_DICTIONARY_WORD]);
+
+#endif /* !KEYBOARD_DICTIONARY_H */
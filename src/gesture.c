@@ -0,0 +1,485 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <System.h>
+#include "gesture.h"
+
+
+/* KeyboardGesture */
+/* private */
+/* constants */
+#define KEYBOARD_GESTURE_BEAM		64
+#define KEYBOARD_GESTURE_CHILDREN	256
+#define KEYBOARD_GESTURE_KEYS		64
+#define KEYBOARD_GESTURE_POINTS		256
+#define KEYBOARD_GESTURE_SAMPLES	32
+
+/* in letters */
+#define KEYBOARD_GESTURE_RADIUS		1.2	/* the farthest from a letter */
+#define KEYBOARD_GESTURE_SPACING	0.25	/* between the points kept */
+#define KEYBOARD_GESTURE_SWIPE		1.0	/* the shortest swipe */
+
+/* the weights of the scores */
+#define KEYBOARD_GESTURE_ENDS		4.0	/* where it starts and ends */
+#define KEYBOARD_GESTURE_LENGTH		1.0
+#define KEYBOARD_GESTURE_FREQUENCY	0.05
+
+
+/* types */
+typedef struct _KeyboardGesturePoint
+{
+	gdouble x;
+	gdouble y;
+} KeyboardGesturePoint;
+
+typedef struct _KeyboardGestureKey
+{
+	gunichar c;
+	KeyboardGesturePoint centre;
+} KeyboardGestureKey;
+
+typedef struct _KeyboardGestureChild
+{
+	gunichar c;
+	uint32_t node;
+} KeyboardGestureChild;
+
+typedef struct _KeyboardGestureState
+{
+	uint32_t node;
+	size_t sample;			/* the last one matched */
+	size_t letters;
+	KeyboardGesturePoint const * last;
+	gdouble cost;
+	gdouble length;
+	gdouble score;			/* for the beam */
+} KeyboardGestureState;
+
+typedef struct _KeyboardGestureResult
+{
+	uint32_t node;
+	gdouble score;
+} KeyboardGestureResult;
+
+struct _KeyboardGesture
+{
+	KeyboardDictionary * dictionary;
+
+	/* everything is measured in letters */
+	gdouble size;
+	KeyboardGestureKey keys[KEYBOARD_GESTURE_KEYS];
+	size_t keys_cnt;
+
+	/* the path */
+	KeyboardGesturePoint points[KEYBOARD_GESTURE_POINTS];
+	size_t points_cnt;
+	gdouble spacing;
+	gdouble length;
+
+	/* allocated once for decoding */
+	KeyboardGesturePoint samples[KEYBOARD_GESTURE_SAMPLES];
+	size_t samples_cnt;
+	KeyboardGestureState beams[2][KEYBOARD_GESTURE_BEAM];
+	KeyboardGestureChild children[KEYBOARD_GESTURE_CHILDREN];
+};
+
+
+/* prototypes */
+static size_t _keyboard_gesture_beam(KeyboardGestureState * beam, size_t cnt,
+		KeyboardGestureState * state);
+static size_t _keyboard_gesture_children(KeyboardGesture * gesture,
+		uint32_t node, char * buf, size_t len, size_t cnt);
+static gdouble _keyboard_gesture_distance(KeyboardGesturePoint const * p1,
+		KeyboardGesturePoint const * p2);
+static KeyboardGestureKey const * _keyboard_gesture_key(
+		KeyboardGesture * gesture, gunichar c);
+static void _keyboard_gesture_resample(KeyboardGesture * gesture);
+static size_t _keyboard_gesture_result(KeyboardGestureResult * results,
+		size_t cnt, uint32_t node, gdouble score);
+
+
+/* public */
+/* functions */
+/* keyboard_gesture_new */
+KeyboardGesture * keyboard_gesture_new(KeyboardDictionary * dictionary)
+{
+	KeyboardGesture * gesture;
+
+	if((gesture = malloc(sizeof(*gesture))) == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		return NULL;
+	}
+	gesture->dictionary = dictionary;
+	keyboard_gesture_start(gesture, 1.0);
+	return gesture;
+}
+
+
+/* keyboard_gesture_delete */
+void keyboard_gesture_delete(KeyboardGesture * gesture)
+{
+	free(gesture);
+}
+
+
+/* accessors */
+/* keyboard_gesture_is_swipe */
+gboolean keyboard_gesture_is_swipe(KeyboardGesture * gesture)
+{
+	return (gesture->keys_cnt > 0
+			&& gesture->length >= KEYBOARD_GESTURE_SWIPE)
+		? TRUE : FALSE;
+}
+
+
+/* useful */
+/* keyboard_gesture_start */
+void keyboard_gesture_start(KeyboardGesture * gesture, gdouble size)
+{
+	gesture->size = (size > 0.0) ? size : 1.0;
+	gesture->keys_cnt = 0;
+	gesture->points_cnt = 0;
+	gesture->spacing = KEYBOARD_GESTURE_SPACING;
+	gesture->length = 0.0;
+}
+
+
+/* keyboard_gesture_add_key */
+int keyboard_gesture_add_key(KeyboardGesture * gesture, gunichar c,
+		gdouble x, gdouble y)
+{
+	KeyboardGestureKey * key;
+
+	c = g_unichar_tolower(c);
+	if(_keyboard_gesture_key(gesture, c) != NULL)
+		return 0;
+	if(gesture->keys_cnt == KEYBOARD_GESTURE_KEYS)
+		return -1;
+	key = &gesture->keys[gesture->keys_cnt++];
+	key->c = c;
+	key->centre.x = x / gesture->size;
+	key->centre.y = y / gesture->size;
+	return 0;
+}
+
+
+/* keyboard_gesture_add_point */
+void keyboard_gesture_add_point(KeyboardGesture * gesture, gdouble x,
+		gdouble y)
+{
+	KeyboardGesturePoint p;
+	gdouble d;
+	size_t i;
+
+	p.x = x / gesture->size;
+	p.y = y / gesture->size;
+	if(gesture->points_cnt > 0)
+	{
+		d = _keyboard_gesture_distance(
+				&gesture->points[gesture->points_cnt - 1], &p);
+		if(d < gesture->spacing)
+			return;
+		gesture->length += d;
+	}
+	/* keep every other point when full */
+	if(gesture->points_cnt == KEYBOARD_GESTURE_POINTS)
+	{
+		for(i = 1; i < KEYBOARD_GESTURE_POINTS / 2; i++)
+			gesture->points[i] = gesture->points[i * 2];
+		gesture->points_cnt = KEYBOARD_GESTURE_POINTS / 2;
+		gesture->spacing *= 2.0;
+	}
+	gesture->points[gesture->points_cnt++] = p;
+}
+
+
+/* keyboard_gesture_decode */
+static int _decode_extend(KeyboardGesture * gesture,
+		KeyboardGestureState const * s, KeyboardGestureKey const * key,
+		KeyboardGestureState * n);
+static size_t _decode_word(KeyboardGesture * gesture,
+		KeyboardGestureResult * results, size_t cnt,
+		KeyboardGestureState const * n);
+
+size_t keyboard_gesture_decode(KeyboardGesture * gesture,
+		char words[KEYBOARD_DICTIONARY_TOP][KEYBOARD_DICTIONARY_WORD])
+{
+	KeyboardGestureResult results[KEYBOARD_DICTIONARY_TOP];
+	size_t results_cnt = 0;
+	KeyboardGestureState * beam;
+	size_t beam_cnt;
+	KeyboardGestureState * next;
+	size_t next_cnt;
+	KeyboardGestureState n;
+	KeyboardGestureKey const * key;
+	char buf[6];
+	size_t depth;
+	size_t cnt;
+	size_t i;
+	size_t j;
+
+	if(gesture->points_cnt == 0 || gesture->keys_cnt == 0)
+		return 0;
+	_keyboard_gesture_resample(gesture);
+	beam = gesture->beams[0];
+	memset(beam, 0, sizeof(*beam));
+	beam->node = KEYBOARD_DICTIONARY_ROOT;
+	beam_cnt = 1;
+	/* one letter at a time, keeping the best prefixes only */
+	for(depth = 0; beam_cnt > 0 && depth < KEYBOARD_DICTIONARY_WORD - 1;
+			depth++)
+	{
+		next = gesture->beams[(depth + 1) % 2];
+		next_cnt = 0;
+		for(i = 0; i < beam_cnt; i++)
+		{
+			cnt = _keyboard_gesture_children(gesture, beam[i].node,
+					buf, 0, 0);
+			for(j = 0; j < cnt; j++)
+			{
+				if((key = _keyboard_gesture_key(gesture,
+							gesture->children[j].c))
+						== NULL
+						|| _decode_extend(gesture,
+							&beam[i], key, &n)
+						!= 0)
+					continue;
+				n.node = gesture->children[j].node;
+				results_cnt = _decode_word(gesture, results,
+						results_cnt, &n);
+				next_cnt = _keyboard_gesture_beam(next,
+						next_cnt, &n);
+			}
+		}
+		beam = next;
+		beam_cnt = next_cnt;
+	}
+	for(i = 0, cnt = 0; i < results_cnt; i++)
+		if(keyboard_dictionary_get_word(gesture->dictionary,
+					results[i].node, words[cnt]) == 0)
+			cnt++;
+	return cnt;
+}
+
+static int _decode_extend(KeyboardGesture * gesture,
+		KeyboardGestureState const * s, KeyboardGestureKey const * key,
+		KeyboardGestureState * n)
+{
+	gdouble d;
+	gdouble e;
+	size_t i;
+
+	/* the first letter starts the gesture, the others follow */
+	for(i = s->sample, d = 0.0; i < gesture->samples_cnt; i++)
+		if((d = _keyboard_gesture_distance(&gesture->samples[i],
+						&key->centre))
+				<= KEYBOARD_GESTURE_RADIUS || s->letters == 0)
+			break;
+	if(i == gesture->samples_cnt || d > KEYBOARD_GESTURE_RADIUS)
+		return -1;
+	/* up to the closest point in this pass */
+	for(n->sample = i++; i < gesture->samples_cnt; i++)
+	{
+		if((e = _keyboard_gesture_distance(&gesture->samples[i],
+						&key->centre)) >= d)
+			break;
+		d = e;
+		n->sample = i;
+	}
+	n->letters = s->letters + 1;
+	n->last = &key->centre;
+	n->cost = s->cost + d * d * ((s->letters == 0)
+			? KEYBOARD_GESTURE_ENDS : 1.0);
+	n->length = s->length;
+	if(s->last != NULL)
+		n->length += _keyboard_gesture_distance(s->last, n->last);
+	/* the prefixes may not be longer than the gesture */
+	n->score = n->cost / n->letters + KEYBOARD_GESTURE_LENGTH
+		* MAX(n->length - gesture->length, 0.0)
+		/ MAX(gesture->length, 1.0);
+	return 0;
+}
+
+static size_t _decode_word(KeyboardGesture * gesture,
+		KeyboardGestureResult * results, size_t cnt,
+		KeyboardGestureState const * n)
+{
+	uint32_t frequency;
+	gdouble e;
+	gdouble score;
+
+	if((frequency = keyboard_dictionary_get_frequency(gesture->dictionary,
+					n->node)) == 0)
+		return cnt;
+	/* the words end with the gesture */
+	e = _keyboard_gesture_distance(
+			&gesture->samples[gesture->samples_cnt - 1], n->last);
+	if(e > KEYBOARD_GESTURE_RADIUS)
+		return cnt;
+	score = (n->cost + e * e * KEYBOARD_GESTURE_ENDS) / (n->letters + 1)
+		+ KEYBOARD_GESTURE_LENGTH * fabs(n->length - gesture->length)
+		/ MAX(gesture->length, 1.0)
+		- KEYBOARD_GESTURE_FREQUENCY * log(frequency);
+	return _keyboard_gesture_result(results, cnt, n->node, score);
+}
+
+
+/* private */
+/* functions */
+/* keyboard_gesture_beam */
+static size_t _keyboard_gesture_beam(KeyboardGestureState * beam, size_t cnt,
+		KeyboardGestureState * state)
+{
+	size_t i;
+
+	/* sorted from the best, the worst fall off */
+	if(cnt == KEYBOARD_GESTURE_BEAM && state->score >= beam[cnt - 1].score)
+		return cnt;
+	for(i = cnt; i > 0 && beam[i - 1].score > state->score; i--);
+	if(cnt == KEYBOARD_GESTURE_BEAM)
+		cnt--;
+	memmove(&beam[i + 1], &beam[i], sizeof(*beam) * (cnt - i));
+	beam[i] = *state;
+	return cnt + 1;
+}
+
+
+/* keyboard_gesture_children */
+static size_t _keyboard_gesture_children(KeyboardGesture * gesture,
+		uint32_t node, char * buf, size_t len, size_t cnt)
+{
+	uint32_t first;
+	size_t count;
+	size_t i;
+	gunichar c;
+
+	/* the letters may span several bytes */
+	first = keyboard_dictionary_get_children(gesture->dictionary, node,
+			&count);
+	for(i = 0; i < count && cnt < KEYBOARD_GESTURE_CHILDREN; i++)
+	{
+		buf[len] = keyboard_dictionary_get_byte(gesture->dictionary,
+				first + i);
+		c = g_utf8_get_char_validated(buf, len + 1);
+		if(c == (gunichar)-2 && len + 1 < 4)
+			cnt = _keyboard_gesture_children(gesture, first + i,
+					buf, len + 1, cnt);
+		else if(c != (gunichar)-1 && c != (gunichar)-2)
+		{
+			gesture->children[cnt].c = c;
+			gesture->children[cnt++].node = first + i;
+		}
+	}
+	return cnt;
+}
+
+
+/* keyboard_gesture_distance */
+static gdouble _keyboard_gesture_distance(KeyboardGesturePoint const * p1,
+		KeyboardGesturePoint const * p2)
+{
+	gdouble x = p1->x - p2->x;
+	gdouble y = p1->y - p2->y;
+
+	return sqrt(x * x + y * y);
+}
+
+
+/* keyboard_gesture_key */
+static KeyboardGestureKey const * _keyboard_gesture_key(
+		KeyboardGesture * gesture, gunichar c)
+{
+	size_t i;
+
+	for(i = 0; i < gesture->keys_cnt; i++)
+		if(gesture->keys[i].c == c)
+			return &gesture->keys[i];
+	return NULL;
+}
+
+
+/* keyboard_gesture_resample */
+static void _keyboard_gesture_resample(KeyboardGesture * gesture)
+{
+	KeyboardGesturePoint const * p = gesture->points;
+	KeyboardGesturePoint * q;
+	gdouble length = 0.0;
+	gdouble step;
+	gdouble from;
+	gdouble target;
+	gdouble d;
+	gdouble t;
+	size_t i;
+
+	/* equidistant samples along the path */
+	for(i = 1; i < gesture->points_cnt; i++)
+		length += _keyboard_gesture_distance(&p[i - 1], &p[i]);
+	gesture->samples[0] = p[0];
+	gesture->samples_cnt = 1;
+	if(length <= 0.0)
+		return;
+	step = length / (KEYBOARD_GESTURE_SAMPLES - 1);
+	target = step;
+	for(i = 1, from = 0.0; i < gesture->points_cnt; i++, from += d)
+		for(d = _keyboard_gesture_distance(&p[i - 1], &p[i]);
+				target <= from + d && gesture->samples_cnt
+				< KEYBOARD_GESTURE_SAMPLES - 1;
+				target += step)
+		{
+			t = (target - from) / d;
+			q = &gesture->samples[gesture->samples_cnt++];
+			q->x = p[i - 1].x + (p[i].x - p[i - 1].x) * t;
+			q->y = p[i - 1].y + (p[i].y - p[i - 1].y) * t;
+		}
+	gesture->samples[gesture->samples_cnt++] = p[gesture->points_cnt - 1];
+}
+
+
+/* keyboard_gesture_result */
+static size_t _keyboard_gesture_result(KeyboardGestureResult * results,
+		size_t cnt, uint32_t node, gdouble score)
+{
+	size_t i;
+
+	/* sorted from the best */
+	if(cnt == KEYBOARD_DICTIONARY_TOP && score >= results[cnt - 1].score)
+		return cnt;
+	for(i = cnt; i > 0 && results[i - 1].score > score; i--);
+	if(cnt == KEYBOARD_DICTIONARY_TOP)
+		cnt--;
+	memmove(&results[i + 1], &results[i], sizeof(*results) * (cnt - i));
+	results[i].node = node;
+	results[i].score = score;
+	return cnt + 1;
+}
@@ -0,0 +1,60 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+#ifndef KEYBOARD_GESTURE_H
+# define KEYBOARD_GESTURE_H
+
+# include <glib.h>
+# include "dictionary.h"
+
+
+/* KeyboardGesture */
+/* types */
+typedef struct _KeyboardGesture KeyboardGesture;
+
+
+/* functions */
+KeyboardGesture * keyboard_gesture_new(KeyboardDictionary * dictionary);
+void keyboard_gesture_delete(KeyboardGesture * gesture);
+
+/* accessors */
+gboolean keyboard_gesture_is_swipe(KeyboardGesture * gesture);
+
+/* useful */
+/* the coordinates are in pixels, the size is that of a letter */
+void keyboard_gesture_start(KeyboardGesture * gesture, gdouble size);
+int keyboard_gesture_add_key(KeyboardGesture * gesture, gunichar c,
+		gdouble x, gdouble y);
+void keyboard_gesture_add_point(KeyboardGesture * gesture, gdouble x,
+		gdouble y);
+
+size_t keyboard_gesture_decode(KeyboardGesture * gesture,
+		char words[KEYBOARD_DICTIONARY_TOP][KEYBOARD_DICTIONARY_WORD]);
+
+#endif /* !KEYBOARD_GESTURE_H */
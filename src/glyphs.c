@@ -0,0 +1,259 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <System.h>
+#include "glyphs.h"
+
+
+/* KeyboardGlyphs */
+/* private */
+/* constants */
+#define KEYBOARD_GLYPHS_BUCKETS	256
+/* the labels of every layout and modifier fit easily */
+#define KEYBOARD_GLYPHS_MAX	1024
+
+
+/* types */
+typedef struct _KeyboardGlyph KeyboardGlyph;
+
+struct _KeyboardGlyph
+{
+	KeyboardGlyph * next;
+	guint hash;
+
+	/* the key */
+	char * text;
+	PangoFontDescription * font;
+	int scale;
+	uint32_t color;
+
+	/* the text rasterized, unless empty */
+	cairo_surface_t * surface;
+	int x;				/* from the logical rectangle */
+	int y;
+	int width;			/* of the logical rectangle */
+	int height;
+};
+
+struct _KeyboardGlyphs
+{
+	KeyboardGlyph * buckets[KEYBOARD_GLYPHS_BUCKETS];
+	size_t count;
+};
+
+
+/* prototypes */
+static void _glyphs_flush(KeyboardGlyphs * glyphs);
+static guint _glyphs_hash(char const * text, PangoFontDescription * font,
+		int scale, uint32_t color);
+static KeyboardGlyph * _glyphs_lookup(KeyboardGlyphs * glyphs,
+		char const * text, PangoFontDescription * font, int scale,
+		uint32_t color);
+static KeyboardGlyph * _glyphs_render(KeyboardGlyphs * glyphs,
+		GtkWidget * widget, char const * text,
+		PangoFontDescription * font, int scale, uint32_t color);
+
+
+/* public */
+/* functions */
+/* keyboard_glyphs_new */
+KeyboardGlyphs * keyboard_glyphs_new(void)
+{
+	KeyboardGlyphs * glyphs;
+
+	if((glyphs = malloc(sizeof(*glyphs))) == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		return NULL;
+	}
+	memset(glyphs->buckets, 0, sizeof(glyphs->buckets));
+	glyphs->count = 0;
+	return glyphs;
+}
+
+
+/* keyboard_glyphs_delete */
+void keyboard_glyphs_delete(KeyboardGlyphs * glyphs)
+{
+	_glyphs_flush(glyphs);
+	free(glyphs);
+}
+
+
+/* useful */
+/* keyboard_glyphs_draw */
+void keyboard_glyphs_draw(KeyboardGlyphs * glyphs, GtkWidget * widget,
+		cairo_t * cr, char const * text, PangoFontDescription * font,
+		uint32_t color, GdkRectangle * area, double align)
+{
+	KeyboardGlyph * glyph;
+	int scale = 1;
+	int x;
+	int y;
+
+#if GTK_CHECK_VERSION(3, 10, 0)
+	scale = gtk_widget_get_scale_factor(widget);
+#endif
+	if(font == NULL)
+		font = pango_context_get_font_description(
+				gtk_widget_get_pango_context(widget));
+	if((glyph = _glyphs_lookup(glyphs, text, font, scale, color)) == NULL
+			&& (glyph = _glyphs_render(glyphs, widget, text, font,
+					scale, color)) == NULL)
+		return;
+	if(glyph->surface == NULL)
+		return;
+	x = area->x + (area->width - glyph->width) / 2;
+	y = area->y + (int)((area->height - glyph->height) * align);
+	cairo_save(cr);
+	cairo_translate(cr, x + glyph->x, y + glyph->y);
+	cairo_scale(cr, 1.0 / scale, 1.0 / scale);
+	cairo_set_source_surface(cr, glyph->surface, 0.0, 0.0);
+	cairo_paint(cr);
+	cairo_restore(cr);
+}
+
+
+/* private */
+/* functions */
+/* glyphs_flush */
+static void _glyphs_flush(KeyboardGlyphs * glyphs)
+{
+	KeyboardGlyph * glyph;
+	size_t i;
+
+	for(i = 0; i < KEYBOARD_GLYPHS_BUCKETS; i++)
+		while((glyph = glyphs->buckets[i]) != NULL)
+		{
+			glyphs->buckets[i] = glyph->next;
+			if(glyph->surface != NULL)
+				cairo_surface_destroy(glyph->surface);
+			pango_font_description_free(glyph->font);
+			free(glyph->text);
+			free(glyph);
+		}
+	glyphs->count = 0;
+}
+
+
+/* glyphs_hash */
+static guint _glyphs_hash(char const * text, PangoFontDescription * font,
+		int scale, uint32_t color)
+{
+	return g_str_hash(text) ^ pango_font_description_hash(font)
+		^ ((guint)scale << 24) ^ color;
+}
+
+
+/* glyphs_lookup */
+static KeyboardGlyph * _glyphs_lookup(KeyboardGlyphs * glyphs,
+		char const * text, PangoFontDescription * font, int scale,
+		uint32_t color)
+{
+	guint hash;
+	KeyboardGlyph * glyph;
+
+	hash = _glyphs_hash(text, font, scale, color);
+	for(glyph = glyphs->buckets[hash % KEYBOARD_GLYPHS_BUCKETS];
+			glyph != NULL; glyph = glyph->next)
+		if(glyph->hash == hash && glyph->scale == scale
+				&& glyph->color == color
+				&& strcmp(glyph->text, text) == 0
+				&& pango_font_description_equal(glyph->font,
+					font))
+			return glyph;
+	return NULL;
+}
+
+
+/* glyphs_render */
+static KeyboardGlyph * _glyphs_render(KeyboardGlyphs * glyphs,
+		GtkWidget * widget, char const * text,
+		PangoFontDescription * font, int scale, uint32_t color)
+{
+	KeyboardGlyph * glyph;
+	PangoLayout * layout;
+	PangoRectangle ink;
+	PangoRectangle logical;
+	int x2;
+	int y2;
+	cairo_t * cr;
+
+	if(glyphs->count >= KEYBOARD_GLYPHS_MAX)
+		_glyphs_flush(glyphs);
+	if((glyph = malloc(sizeof(*glyph))) == NULL)
+		return NULL;
+	glyph->hash = _glyphs_hash(text, font, scale, color);
+	glyph->text = strdup(text);
+	glyph->font = pango_font_description_copy(font);
+	glyph->scale = scale;
+	glyph->color = color;
+	glyph->surface = NULL;
+	if(glyph->text == NULL)
+	{
+		pango_font_description_free(glyph->font);
+		free(glyph);
+		return NULL;
+	}
+	/* shaped once, with the fonts and options of the widget */
+	layout = pango_layout_new(gtk_widget_get_pango_context(widget));
+	pango_layout_set_font_description(layout, font);
+	pango_layout_set_text(layout, text, -1);
+	pango_layout_get_pixel_extents(layout, &ink, &logical);
+	glyph->width = logical.width;
+	glyph->height = logical.height;
+	/* the ink may go past the logical rectangle */
+	glyph->x = MIN(ink.x, logical.x);
+	glyph->y = MIN(ink.y, logical.y);
+	x2 = MAX(ink.x + ink.width, logical.x + logical.width);
+	y2 = MAX(ink.y + ink.height, logical.y + logical.height);
+	if(ink.width > 0 && ink.height > 0)
+	{
+		glyph->surface = cairo_image_surface_create(
+				CAIRO_FORMAT_ARGB32, (x2 - glyph->x) * scale,
+				(y2 - glyph->y) * scale);
+		cr = cairo_create(glyph->surface);
+		cairo_scale(cr, scale, scale);
+		cairo_translate(cr, -glyph->x, -glyph->y);
+		cairo_set_source_rgb(cr, ((color >> 16) & 0xff) / 255.0,
+				((color >> 8) & 0xff) / 255.0,
+				(color & 0xff) / 255.0);
+		pango_cairo_show_layout(cr, layout);
+		cairo_destroy(cr);
+	}
+	g_object_unref(layout);
+	glyph->next = glyphs->buckets[glyph->hash % KEYBOARD_GLYPHS_BUCKETS];
+	glyphs->buckets[glyph->hash % KEYBOARD_GLYPHS_BUCKETS] = glyph;
+	glyphs->count++;
+	return glyph;
+}
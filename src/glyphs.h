@@ -0,0 +1,53 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+#ifndef KEYBOARD_GLYPHS_H
+# define KEYBOARD_GLYPHS_H
+
+# include <stdint.h>
+# include <gtk/gtk.h>
+
+
+/* KeyboardGlyphs */
+/* types */
+typedef struct _KeyboardGlyphs KeyboardGlyphs;
+
+
+/* functions */
+KeyboardGlyphs * keyboard_glyphs_new(void);
+void keyboard_glyphs_delete(KeyboardGlyphs * glyphs);
+
+/* useful */
+/* draws the text centered horizontally, and along align vertically, within
+ * the area given; the color is in the 0xRRGGBB format */
+void keyboard_glyphs_draw(KeyboardGlyphs * glyphs, GtkWidget * widget,
+		cairo_t * cr, char const * text, PangoFontDescription * font,
+		uint32_t color, GdkRectangle * area, double align);
+
+#endif /* !KEYBOARD_GLYPHS_H */
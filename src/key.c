@@ -50,52 +50,59 @@ struct _KeyboardKey
 {
 	GtkWidget * widget;
 	GtkWidget * label;
-	GtkWidget * popup;
-	GtkWidget * button;
 	KeyboardKeyModifier key;
 	KeyboardKeyModifier * modifiers;
 	size_t modifiers_cnt;
+	/* the variant for every combination of modifiers */
+	KeyboardKeyModifier * levels[KM_COUNT];
+	unsigned int modifier;
 	KeyboardKeyModifier * current;
+	gboolean active;
+	/* when last released, for the latency statistics */
+	gint64 pressed;
 };
 
 
 /* prototypes */
-static void _keyboard_key_create_popup(KeyboardKey * key);
-
-/* callbacks */
-static gboolean _on_keyboard_key_button_press(GtkWidget * widget,
-		GdkEventButton * event, gpointer data);
-static gboolean _on_keyboard_key_button_release(GtkWidget * widget,
-		GdkEventButton * event, gpointer data);
+static void _keyboard_key_levels(KeyboardKey * key);
 
 
 /* public */
 /* functions */
 /* keyboard_key_new */
-KeyboardKey * keyboard_key_new(unsigned int keysym, char const * label)
+KeyboardKey * keyboard_key_new(unsigned int keysym, char const * label,
+		gboolean widget)
 {
 	KeyboardKey * key;
 
 	if((key = malloc(sizeof(*key))) == NULL)
 		return NULL;
-	if(keysym_is_modifier(keysym))
-		key->widget = gtk_toggle_button_new();
-	else
-		key->widget = gtk_button_new();
-	g_signal_connect(G_OBJECT(key->widget), "button-press-event",
-			G_CALLBACK(_on_keyboard_key_button_press), key);
-	g_signal_connect(G_OBJECT(key->widget), "button-release-event",
-			G_CALLBACK(_on_keyboard_key_button_release), key);
-	key->label = gtk_label_new(label);
-	gtk_container_add(GTK_CONTAINER(key->widget), key->label);
-	key->popup = NULL;
-	key->button = NULL;
+	key->widget = NULL;
+	key->label = NULL;
+	if(widget)
+	{
+		if(keysym_is_modifier(keysym))
+			key->widget = gtk_toggle_button_new();
+		else
+			key->widget = gtk_button_new();
+		key->label = gtk_label_new(label);
+		gtk_container_add(GTK_CONTAINER(key->widget), key->label);
+#if GTK_CHECK_VERSION(3, 0, 0)
+		gtk_style_context_add_class(gtk_widget_get_style_context(
+					key->widget), keysym_is_modifier(keysym)
+				? KEYBOARD_KEY_CLASS_MODIFIER
+				: KEYBOARD_KEY_CLASS);
+#endif
+	}
 	key->key.modifier = 0;
 	key->key.keysym = keysym;
 	key->key.label = strdup(label);
 	key->modifiers = NULL;
 	key->modifiers_cnt = 0;
-	key->current = &key->key;
+	key->modifier = KM_NONE;
+	_keyboard_key_levels(key);
+	key->active = FALSE;
+	key->pressed = 0;
 	if(key->key.label == NULL)
 	{
 		keyboard_key_delete(key);
@@ -119,6 +126,16 @@ void keyboard_key_delete(KeyboardKey * key)
 
 
 /* accessors */
+/* keyboard_key_get_active */
+gboolean keyboard_key_get_active(KeyboardKey * key)
+{
+	if(key->widget != NULL && keysym_is_modifier(key->key.keysym))
+		return gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(
+					key->widget));
+	return key->active;
+}
+
+
 /* keyboard_key_get_keysym */
 unsigned int keyboard_key_get_keysym(KeyboardKey * key)
 {
@@ -126,6 +143,13 @@ unsigned int keyboard_key_get_keysym(KeyboardKey * key)
 }
 
 
+/* keyboard_key_get_label */
+char const * keyboard_key_get_label(KeyboardKey * key)
+{
+	return key->current->label;
+}
+
+
 /* keyboard_key_get_label_widget */
 GtkWidget * keyboard_key_get_label_widget(KeyboardKey * key)
 {
@@ -133,6 +157,13 @@ GtkWidget * keyboard_key_get_label_widget(KeyboardKey * key)
 }
 
 
+/* keyboard_key_get_pressed */
+gint64 keyboard_key_get_pressed(KeyboardKey * key)
+{
+	return key->pressed;
+}
+
+
 /* keyboard_key_get_widget */
 GtkWidget * keyboard_key_get_widget(KeyboardKey * key)
 {
@@ -140,52 +171,48 @@ GtkWidget * keyboard_key_get_widget(KeyboardKey * key)
 }
 
 
-/* keyboard_key_set_background */
-# if GTK_CHECK_VERSION(3, 0, 0)
-void keyboard_key_set_background(KeyboardKey * key, GdkRGBA * color)
+/* keyboard_key_has_modifier */
+gboolean keyboard_key_has_modifier(KeyboardKey * key, unsigned int modifier)
+{
+	return (key->levels[modifier % KM_COUNT] != &key->key) ? TRUE : FALSE;
+}
+
+
+/* keyboard_key_set_active */
+void keyboard_key_set_active(KeyboardKey * key, gboolean active)
 {
-	_keyboard_key_create_popup(key);
-	gtk_widget_override_background_color(key->widget, GTK_STATE_FLAG_NORMAL,
-			color);
-	gtk_widget_override_background_color(key->popup, GTK_STATE_FLAG_NORMAL,
-			color);
-	gtk_widget_override_background_color(key->button, GTK_STATE_FLAG_NORMAL,
-			color);
+	key->active = active;
+	if(key->widget != NULL && keysym_is_modifier(key->key.keysym))
+		gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(key->widget),
+				active);
 }
-# else
+
+
+#if !GTK_CHECK_VERSION(3, 0, 0)
+/* keyboard_key_set_background */
 void keyboard_key_set_background(KeyboardKey * key, GdkColor * color)
 {
-	_keyboard_key_create_popup(key);
+	if(key->widget == NULL)
+		return;
 	gtk_widget_modify_bg(key->widget, GTK_STATE_NORMAL, color);
-	gtk_widget_modify_bg(key->popup, GTK_STATE_NORMAL, color);
-	gtk_widget_modify_bg(key->button, GTK_STATE_NORMAL, color);
 }
-#endif
 
 
 /* keyboard_key_set_font */
 void keyboard_key_set_font(KeyboardKey * key, PangoFontDescription * font)
 {
-	_keyboard_key_create_popup(key);
+	if(key->widget == NULL)
+		return;
 	gtk_widget_override_font(key->label, font);
-	gtk_widget_override_font(gtk_bin_get_child(GTK_BIN(key->button)), font);
 }
 
 
 /* keyboard_key_set_foreground */
-#if GTK_CHECK_VERSION(3, 0, 0)
-void keyboard_key_set_foreground(KeyboardKey * key, GdkRGBA * color)
-{
-	_keyboard_key_create_popup(key);
-	gtk_widget_override_color(key->label, GTK_STATE_FLAG_NORMAL, color);
-	gtk_widget_override_color(key->button, GTK_STATE_FLAG_NORMAL, color);
-}
-#else
 void keyboard_key_set_foreground(KeyboardKey * key, GdkColor * color)
 {
-	_keyboard_key_create_popup(key);
+	if(key->widget == NULL)
+		return;
 	gtk_widget_modify_fg(key->label, GTK_STATE_NORMAL, color);
-	gtk_widget_modify_fg(key->button, GTK_STATE_NORMAL, color);
 }
 #endif
 
@@ -199,7 +226,7 @@ int keyboard_key_set_modifier(KeyboardKey * key, unsigned int modifier,
 
 	if(label == NULL || (p = strdup(label)) == NULL)
 		return -1;
-	if(modifier == 0)
+	if(modifier == KM_NONE)
 	{
 		key->key.keysym = keysym;
 		free(key->key.label);
@@ -214,129 +241,73 @@ int keyboard_key_set_modifier(KeyboardKey * key, unsigned int modifier,
 	}
 	key->modifiers = q;
 	q = &key->modifiers[key->modifiers_cnt++];
-	q->modifier = modifier;
+	q->modifier = modifier % KM_COUNT;
 	q->keysym = keysym;
 	q->label = p;
+	_keyboard_key_levels(key);
 	return 0;
 }
 
 
+/* keyboard_key_set_pressed */
+void keyboard_key_set_pressed(KeyboardKey * key, gint64 time)
+{
+	key->pressed = time;
+}
+
+
 /* useful */
 /* keyboard_key_apply_modifier */
-void keyboard_key_apply_modifier(KeyboardKey * key, unsigned int modifier)
+gboolean keyboard_key_apply_modifier(KeyboardKey * key, unsigned int modifier)
 {
-	char const * label = key->key.label;
-	size_t i;
+	KeyboardKeyModifier * current;
 
-	key->current = &key->key;
-	if(modifier != 0)
-		for(i = 0; i < key->modifiers_cnt; i++)
-			if(key->modifiers[i].modifier == modifier)
-			{
-				label = key->modifiers[i].label;
-				key->current = &key->modifiers[i];
-				break;
-			}
-	gtk_label_set_text(GTK_LABEL(key->label), label);
+	key->modifier = modifier % KM_COUNT;
+	current = key->levels[key->modifier];
+	/* avoid relabelling (and resizing) the key when possible */
+	if(current == key->current)
+		return FALSE;
+	key->current = current;
+	if(key->label != NULL)
+		gtk_label_set_text(GTK_LABEL(key->label), current->label);
+	return TRUE;
 }
 
 
 /* private */
 /* functions */
-/* keyboard_key_create_popup */
-#if !GTK_CHECK_VERSION(3, 0, 0)
-/* callbacks */
-static void _create_popup_on_realize(gpointer data);
-#endif
+/* keyboard_key_levels */
+static unsigned int _levels_count(unsigned int modifier);
 
-static void _keyboard_key_create_popup(KeyboardKey * key)
+static void _keyboard_key_levels(KeyboardKey * key)
 {
-	if(key->popup != NULL)
-		return;
-	key->popup = gtk_window_new(GTK_WINDOW_POPUP);
-#if !GTK_CHECK_VERSION(3, 0, 0)
-	g_signal_connect(key->popup, "realize", G_CALLBACK(
-				_create_popup_on_realize), NULL);
-#endif
-	key->button = gtk_button_new_with_label(gtk_label_get_text(GTK_LABEL(
-					key->label)));
-	gtk_button_set_alignment(GTK_BUTTON(key->button), 0.5, 0.1);
-	gtk_container_add(GTK_CONTAINER(key->popup), key->button);
-}
-
-#if !GTK_CHECK_VERSION(3, 0, 0)
-/* callbacks */
-static void _create_popup_on_realize(gpointer data)
-{
-	GtkWidget * window = data;
-	int width;
-	int height;
-	GdkBitmap * mask;
-	GdkGC * gc;
-	GdkColor black = { 0, 0, 0, 0 };
-	GdkColor white = { 0xffffffff, 0xffff, 0xffff, 0xffff };
-
-	/* XXX potential invalid assumption as to how the button is drawn */
-	gtk_window_get_size(GTK_WINDOW(window), &width, &height);
-	mask = gdk_pixmap_new(NULL, width, height, 1);
-	gc = gdk_gc_new(mask);
-	gdk_gc_set_foreground(gc, &white);
-	gdk_draw_rectangle(mask, gc, TRUE, 0, 0, width, height);
-	gdk_gc_set_foreground(gc, &black);
-	/* left column */
-	gdk_draw_rectangle(mask, gc, TRUE, 0, 0, 1, height);
-	/* top row */
-	gdk_draw_rectangle(mask, gc, TRUE, 0, 0, width, 1);
-	/* right column */
-	gdk_draw_rectangle(mask, gc, TRUE, width - 1, 0, 1, height);
-	/* bottom row */
-	gdk_draw_rectangle(mask, gc, TRUE, 0, height - 1, width, 1);
-	/* top left corner */
-	gdk_draw_rectangle(mask, gc, TRUE, 0, 0, 2, 2);
-	/* top right corner */
-	gdk_draw_rectangle(mask, gc, TRUE, width - 2, 0, 2, 2);
-	/* bottom left corner */
-	gdk_draw_rectangle(mask, gc, TRUE, 0, height - 2, 2, 2);
-	/* bottom right corner */
-	gdk_draw_rectangle(mask, gc, TRUE, width - 2, height - 2, 2, 2);
-	gtk_widget_shape_combine_mask(window, mask, 0, 0);
-	g_object_unref(gc);
-	g_object_unref(mask);
-}
-#endif
+	unsigned int i;
+	size_t j;
+	KeyboardKeyModifier * p;
 
-
-/* callbacks */
-/* on_keyboard_key_button_press */
-static gboolean _on_keyboard_key_button_press(GtkWidget * widget,
-		GdkEventButton * event, gpointer data)
-{
-	KeyboardKey * key = data;
-	gint width;
-	gint height;
-
-#if GTK_CHECK_VERSION(2, 24, 0)
-	width = gdk_window_get_width(event->window);
-	height = gdk_window_get_height(event->window);
-#else
-	gdk_window_get_size(event->window, &width, &height);
-#endif
-	_keyboard_key_create_popup(key);
-	gtk_widget_set_size_request(key->popup, width + 8, height * 2);
-	gtk_window_move(GTK_WINDOW(key->popup), event->x_root - event->x - 4,
-			event->y_root - event->y - height * 2);
-	gtk_widget_show_all(key->popup);
-	return FALSE;
+	for(i = 0; i < KM_COUNT; i++)
+	{
+		/* fallback to the largest combination defined within */
+		key->levels[i] = &key->key;
+		for(j = 0; j < key->modifiers_cnt; j++)
+		{
+			p = &key->modifiers[j];
+			if((p->modifier & ~i) != 0)
+				continue;
+			if(_levels_count(p->modifier) > _levels_count(
+						key->levels[i]->modifier))
+				key->levels[i] = p;
+		}
+	}
+	key->current = key->levels[key->modifier];
 }
 
-
-/* on_keyboard_key_button_release */
-static gboolean _on_keyboard_key_button_release(GtkWidget * widget,
-		GdkEventButton * event, gpointer data)
+static unsigned int _levels_count(unsigned int modifier)
 {
-	KeyboardKey * key = data;
+	unsigned int ret;
 
-	if(key->popup != NULL)
-		gtk_widget_hide(key->popup);
-	return FALSE;
+	for(ret = 0; modifier != 0; modifier >>= 1)
+		ret += modifier & 0x1;
+	return ret;
 }
+
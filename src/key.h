@@ -35,35 +35,44 @@
 
 
 /* Keyboard */
+/* constants */
+/* the style classes of the keys */
+# define KEYBOARD_KEY_CLASS		"keyboard-key"
+# define KEYBOARD_KEY_CLASS_MODIFIER	"keyboard-modifier"
+
+
 /* types */
 typedef struct _KeyboardKey KeyboardKey;
 
 
 /* functions */
-KeyboardKey * keyboard_key_new(unsigned int keysym, char const * label);
+KeyboardKey * keyboard_key_new(unsigned int keysym, char const * label,
+		gboolean widget);
 void keyboard_key_delete(KeyboardKey * key);
 
 /* accessors */
+gboolean keyboard_key_get_active(KeyboardKey * key);
 unsigned int keyboard_key_get_keysym(KeyboardKey * key);
+char const * keyboard_key_get_label(KeyboardKey * key);
 GtkWidget * keyboard_key_get_label_widget(KeyboardKey * key);
+gint64 keyboard_key_get_pressed(KeyboardKey * key);
 GtkWidget * keyboard_key_get_widget(KeyboardKey * key);
 unsigned int keyboard_key_get_width(KeyboardKey * key);
 
-# if GTK_CHECK_VERSION(3, 0, 0)
-void keyboard_key_set_background(KeyboardKey * key, GdkRGBA * color);
-# else
+gboolean keyboard_key_has_modifier(KeyboardKey * key, unsigned int modifier);
+
+void keyboard_key_set_active(KeyboardKey * key, gboolean active);
+/* with Gtk+ 3, the keys are styled through their style classes instead */
+# if !GTK_CHECK_VERSION(3, 0, 0)
 void keyboard_key_set_background(KeyboardKey * key, GdkColor * color);
-# endif
 void keyboard_key_set_font(KeyboardKey * key, PangoFontDescription * font);
-# if GTK_CHECK_VERSION(3, 0, 0)
-void keyboard_key_set_foreground(KeyboardKey * key, GdkRGBA * color);
-# else
 void keyboard_key_set_foreground(KeyboardKey * key, GdkColor * color);
 # endif
 int keyboard_key_set_modifier(KeyboardKey * key, unsigned int modifier,
 		unsigned int keysym, char const * label);
+void keyboard_key_set_pressed(KeyboardKey * key, gint64 time);
 
 /* useful */
-void keyboard_key_apply_modifier(KeyboardKey * key, unsigned int modifier);
+gboolean keyboard_key_apply_modifier(KeyboardKey * key, unsigned int modifier);
 
 #endif /* !KEYBOARD_KEY_H */
@@ -28,8 +28,7 @@ static char const _license[] =
 "NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS\n"
 "SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */\n";
 /* TODO:
- * - display "likely" keys (after modifiers) as well
- * - see if XKB could be used to define the keyboard */
+ * - display "likely" keys (after modifiers) as well */
 
 
 
@@ -37,21 +36,27 @@ static char const _license[] =
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <strings.h>
 #include <libintl.h>
 #include <gtk/gtk.h>
 #include <gdk/gdkkeysyms.h>
+#include <gdk/gdkx.h>
 #if GTK_CHECK_VERSION(3, 0, 0)
 # include <gtk/gtkx.h>
 #endif
 #include <System.h>
 #include <Desktop.h>
-#define XK_LATIN1
-#define XK_MISCELLANY
 #include <X11/Xlib.h>
-#include <X11/keysymdef.h>
+#include "backend.h"
+#include "common.h"
 #include "callbacks.h"
+#include "control.h"
+#include "definition.h"
+#include "dictionary.h"
+#include "gesture.h"
+#include "glyphs.h"
+#include "keymap.h"
 #include "layout.h"
+#include "profile.h"
 #include "keyboard.h"
 #include "../config.h"
 #define _(string) gettext(string)
@@ -61,24 +66,85 @@ static char const _license[] =
 # define PROGNAME_KEYBOARD	"keyboard"
 #endif
 
+/* the style classes, besides those of the keys */
+#define KEYBOARD_CLASS		"keyboard"
+#define KEYBOARD_CLASS_SELECTOR	"keyboard-selector"
+
 
 /* Keyboard */
 /* private */
 /* types */
+typedef struct _KeyboardLayoutDefinition
+{
+	char const * label;
+	KeyboardKeyDefinition const * keys;
+} KeyboardLayoutDefinition;
+
+
 struct _Keyboard
 {
 	/* preferences */
 	KeyboardMode mode;
+	gboolean surface;
+	gboolean verbose;
+
+	KeyboardBackend * backend;
+	KeyboardKeymap * keymap;
+	KeyboardStats * stats;
+	gint64 shown;			/* until the first frame */
+	KeyboardControl * control;
+	KeyboardGlyphs * glyphs;	/* the labels drawn */
+
+	/* layouts are built upon first use */
+	KeyboardDefinition * definition;
+	KeyboardLayoutDefinition definitions[KLS_COUNT];
+	KeyboardLayout * layouts[KLS_COUNT];
+	KeyboardLayoutSection layout;
+	guint source;
+	unsigned int source_page;	/* the next one built when idle */
+
+	/* the hidden layouts are updated when shown */
+	unsigned int modifier;
+
+	/* a single timer repeats the key held */
+	int repeat_delay;
+	int repeat_rate;
+	guint repeat;
+	KeyboardKey * repeat_key;
+	gboolean repeated;
+
+	/* word completion, for the word being typed */
+	KeyboardDictionary * dictionary;
+	uint32_t cursor;
+	char word[KEYBOARD_DICTIONARY_WORD];
+	size_t word_len;
+	char suggestions[KEYBOARD_DICTIONARY_TOP][KEYBOARD_DICTIONARY_WORD];
 
-	KeyboardLayout ** layouts;
-	size_t layouts_cnt;
+	/* whole words typed with gestures, replaced if picked again */
+	KeyboardGesture * gesture;
+	size_t swiped;
+
+	/* text received from the clients, until complete */
+	char * text;
+	size_t text_cnt;
 
 	PangoFontDescription * font;
+#if GTK_CHECK_VERSION(3, 0, 0)
+	GtkCssProvider * css;		/* for every widget */
+#endif
 	GtkWidget * window;
+	GtkWidget * vbox;
 #if GTK_CHECK_VERSION(2, 10, 0)
 	GtkStatusIcon * icon;
 #endif
 	GtkWidget * ab_window;
+	GtkWidget * pr_window;
+	GtkWidget * pr_area;
+	char * pr_text;
+	int pr_width;
+	int pr_height;
+	GtkWidget * su_box;
+	GtkWidget * su_buttons[KEYBOARD_DICTIONARY_TOP];
 	GdkRectangle geometry;
 	int width;
 	int height;
@@ -86,45 +152,6 @@ struct _Keyboard
 	int y;
 };
 
-typedef struct _KeyboardKeyDefinition
-{
-	unsigned int row;
-	unsigned int width;
-	unsigned int modifier;
-	unsigned int keysym;
-	char const * label;
-} KeyboardKeyDefinition;
-
-typedef enum _KeyboardLayoutSection
-{
-	KLS_LETTERS = 0,
-	KLS_KEYPAD,
-	KLS_SPECIAL
-} KeyboardLayoutSection;
-#define KLS_LAST KLS_SPECIAL
-#define KLS_COUNT (KLS_LAST + 1)
-
-typedef struct _KeyboardLayoutDefinition
-{
-	char const * label;
-	KeyboardKeyDefinition const * keys;
-} KeyboardLayoutDefinition;
-
-typedef enum _KeyboardLayoutType
-{
-	KLT_QWERTY = 0,
-	KLT_QWERTZ,
-	KLT_AZERTY
-} KeyboardLayoutType;
-#define KLT_LAST KLT_AZERTY
-#define KLT_COUNT (KLT_LAST + 1)
-
-typedef struct _KeyboardLayoutTypeName
-{
-	KeyboardLayoutType type;
-	char const * name;
-} KeyboardLayoutTypeName;
-
 
 /* constants */
 static char const * _authors[] =
@@ -133,13 +160,6 @@ static char const * _authors[] =
 	NULL
 };
 
-static const KeyboardLayoutTypeName _keyboard_layout_type_name[] =
-{
-	{ KLT_QWERTY,	"us"	},
-	{ KLT_QWERTZ,	"de"	},
-	{ KLT_AZERTY,	"fr"	}
-};
-
 static const DesktopMenu _keyboard_menu_file[] =
 {
 	{ N_("_Quit"), G_CALLBACK(on_file_quit), GTK_STOCK_QUIT,
@@ -173,511 +193,30 @@ static const DesktopMenubar _keyboard_menubar[] =
 };
 
 
-/* variables */
-static KeyboardKeyDefinition const _keyboard_layout_letters_qwerty[] =
-{
-	{ 0, 2, 0, XK_q, "q" },
-	{ 0, 0, XK_Shift_L, XK_Q, "Q" },
-	{ 0, 2, 0, XK_w, "w" },
-	{ 0, 0, XK_Shift_L, XK_W, "W" },
-	{ 0, 2, 0, XK_e, "e" },
-	{ 0, 0, XK_Shift_L, XK_E, "E" },
-	{ 0, 2, 0, XK_r, "r" },
-	{ 0, 0, XK_Shift_L, XK_R, "R" },
-	{ 0, 2, 0, XK_t, "t" },
-	{ 0, 0, XK_Shift_L, XK_T, "T" },
-	{ 0, 2, 0, XK_y, "y" },
-	{ 0, 0, XK_Shift_L, XK_Y, "Y" },
-	{ 0, 2, 0, XK_u, "u" },
-	{ 0, 0, XK_Shift_L, XK_U, "U" },
-	{ 0, 2, 0, XK_i, "i" },
-	{ 0, 0, XK_Shift_L, XK_I, "I" },
-	{ 0, 2, 0, XK_o, "o" },
-	{ 0, 0, XK_Shift_L, XK_O, "O" },
-	{ 0, 2, 0, XK_p, "p" },
-	{ 0, 0, XK_Shift_L, XK_P, "P" },
-	{ 1, 1, 0, 0, NULL },
-	{ 1, 2, 0, XK_a, "a" },
-	{ 1, 0, XK_Shift_L, XK_A, "A" },
-	{ 1, 2, 0, XK_s, "s" },
-	{ 1, 0, XK_Shift_L, XK_S, "S" },
-	{ 1, 2, 0, XK_d, "d" },
-	{ 1, 0, XK_Shift_L, XK_D, "D" },
-	{ 1, 2, 0, XK_f, "f" },
-	{ 1, 0, XK_Shift_L, XK_F, "F" },
-	{ 1, 2, 0, XK_g, "g" },
-	{ 1, 0, XK_Shift_L, XK_G, "G" },
-	{ 1, 2, 0, XK_h, "h" },
-	{ 1, 0, XK_Shift_L, XK_H, "H" },
-	{ 1, 2, 0, XK_j, "j" },
-	{ 1, 0, XK_Shift_L, XK_J, "J" },
-	{ 1, 2, 0, XK_k, "k" },
-	{ 1, 0, XK_Shift_L, XK_K, "K" },
-	{ 1, 2, 0, XK_l, "l" },
-	{ 1, 0, XK_Shift_L, XK_L, "L" },
-	{ 2, 2, 0, XK_Shift_L, "\xe2\x87\xa7" },
-	{ 2, 2, 0, XK_z, "z" },
-	{ 2, 0, XK_Shift_L, XK_Z, "Z" },
-	{ 2, 2, 0, XK_x, "x" },
-	{ 2, 0, XK_Shift_L, XK_X, "X" },
-	{ 2, 2, 0, XK_c, "c" },
-	{ 2, 0, XK_Shift_L, XK_C, "C" },
-	{ 2, 2, 0, XK_v, "v" },
-	{ 2, 0, XK_Shift_L, XK_V, "V" },
-	{ 2, 2, 0, XK_b, "b" },
-	{ 2, 0, XK_Shift_L, XK_B, "B" },
-	{ 2, 2, 0, XK_n, "n" },
-	{ 2, 0, XK_Shift_L, XK_N, "N" },
-	{ 2, 2, 0, XK_m, "m" },
-	{ 2, 0, XK_Shift_L, XK_M, "M" },
-	{ 2, 2, 0, XK_comma, "," },
-	{ 2, 0, XK_Shift_L, XK_comma, "<" },
-	{ 2, 2, 0, XK_period, "." },
-	{ 2, 0, XK_Shift_L, XK_period, ">" },
-	{ 3, 3, 0, 0, NULL },
-	{ 3, 3, 0, XK_Control_L, "Ctrl" },
-	{ 3, 3, 0, XK_Alt_L, "Alt" },
-	{ 3, 5, 0, XK_space, " " },
-	{ 3, 0, XK_Shift_L, XK_space, " " },
-	{ 3, 3, 0, XK_Return, "\xe2\x86\xb2" },
-	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
-	{ 0, 0, 0, 0, NULL }
-};
+/* prototypes */
+static KeyboardLayout * _keyboard_add_layout(Keyboard * keyboard,
+		KeyboardLayoutSection section);
 
-static KeyboardKeyDefinition const _keyboard_layout_letters_qwertz[] =
-{
-	{ 0, 2, 0, XK_q, "q" },
-	{ 0, 0, XK_Shift_L, XK_Q, "Q" },
-	{ 0, 2, 0, XK_w, "w" },
-	{ 0, 0, XK_Shift_L, XK_W, "W" },
-	{ 0, 2, 0, XK_e, "e" },
-	{ 0, 0, XK_Shift_L, XK_E, "E" },
-	{ 0, 2, 0, XK_r, "r" },
-	{ 0, 0, XK_Shift_L, XK_R, "R" },
-	{ 0, 2, 0, XK_t, "t" },
-	{ 0, 0, XK_Shift_L, XK_T, "T" },
-	{ 0, 2, 0, XK_z, "z" },
-	{ 0, 0, XK_Shift_L, XK_Z, "Z" },
-	{ 0, 2, 0, XK_u, "u" },
-	{ 0, 0, XK_Shift_L, XK_U, "U" },
-	{ 0, 2, 0, XK_i, "i" },
-	{ 0, 0, XK_Shift_L, XK_I, "I" },
-	{ 0, 2, 0, XK_o, "o" },
-	{ 0, 0, XK_Shift_L, XK_O, "O" },
-	{ 0, 2, 0, XK_p, "p" },
-	{ 0, 0, XK_Shift_L, XK_P, "P" },
-	{ 1, 1, 0, 0, NULL },
-	{ 1, 2, 0, XK_a, "a" },
-	{ 1, 0, XK_Shift_L, XK_A, "A" },
-	{ 1, 2, 0, XK_s, "s" },
-	{ 1, 0, XK_Shift_L, XK_S, "S" },
-	{ 1, 2, 0, XK_d, "d" },
-	{ 1, 0, XK_Shift_L, XK_D, "D" },
-	{ 1, 2, 0, XK_f, "f" },
-	{ 1, 0, XK_Shift_L, XK_F, "F" },
-	{ 1, 2, 0, XK_g, "g" },
-	{ 1, 0, XK_Shift_L, XK_G, "G" },
-	{ 1, 2, 0, XK_h, "h" },
-	{ 1, 0, XK_Shift_L, XK_H, "H" },
-	{ 1, 2, 0, XK_j, "j" },
-	{ 1, 0, XK_Shift_L, XK_J, "J" },
-	{ 1, 2, 0, XK_k, "k" },
-	{ 1, 0, XK_Shift_L, XK_K, "K" },
-	{ 1, 2, 0, XK_l, "l" },
-	{ 1, 0, XK_Shift_L, XK_L, "L" },
-	{ 2, 2, 0, XK_Shift_L, "\xe2\x87\xa7" },
-	{ 2, 2, 0, XK_y, "y" },
-	{ 2, 0, XK_Shift_L, XK_Y, "Y" },
-	{ 2, 2, 0, XK_x, "x" },
-	{ 2, 0, XK_Shift_L, XK_X, "X" },
-	{ 2, 2, 0, XK_c, "c" },
-	{ 2, 0, XK_Shift_L, XK_C, "C" },
-	{ 2, 2, 0, XK_v, "v" },
-	{ 2, 0, XK_Shift_L, XK_V, "V" },
-	{ 2, 2, 0, XK_b, "b" },
-	{ 2, 0, XK_Shift_L, XK_B, "B" },
-	{ 2, 2, 0, XK_n, "n" },
-	{ 2, 0, XK_Shift_L, XK_N, "N" },
-	{ 2, 2, 0, XK_m, "m" },
-	{ 2, 0, XK_Shift_L, XK_M, "M" },
-	{ 2, 2, 0, XK_comma, "," },
-	{ 2, 0, XK_Shift_L, XK_comma, "<" },
-	{ 2, 2, 0, XK_period, "." },
-	{ 2, 0, XK_Shift_L, XK_period, ">" },
-	{ 3, 3, 0, 0, NULL },
-	{ 3, 3, 0, XK_Control_L, "Ctrl" },
-	{ 3, 3, 0, XK_Alt_L, "Alt" },
-	{ 3, 5, 0, XK_space, " " },
-	{ 3, 0, XK_Shift_L, XK_space, " " },
-	{ 3, 3, 0, XK_Return, "\xe2\x86\xb2" },
-	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
-	{ 0, 0, 0, 0, NULL }
-};
+static void _keyboard_error(Keyboard * keyboard, char const * format, ...);
+#if GTK_CHECK_VERSION(3, 0, 0)
+static void _keyboard_style(Keyboard * keyboard);
+#endif
+static void _keyboard_suggest_show(Keyboard * keyboard, size_t cnt);
+static void _keyboard_suggest_update(Keyboard * keyboard);
 
-static KeyboardKeyDefinition const _keyboard_layout_letters_azerty[] =
-{
-	{ 0, 2, 0, XK_a, "a" },
-	{ 0, 0, XK_Shift_L, XK_A, "A" },
-	{ 0, 2, 0, XK_z, "z" },
-	{ 0, 0, XK_Shift_L, XK_Z, "Z" },
-	{ 0, 2, 0, XK_e, "e" },
-	{ 0, 0, XK_Shift_L, XK_E, "E" },
-#if 0 /* def XK_CURRENCY */
-	{ 0, 0, XK_Alt_R, XK_EuroSign, "€" },
+/* callbacks */
+#if GTK_CHECK_VERSION(3, 0, 0)
+static gboolean _keyboard_on_draw(GtkWidget * widget, cairo_t * cr,
+		gpointer data);
+static void _keyboard_on_theme(GObject * settings, GParamSpec * pspec,
+		gpointer data);
 #else
-	{ 0, 0, XK_Alt_R, XK_E, "€" },
+static gboolean _keyboard_on_expose_event(GtkWidget * widget,
+		GdkEventExpose * event, gpointer data);
 #endif
-	{ 0, 2, 0, XK_r, "r" },
-	{ 0, 0, XK_Shift_L, XK_R, "R" },
-	{ 0, 2, 0, XK_t, "t" },
-	{ 0, 0, XK_Shift_L, XK_T, "T" },
-	{ 0, 2, 0, XK_y, "y" },
-	{ 0, 0, XK_Shift_L, XK_Y, "Y" },
-	{ 0, 2, 0, XK_u, "u" },
-	{ 0, 0, XK_Shift_L, XK_U, "U" },
-	{ 0, 2, 0, XK_i, "i" },
-	{ 0, 0, XK_Shift_L, XK_I, "I" },
-	{ 0, 2, 0, XK_o, "o" },
-	{ 0, 0, XK_Shift_L, XK_O, "O" },
-	{ 0, 2, 0, XK_p, "p" },
-	{ 0, 0, XK_Shift_L, XK_P, "P" },
-	{ 0, 2, 0, XK_asciicircum, "^" },
-	{ 0, 0, XK_Shift_L, XK_quotedbl, "\"" },
-	{ 0, 2, 0, XK_dollar, "$" },
-	{ 0, 0, XK_Shift_L, XK_sterling, "£" },
-	{ 1, 1, 0, 0, NULL },
-	{ 1, 2, 0, XK_q, "q" },
-	{ 1, 0, XK_Shift_L, XK_Q, "Q" },
-	{ 1, 2, 0, XK_s, "s" },
-	{ 1, 0, XK_Shift_L, XK_S, "S" },
-	{ 1, 2, 0, XK_d, "d" },
-	{ 1, 0, XK_Shift_L, XK_D, "D" },
-	{ 1, 2, 0, XK_f, "f" },
-	{ 1, 0, XK_Shift_L, XK_F, "F" },
-	{ 1, 2, 0, XK_g, "g" },
-	{ 1, 0, XK_Shift_L, XK_G, "G" },
-	{ 1, 2, 0, XK_h, "h" },
-	{ 1, 0, XK_Shift_L, XK_H, "H" },
-	{ 1, 2, 0, XK_j, "j" },
-	{ 1, 0, XK_Shift_L, XK_J, "J" },
-	{ 1, 2, 0, XK_k, "k" },
-	{ 1, 0, XK_Shift_L, XK_K, "K" },
-	{ 1, 2, 0, XK_l, "l" },
-	{ 1, 0, XK_Shift_L, XK_L, "L" },
-	{ 1, 2, 0, XK_m, "m" },
-	{ 1, 0, XK_Shift_L, XK_M, "M" },
-	{ 1, 2, 0, XK_ugrave, "ù" },
-	{ 1, 0, XK_Shift_L, XK_percent, "%" },
-	{ 1, 2, 0, XK_asterisk, "*" },
-	{ 1, 0, XK_Shift_L, XK_mu, "µ" },
-	{ 2, 2, 0, XK_Shift_L, "\xe2\x87\xa7" },
-	{ 2, 2, 0, XK_less, "<" },
-	{ 2, 0, XK_Shift_L, XK_less, ">" },
-	{ 2, 2, 0, XK_w, "w" },
-	{ 2, 0, XK_Shift_L, XK_W, "W" },
-	{ 2, 2, 0, XK_x, "x" },
-	{ 2, 0, XK_Shift_L, XK_X, "X" },
-	{ 2, 2, 0, XK_c, "c" },
-	{ 2, 0, XK_Shift_L, XK_C, "C" },
-	{ 2, 2, 0, XK_v, "v" },
-	{ 2, 0, XK_Shift_L, XK_V, "V" },
-	{ 2, 2, 0, XK_b, "b" },
-	{ 2, 0, XK_Shift_L, XK_B, "B" },
-	{ 2, 2, 0, XK_n, "n" },
-	{ 2, 0, XK_Shift_L, XK_N, "N" },
-	{ 2, 2, 0, XK_comma, "," },
-	{ 2, 0, XK_Shift_L, XK_question, "?" },
-	{ 2, 2, 0, XK_semicolon, ";" },
-	{ 2, 0, XK_Shift_L, XK_period, "." },
-	{ 2, 2, 0, XK_colon, ":" },
-	{ 2, 0, XK_Shift_L, XK_slash, "/" },
-	{ 2, 2, 0, XK_exclam, "!" },
-	{ 2, 0, XK_Shift_L, XK_paragraph, "§" },
-	{ 3, 3, 0, 0, NULL },
-	{ 3, 3, 0, XK_Control_L, "Ctrl" },
-	{ 3, 3, 0, XK_Alt_L, "Alt" },
-	{ 3, 7, 0, XK_space, " " },
-	{ 3, 0, XK_Shift_L, XK_space, " " },
-	{ 3, 3, 0, XK_Alt_R, "Alt Gr" },
-	{ 3, 0, XK_Shift_L, XK_Alt_R, "Alt Gr" },
-	{ 3, 3, 0, XK_Return, "\xe2\x86\xb2" },
-	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
-	{ 0, 0, 0, 0, NULL }
-};
-
-static KeyboardKeyDefinition const * _keyboard_layout_letters_definition[KLT_COUNT] =
-{
-	_keyboard_layout_letters_qwerty,
-	_keyboard_layout_letters_qwertz,
-	_keyboard_layout_letters_azerty
-};
-
-static KeyboardKeyDefinition const _keyboard_layout_keypad[] =
-{
-	{ 0, 3, 0, XK_Num_Lock, "Num" },
-	{ 0, 1, 0, 0, NULL },
-	{ 0, 4, 0, XK_KP_Home, "\xe2\x86\x96" },
-	{ 0, 0, XK_Num_Lock, XK_7, "7" },
-	{ 0, 4, 0, XK_KP_Up, "\xe2\x86\x91" },
-	{ 0, 0, XK_Num_Lock, XK_8, "8" },
-	{ 0, 4, 0, XK_KP_Page_Up, "\xe2\x87\x9e" },
-	{ 0, 0, XK_Num_Lock, XK_9, "9" },
-	{ 0, 1, 0, 0, NULL },
-	{ 0, 3, 0, XK_KP_Subtract, "-" },
-	{ 1, 3, 0, XK_KP_Divide, "/" },
-	{ 1, 1, 0, 0, NULL },
-	{ 1, 4, 0, XK_KP_Left, "\xe2\x86\x90" },
-	{ 1, 0, XK_Num_Lock, XK_4, "4" },
-	{ 1, 4, 0, XK_5, "5" },
-	{ 1, 0, XK_Num_Lock, XK_5, "5" },
-	{ 1, 4, 0, XK_KP_Right, "\xe2\x86\x92" },
-	{ 1, 0, XK_Num_Lock, XK_6, "6" },
-	{ 1, 1, 0, 0, NULL },
-	{ 1, 3, 0, XK_KP_Add, "+" },
-	{ 2, 3, 0, XK_KP_Multiply, "*" },
-	{ 2, 1, 0, 0, NULL },
-	{ 2, 4, 0, XK_KP_End, "\xe2\x86\x99" },
-	{ 2, 0, XK_Num_Lock, XK_1, "1" },
-	{ 2, 4, 0, XK_KP_Down, "\xe2\x86\x93" },
-	{ 2, 0, XK_Num_Lock, XK_2, "2" },
-	{ 2, 4, 0, XK_KP_Page_Down, "\xe2\x87\x9f" },
-	{ 2, 0, XK_Num_Lock, XK_3, "3" },
-	{ 2, 1, 0, 0, NULL },
-	{ 2, 3, 0, XK_KP_Enter, "\xe2\x86\xb2" },
-	{ 3, 3, 0, 0, NULL },
-	{ 3, 1, 0, 0, NULL },
-	{ 3, 8, 0, XK_KP_Insert, "Ins" },
-	{ 3, 0, XK_Num_Lock, XK_0, "0" },
-	{ 3, 4, 0, XK_KP_Delete, "Del" },
-	{ 3, 0, XK_Num_Lock, XK_KP_Decimal, "." },
-	{ 3, 1, 0, 0, NULL },
-	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
-	{ 0, 0, 0, 0, NULL }
-};
-
-static KeyboardKeyDefinition const _keyboard_layout_special_qwerty[] =
-{
-	{ 0, 3, 0, XK_Escape, "Esc" },
-	{ 0, 2, 0, XK_F1, "F1" },
-	{ 0, 0, XK_Shift_L, XK_F5, "F5" },
-	{ 0, 2, 0, XK_F2, "F2" },
-	{ 0, 0, XK_Shift_L, XK_F6, "F6" },
-	{ 0, 2, 0, XK_F3, "F3" },
-	{ 0, 0, XK_Shift_L, XK_F7, "F7" },
-	{ 0, 2, 0, XK_F4, "F4" },
-	{ 0, 0, XK_Shift_L, XK_F8, "F8" },
-	{ 0, 1, 0, 0, NULL },
-	{ 0, 2, 0, XK_F5, "F5" },
-	{ 0, 0, XK_Shift_L, XK_F9, "F9" },
-	{ 0, 2, 0, XK_F6, "F6" },
-	{ 0, 0, XK_Shift_L, XK_F10, "F10" },
-	{ 0, 2, 0, XK_F7, "F7" },
-	{ 0, 0, XK_Shift_L, XK_F11, "F11" },
-	{ 0, 2, 0, XK_F8, "F8" },
-	{ 0, 0, XK_Shift_L, XK_F12, "F12" },
-	{ 1, 2, 0, XK_1, "1" },
-	{ 1, 0, XK_Shift_L, XK_exclam, "!" },
-	{ 1, 2, 0, XK_2, "2" },
-	{ 1, 0, XK_Shift_L, XK_at, "@" },
-	{ 1, 2, 0, XK_3, "3" },
-	{ 1, 0, XK_Shift_L, XK_numbersign, "#" },
-	{ 1, 2, 0, XK_4, "4" },
-	{ 1, 0, XK_Shift_L, XK_dollar, "$" },
-	{ 1, 2, 0, XK_5, "5" },
-	{ 1, 0, XK_Shift_L, XK_percent, "%" },
-	{ 1, 2, 0, XK_6, "6" },
-	{ 1, 0, XK_Shift_L, XK_asciicircum, "^" },
-	{ 1, 2, 0, XK_7, "7" },
-	{ 1, 0, XK_Shift_L, XK_ampersand, "&" },
-	{ 1, 2, 0, XK_8, "8" },
-	{ 1, 0, XK_Shift_L, XK_asterisk, "*" },
-	{ 1, 2, 0, XK_9, "9" },
-	{ 1, 0, XK_Shift_L, XK_parenleft, "(" },
-	{ 1, 2, 0, XK_0, "0" },
-	{ 1, 0, XK_Shift_L, XK_parenright, ")" },
-	{ 2, 3, 0, XK_Tab, "\xe2\x86\xb9" },
-	{ 2, 2, 0, XK_grave, "`" },
-	{ 2, 0, XK_Shift_L, XK_asciitilde, "~" },
-	{ 2, 2, 0, XK_minus, "-" },
-	{ 2, 0, XK_Shift_L, XK_minus, "_" },
-	{ 2, 2, 0, XK_equal, "=" },
-	{ 2, 0, XK_Shift_L, XK_equal, "+" },
-	{ 2, 2, 0, XK_backslash, "\\" },
-	{ 2, 0, XK_Shift_L, XK_backslash, "|" },
-	{ 2, 2, 0, XK_bracketleft, "[" },
-	{ 2, 0, XK_Shift_L, XK_bracketleft, "{" },
-	{ 2, 2, 0, XK_bracketright, "]" },
-	{ 2, 0, XK_Shift_L, XK_bracketright, "}" },
-	{ 2, 2, 0, XK_semicolon, ";" },
-	{ 2, 0, XK_Shift_L, XK_semicolon, ":" },
-	{ 2, 2, 0, XK_apostrophe, "'" },
-	{ 2, 0, XK_Shift_L, XK_apostrophe, "\"" },
-	{ 3, 3, 0, 0, NULL },
-	{ 3, 2, 0, XK_Shift_L, "\xe2\x87\xa7" },
-	{ 3, 3, 0, XK_space, " " },
-	{ 3, 0, XK_Shift_L, XK_space, " " },
-	{ 3, 2, 0, XK_comma, "," },
-	{ 3, 0, XK_Shift_L, XK_comma, "<" },
-	{ 3, 2, 0, XK_period, "." },
-	{ 2, 0, XK_Shift_L, XK_period, ">" },
-	{ 3, 2, 0, XK_slash, "/" },
-	{ 3, 0, XK_Shift_L, XK_slash, "?" },
-	{ 3, 3, 0, XK_Return, "\xe2\x86\xb2" },
-	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
-	{ 0, 0, 0, 0, NULL }
-};
-
-static KeyboardKeyDefinition const _keyboard_layout_special_qwertz[] =
-{
-	{ 0, 3, 0, XK_Escape, "Esc" },
-	{ 0, 2, 0, XK_F1, "F1" },
-	{ 0, 0, XK_Shift_L, XK_F5, "F5" },
-	{ 0, 2, 0, XK_F2, "F2" },
-	{ 0, 0, XK_Shift_L, XK_F6, "F6" },
-	{ 0, 2, 0, XK_F3, "F3" },
-	{ 0, 0, XK_Shift_L, XK_F7, "F7" },
-	{ 0, 2, 0, XK_F4, "F4" },
-	{ 0, 0, XK_Shift_L, XK_F8, "F8" },
-	{ 0, 1, 0, 0, NULL },
-	{ 0, 2, 0, XK_F5, "F5" },
-	{ 0, 0, XK_Shift_L, XK_F9, "F9" },
-	{ 0, 2, 0, XK_F6, "F6" },
-	{ 0, 0, XK_Shift_L, XK_F10, "F10" },
-	{ 0, 2, 0, XK_F7, "F7" },
-	{ 0, 0, XK_Shift_L, XK_F11, "F11" },
-	{ 0, 2, 0, XK_F8, "F8" },
-	{ 0, 0, XK_Shift_L, XK_F12, "F12" },
-	{ 1, 2, 0, XK_1, "1" },
-	{ 1, 0, XK_Shift_L, XK_exclam, "!" },
-	{ 1, 2, 0, XK_2, "2" },
-	{ 1, 0, XK_Shift_L, XK_at, "@" },
-	{ 1, 2, 0, XK_3, "3" },
-	{ 1, 0, XK_Shift_L, XK_numbersign, "#" },
-	{ 1, 2, 0, XK_4, "4" },
-	{ 1, 0, XK_Shift_L, XK_dollar, "$" },
-	{ 1, 2, 0, XK_5, "5" },
-	{ 1, 0, XK_Shift_L, XK_percent, "%" },
-	{ 1, 2, 0, XK_6, "6" },
-	{ 1, 0, XK_Shift_L, XK_asciicircum, "^" },
-	{ 1, 2, 0, XK_7, "7" },
-	{ 1, 0, XK_Shift_L, XK_ampersand, "&" },
-	{ 1, 2, 0, XK_8, "8" },
-	{ 1, 0, XK_Shift_L, XK_asterisk, "*" },
-	{ 1, 2, 0, XK_9, "9" },
-	{ 1, 0, XK_Shift_L, XK_parenleft, "(" },
-	{ 1, 2, 0, XK_0, "0" },
-	{ 1, 0, XK_Shift_L, XK_parenright, ")" },
-	{ 2, 3, 0, XK_Tab, "\xe2\x86\xb9" },
-	{ 2, 2, 0, XK_grave, "`" },
-	{ 2, 0, XK_Shift_L, XK_asciitilde, "~" },
-	{ 2, 2, 0, XK_minus, "-" },
-	{ 2, 0, XK_Shift_L, XK_minus, "_" },
-	{ 2, 2, 0, XK_equal, "=" },
-	{ 2, 0, XK_Shift_L, XK_equal, "+" },
-	{ 2, 2, 0, XK_backslash, "\\" },
-	{ 2, 0, XK_Shift_L, XK_backslash, "|" },
-	{ 2, 2, 0, XK_bracketleft, "[" },
-	{ 2, 0, XK_Shift_L, XK_bracketleft, "{" },
-	{ 2, 2, 0, XK_bracketright, "]" },
-	{ 2, 0, XK_Shift_L, XK_bracketright, "}" },
-	{ 2, 2, 0, XK_semicolon, ";" },
-	{ 2, 0, XK_Shift_L, XK_semicolon, ":" },
-	{ 2, 2, 0, XK_apostrophe, "'" },
-	{ 2, 0, XK_Shift_L, XK_apostrophe, "\"" },
-	{ 3, 3, 0, 0, NULL },
-	{ 3, 2, 0, XK_Shift_L, "\xe2\x87\xa7" },
-	{ 3, 3, 0, XK_space, " " },
-	{ 3, 0, XK_Shift_L, XK_space, " " },
-	{ 3, 2, 0, XK_comma, "," },
-	{ 3, 0, XK_Shift_L, XK_comma, "<" },
-	{ 3, 2, 0, XK_period, "." },
-	{ 2, 0, XK_Shift_L, XK_period, ">" },
-	{ 3, 2, 0, XK_slash, "/" },
-	{ 3, 0, XK_Shift_L, XK_slash, "?" },
-	{ 3, 3, 0, XK_Return, "\xe2\x86\xb2" },
-	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
-	{ 0, 0, 0, 0, NULL }
-};
-
-static KeyboardKeyDefinition const _keyboard_layout_special_azerty[] =
-{
-	{ 0, 3, 0, XK_Escape, "Esc" },
-	{ 0, 1, 0, 0, NULL },
-	{ 0, 2, 0, XK_F1, "F1" },
-	{ 0, 0, XK_Shift_L, XK_F5, "F5" },
-	{ 0, 2, 0, XK_F2, "F2" },
-	{ 0, 0, XK_Shift_L, XK_F6, "F6" },
-	{ 0, 2, 0, XK_F3, "F3" },
-	{ 0, 0, XK_Shift_L, XK_F7, "F7" },
-	{ 0, 2, 0, XK_F4, "F4" },
-	{ 0, 0, XK_Shift_L, XK_F8, "F8" },
-	{ 0, 2, 0, XK_F5, "F5" },
-	{ 0, 0, XK_Shift_L, XK_F9, "F9" },
-	{ 0, 2, 0, XK_F6, "F6" },
-	{ 0, 0, XK_Shift_L, XK_F10, "F10" },
-	{ 0, 2, 0, XK_F7, "F7" },
-	{ 0, 0, XK_Shift_L, XK_F11, "F11" },
-	{ 0, 2, 0, XK_F8, "F8" },
-	{ 0, 0, XK_Shift_L, XK_F12, "F12" },
-	{ 1, 1, 0, 0, NULL },
-	{ 1, 2, 0, XK_ampersand, "&" },
-	{ 1, 0, XK_Shift_L, XK_1, "1" },
-	{ 1, 2, 0, XK_eacute, "é" },
-	{ 1, 0, XK_Shift_L, XK_2, "2" },
-	{ 1, 2, 0, XK_quotedbl, "\"" },
-	{ 1, 0, XK_Shift_L, XK_3, "3" },
-	{ 1, 2, 0, XK_apostrophe, "'" },
-	{ 1, 0, XK_Shift_L, XK_4, "4" },
-	{ 1, 2, 0, XK_parenleft, "(" },
-	{ 1, 0, XK_Shift_L, XK_5, "5" },
-	{ 1, 2, 0, XK_minus, "-" },
-	{ 1, 0, XK_Shift_L, XK_6, "6" },
-	{ 1, 2, 0, XK_egrave, "è" },
-	{ 1, 0, XK_Shift_L, XK_7, "7" },
-	{ 1, 2, 0, XK_underscore, "_" },
-	{ 1, 0, XK_Shift_L, XK_8, "8" },
-	{ 1, 2, 0, XK_ccedilla, "ç" },
-	{ 1, 0, XK_Shift_L, XK_9, "9" },
-	{ 1, 2, 0, XK_aacute, "à" },
-	{ 1, 0, XK_Shift_L, XK_0, "0" },
-	{ 2, 2, 0, XK_Tab, "\xe2\x86\xb9" },
-	{ 2, 2, 0, XK_twosuperior, "²" },
-	{ 2, 2, 0, XK_asciitilde, "~" },
-	{ 2, 2, 0, XK_numbersign, "#" },
-	{ 2, 2, 0, XK_braceleft, "{" },
-	{ 2, 2, 0, XK_bracketleft, "[" },
-	{ 2, 2, 0, XK_bracketright, "]" },
-	{ 2, 2, 0, XK_braceright, "}" },
-	{ 2, 2, 0, XK_parenright, ")" },
-	{ 2, 0, XK_Shift_L, XK_degree, "°" },
-	{ 2, 2, 0, XK_equal, "=" },
-	{ 2, 0, XK_Shift_L, XK_plus, "+" },
-	{ 3, 3, 0, 0, NULL },
-	{ 3, 2, 0, XK_Shift_L, "\xe2\x87\xa7" },
-	{ 3, 2, 0, XK_bracketleft, "|" },
-	{ 3, 2, 0, XK_grave, "`" },
-	{ 3, 2, 0, XK_backslash, "\\" },
-	{ 3, 2, 0, XK_asciicircum, "^" },
-	{ 3, 2, 0, XK_at, "@" },
-	{ 3, 3, 0, XK_Return, "\xe2\x86\xb2" },
-	{ 3, 3, 0, XK_BackSpace, "\xe2\x8c\xab" },
-	{ 0, 0, 0, 0, NULL }
-};
-
-static KeyboardKeyDefinition const * _keyboard_layout_special_definition[KLT_COUNT] =
-{
-	_keyboard_layout_special_qwerty,
-	_keyboard_layout_special_qwertz,
-	_keyboard_layout_special_azerty
-};
-
-
-/* prototypes */
-static GtkWidget * _keyboard_add_layout(Keyboard * keyboard,
-		KeyboardLayoutDefinition * definitions,
-		size_t definitions_cnt, KeyboardLayoutSection section);
-
-static void _keyboard_error(Keyboard * keyboard, char const * format, ...);
+static gboolean _keyboard_on_idle(gpointer data);
+static gboolean _keyboard_on_repeat(gpointer data);
+static void _keyboard_on_suggestion(GtkWidget * widget, gpointer data);
 
 
 /* public */
@@ -689,38 +228,113 @@ static void _new_mode_embedded(Keyboard * keyboard);
 static void _new_mode_popup(Keyboard * keyboard);
 static void _new_mode_widget(Keyboard * keyboard);
 static void _new_mode_windowed(Keyboard * keyboard);
+static void _new_layout(Keyboard * keyboard, char const * name);
+static void _new_prewarm(Keyboard * keyboard);
+static void _new_profile(KeyboardProfile * profile, char const * filename);
+#if GTK_CHECK_VERSION(3, 0, 0)
+static void _new_style(Keyboard * keyboard);
+#endif
 
 Keyboard * keyboard_new(KeyboardPrefs * prefs)
 {
 	Keyboard * keyboard;
+	KeyboardProfile * profile = NULL;
 	GtkAccelGroup * group;
 	GdkScreen * screen;
 	GtkWidget * vbox;
 	GtkWidget * widget;
 	PangoFontDescription * bold;
-#if GTK_CHECK_VERSION(3, 0, 0)
-	GdkRGBA gray = { 0.56, 0.56, 0.56, 1.0 };
-#else
+#if !GTK_CHECK_VERSION(3, 0, 0)
 	GdkColor gray = { 0x90909090, 0x9090, 0x9090, 0x9090 };
 #endif
 	unsigned long id;
-	KeyboardLayoutDefinition layout[KLS_COUNT] =
+	const KeyboardLayoutDefinition layout[KLS_COUNT] =
 	{
-		{ "Abc", _keyboard_layout_letters_qwerty	},
-		{ "123", _keyboard_layout_keypad		},
-		{ ",./", _keyboard_layout_special_qwerty	}
+		{ "Abc", NULL	},
+		{ "123", NULL	},
+		{ ",./", NULL	}
 	};
 	size_t i;
-	KeyboardLayoutTypeName const * typename;
 
 #ifdef DEBUG
 	fprintf(stderr, "DEBUG: %s()\n", __func__);
 #endif
+	if(prefs->profile != NULL && (profile = keyboard_profile_new(
+				gdk_x11_get_default_xdisplay())) == NULL)
+	{
+		_keyboard_error(NULL, "%s", error_get(NULL));
+		return NULL;
+	}
 	if((keyboard = object_new(sizeof(*keyboard))) == NULL)
+	{
+		if(profile != NULL)
+			keyboard_profile_delete(profile);
 		return NULL;
+	}
 	keyboard->mode = prefs->mode;
-	keyboard->layouts = NULL;
-	keyboard->layouts_cnt = 0;
+	keyboard->surface = (prefs->surface != 0) ? TRUE : FALSE;
+	keyboard->verbose = (prefs->verbose != 0) ? TRUE : FALSE;
+	keyboard->layout = KLS_LETTERS;
+	keyboard->modifier = 0;
+	keyboard->repeat_delay = prefs->repeat_delay;
+	keyboard->repeat_rate = (prefs->repeat_rate > 0)
+		? prefs->repeat_rate : KEYBOARD_REPEAT_RATE;
+	keyboard->repeat = 0;
+	keyboard->repeat_key = NULL;
+	keyboard->repeated = FALSE;
+	if((keyboard->backend = keyboard_backend_new(prefs->backend)) == NULL)
+	{
+		_keyboard_error(NULL, "%s", error_get(NULL));
+		object_delete(keyboard);
+		if(profile != NULL)
+			keyboard_profile_delete(profile);
+		return NULL;
+	}
+	if((keyboard->keymap = keyboard_keymap_new(keyboard->backend)) == NULL)
+	{
+		keyboard_backend_delete(keyboard->backend);
+		object_delete(keyboard);
+		if(profile != NULL)
+			keyboard_profile_delete(profile);
+		return NULL;
+	}
+	if((keyboard->stats = keyboard_stats_new()) == NULL)
+	{
+		keyboard_keymap_delete(keyboard->keymap);
+		keyboard_backend_delete(keyboard->backend);
+		object_delete(keyboard);
+		if(profile != NULL)
+			keyboard_profile_delete(profile);
+		return NULL;
+	}
+	if((keyboard->glyphs = keyboard_glyphs_new()) == NULL)
+	{
+		keyboard_stats_delete(keyboard->stats);
+		keyboard_keymap_delete(keyboard->keymap);
+		keyboard_backend_delete(keyboard->backend);
+		object_delete(keyboard);
+		if(profile != NULL)
+			keyboard_profile_delete(profile);
+		return NULL;
+	}
+	keyboard->shown = 0;
+	keyboard->control = NULL;
+	keyboard_profile_mark(profile, "backend");
+	keyboard->definition = NULL;
+	memcpy(keyboard->definitions, layout, sizeof(layout));
+	for(i = 0; i < KLS_COUNT; i++)
+		keyboard->layouts[i] = NULL;
+	keyboard->source = 0;
+	keyboard->source_page = 0;
+	keyboard->dictionary = NULL;
+	keyboard->cursor = KEYBOARD_DICTIONARY_ROOT;
+	keyboard->word_len = 0;
+	memset(keyboard->suggestions, 0, sizeof(keyboard->suggestions));
+	keyboard->gesture = NULL;
+	keyboard->swiped = 0;
+	keyboard->su_box = NULL;
+	keyboard->text = NULL;
+	keyboard->text_cnt = 0;
 	screen = gdk_screen_get_default();
 	if(prefs != NULL && prefs->monitor > 0
 			&& prefs->monitor < gdk_screen_get_n_monitors(screen))
@@ -728,16 +342,24 @@ Keyboard * keyboard_new(KeyboardPrefs * prefs)
 				&keyboard->geometry);
 	else
 		gdk_screen_get_monitor_geometry(screen, 0, &keyboard->geometry);
+	keyboard_profile_mark(profile, "monitor");
 	/* windows */
 	_new_mode(keyboard, prefs->mode);
 #if GTK_CHECK_VERSION(3, 0, 0)
-	gtk_widget_override_background_color(keyboard->window,
-			GTK_STATE_FLAG_NORMAL, &gray);
+	gtk_style_context_add_class(gtk_widget_get_style_context(
+				keyboard->window), KEYBOARD_CLASS);
+	g_signal_connect_after(keyboard->window, "draw", G_CALLBACK(
+				_keyboard_on_draw), keyboard);
 #else
 	gtk_widget_modify_bg(keyboard->window, GTK_STATE_NORMAL, &gray);
+	g_signal_connect_after(keyboard->window, "expose-event", G_CALLBACK(
+				_keyboard_on_expose_event), keyboard);
 #endif
 	keyboard->icon = NULL;
 	keyboard->ab_window = NULL;
+	keyboard->pr_window = NULL;
+	keyboard->pr_text = NULL;
+	keyboard_profile_mark(profile, "window");
 	/* fonts */
 	if(prefs->font != NULL)
 		keyboard->font = pango_font_description_from_string(
@@ -750,6 +372,10 @@ Keyboard * keyboard_new(KeyboardPrefs * prefs)
 	}
 	bold = pango_font_description_new();
 	pango_font_description_set_weight(bold, PANGO_WEIGHT_BOLD);
+#if GTK_CHECK_VERSION(3, 0, 0)
+	_new_style(keyboard);
+#endif
+	keyboard_profile_mark(profile, "fonts");
 	vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 4);
 	gtk_container_add(GTK_CONTAINER(keyboard->window), vbox);
 	/* menubar */
@@ -769,34 +395,26 @@ Keyboard * keyboard_new(KeyboardPrefs * prefs)
 		gtk_widget_show(vbox);
 		vbox = widget;
 	}
+	keyboard_profile_mark(profile, "menubar");
 	/* layouts */
-	if(prefs->layout != NULL)
-	{
-		for(i = 0; i < sizeof(_keyboard_layout_type_name)
-				/ sizeof(*_keyboard_layout_type_name); i++)
-		{
-			typename = &_keyboard_layout_type_name[i];
-			if(strcasecmp(prefs->layout, typename->name) == 0)
-			{
-				layout[KLS_LETTERS].keys = _keyboard_layout_letters_definition[typename->type];
-				layout[KLS_SPECIAL].keys = _keyboard_layout_special_definition[typename->type];
-				break;
-			}
-			typename = NULL;
-		}
-		if(typename == NULL)
-			_keyboard_error(NULL, "%s: Unsupported layout",
-					prefs->layout);
-	}
-	if((widget = _keyboard_add_layout(keyboard, layout, KLS_COUNT,
-					KLS_LETTERS)) != NULL)
-		gtk_box_pack_start(GTK_BOX(vbox), widget, TRUE, TRUE, 0);
-	if((widget = _keyboard_add_layout(keyboard, layout, KLS_COUNT,
-					KLS_KEYPAD)) != NULL)
-		gtk_box_pack_start(GTK_BOX(vbox), widget, TRUE, TRUE, 0);
-	if((widget = _keyboard_add_layout(keyboard, layout, KLS_COUNT,
-					KLS_SPECIAL)) != NULL)
-		gtk_box_pack_start(GTK_BOX(vbox), widget, TRUE, TRUE, 0);
+	_new_layout(keyboard, prefs->layout);
+	keyboard_profile_mark(profile, "layout");
+	if(prefs->dictionary != NULL && (keyboard->dictionary
+				= keyboard_dictionary_new(prefs->dictionary))
+			== NULL)
+		_keyboard_error(NULL, "%s", error_get(NULL));
+	/* the gestures are followed on the single surface only */
+	if(prefs->gesture && prefs->surface && keyboard->dictionary != NULL
+			&& (keyboard->gesture = keyboard_gesture_new(
+					keyboard->dictionary)) == NULL)
+		_keyboard_error(NULL, "%s", error_get(NULL));
+	keyboard_profile_mark(profile, "dictionary");
+	keyboard->vbox = vbox;
+	/* only build the first page for now */
+	keyboard_set_layout(keyboard, KLS_LETTERS);
+	keyboard_profile_mark(profile, "page");
+	if(prefs->idle)
+		keyboard->source = g_idle_add(_keyboard_on_idle, keyboard);
 	gtk_widget_show(vbox);
 	if(prefs->mode == KEYBOARD_MODE_EMBEDDED)
 	{
@@ -823,15 +441,84 @@ Keyboard * keyboard_new(KeyboardPrefs * prefs)
 		/* show the window */
 		if(prefs->wait == 0)
 			gtk_widget_show(keyboard->window);
+		else if(prefs->prewarm)
+			_new_prewarm(keyboard);
 	}
-	keyboard_set_layout(keyboard, KLS_LETTERS);
 	pango_font_description_free(bold);
+	keyboard_profile_mark(profile, "show");
 	/* messages */
 	desktop_message_register(keyboard->window, KEYBOARD_CLIENT_MESSAGE,
 			on_keyboard_message, keyboard);
+	/* the control socket is optional */
+	if((keyboard->control = keyboard_control_new(keyboard)) == NULL)
+		_keyboard_error(NULL, "%s", error_get(NULL));
+	keyboard_profile_mark(profile, "messages");
+	if(profile != NULL)
+		_new_profile(profile, prefs->profile);
 	return keyboard;
 }
 
+static void _new_prewarm(Keyboard * keyboard)
+{
+	GtkRequisition requisition;
+#if GTK_CHECK_VERSION(3, 0, 0)
+	GtkAllocation allocation;
+	KeyboardLayout * layout;
+	cairo_surface_t * surface;
+	cairo_t * cr;
+#endif
+
+	/* realize and lay out the window while hidden */
+	gtk_widget_realize(keyboard->window);
+#if GTK_CHECK_VERSION(3, 0, 0)
+	gtk_widget_get_preferred_size(keyboard->window, NULL, &requisition);
+	allocation.x = 0;
+	allocation.y = 0;
+	allocation.width = MAX(keyboard->width, requisition.width);
+	allocation.height = MAX(keyboard->height, requisition.height);
+	gtk_widget_size_allocate(keyboard->window, &allocation);
+	/* the window is not drawn until mapped, but the labels of the keys
+	 * drawn on a surface can be rasterized into the glyph cache already */
+	if((layout = keyboard->layouts[keyboard->layout]) == NULL)
+		return;
+	gtk_widget_get_allocation(keyboard_layout_get_widget(layout),
+			&allocation);
+	surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+			MAX(allocation.width, 1), MAX(allocation.height, 1));
+	cr = cairo_create(surface);
+	keyboard_layout_draw(layout, cr);
+	cairo_destroy(cr);
+	cairo_surface_destroy(surface);
+#else
+	/* only the sizes are known in advance with Gtk+ 2 */
+	gtk_widget_size_request(keyboard->window, &requisition);
+#endif
+}
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+static void _new_style(Keyboard * keyboard)
+{
+	/* a single provider styles every widget, through their classes */
+	keyboard->css = gtk_css_provider_new();
+	_keyboard_style(keyboard);
+	gtk_style_context_add_provider_for_screen(gtk_widget_get_screen(
+				keyboard->window),
+			GTK_STYLE_PROVIDER(keyboard->css),
+			GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+	g_signal_connect(gtk_settings_get_default(),
+			"notify::gtk-application-prefer-dark-theme",
+			G_CALLBACK(_keyboard_on_theme), keyboard);
+}
+#endif
+
+static void _new_profile(KeyboardProfile * profile, char const * filename)
+{
+	keyboard_profile_print(profile, PROGNAME_KEYBOARD ": startup");
+	if(keyboard_profile_save(profile, filename) != 0)
+		_keyboard_error(NULL, "%s", error_get(NULL));
+	keyboard_profile_delete(profile);
+}
+
 static void _new_mode(Keyboard * keyboard, KeyboardMode mode)
 {
 	switch(mode)
@@ -938,20 +625,162 @@ static void _new_mode_windowed(Keyboard * keyboard)
 				on_keyboard_delete_event), keyboard);
 }
 
+static void _new_layout(Keyboard * keyboard, char const * name)
+{
+	KeyboardDefinition * definition;
+	KeyboardKeyDefinition const * keys;
+	size_t i;
+	gint64 time;
+
+	/* start from the default layout */
+	if((definition = keyboard_definition_new_builtin(NULL)) != NULL)
+	{
+		for(i = 0; i < KLS_COUNT; i++)
+			keyboard->definitions[i].keys
+				= keyboard_definition_get_keys(definition, i);
+		keyboard_definition_delete(definition);
+	}
+	if(name == NULL)
+		return;
+	/* look for a layout file first, unless XKB is to be followed */
+	time = g_get_monotonic_time();
+	if(strcmp(name, "xkb") == 0)
+		definition = keyboard_definition_new_xkb(
+				gdk_x11_get_default_xdisplay());
+	else
+		definition = keyboard_definition_new(name);
+	if(definition == NULL)
+	{
+		_keyboard_error(NULL, "%s", error_get(NULL));
+		return;
+	}
+	/* the missing sections remain the default ones */
+	for(i = 0; i < KLS_COUNT; i++)
+		if((keys = keyboard_definition_get_keys(definition, i)) != NULL)
+			keyboard->definitions[i].keys = keys;
+	keyboard->definition = definition;
+	if(keyboard->verbose)
+		fprintf(stderr, "%s: %s: %s %.3f ms\n", PROGNAME_KEYBOARD, name,
+				_("Layout loaded in"),
+				(g_get_monotonic_time() - time) / 1000.0);
+}
+
 
 /* keyboard_delete */
 void keyboard_delete(Keyboard * keyboard)
 {
+	size_t i;
+
 #ifdef DEBUG
 	fprintf(stderr, "DEBUG: %s()\n", __func__);
+#endif
+	if(keyboard->control != NULL)
+		keyboard_control_delete(keyboard->control);
+	if(keyboard->source != 0)
+		g_source_remove(keyboard->source);
+	keyboard_repeat_stop(keyboard);
+	if(keyboard->pr_window != NULL)
+		gtk_widget_destroy(keyboard->pr_window);
+#if GTK_CHECK_VERSION(3, 0, 0)
+	g_signal_handlers_disconnect_by_func(gtk_settings_get_default(),
+			_keyboard_on_theme, keyboard);
+	gtk_style_context_remove_provider_for_screen(gtk_widget_get_screen(
+				keyboard->window),
+			GTK_STYLE_PROVIDER(keyboard->css));
+	g_object_unref(keyboard->css);
 #endif
 	gtk_widget_destroy(keyboard->window);
+	for(i = 0; i < KLS_COUNT; i++)
+		if(keyboard->layouts[i] != NULL)
+			keyboard_layout_delete(keyboard->layouts[i]);
+	if(keyboard->definition != NULL)
+		keyboard_definition_delete(keyboard->definition);
+	keyboard_keymap_delete(keyboard->keymap);
+	keyboard_glyphs_delete(keyboard->glyphs);
+	keyboard_stats_delete(keyboard->stats);
+	keyboard_backend_delete(keyboard->backend);
+	if(keyboard->gesture != NULL)
+		keyboard_gesture_delete(keyboard->gesture);
+	if(keyboard->dictionary != NULL)
+		keyboard_dictionary_delete(keyboard->dictionary);
+	free(keyboard->text);
+	free(keyboard->pr_text);
 	pango_font_description_free(keyboard->font);
 	object_delete(keyboard);
 }
 
 
 /* accessors */
+/* keyboard_get_backend */
+KeyboardBackend * keyboard_get_backend(Keyboard * keyboard)
+{
+	return keyboard->backend;
+}
+
+
+/* keyboard_get_gesture */
+KeyboardGesture * keyboard_get_gesture(Keyboard * keyboard)
+{
+	return keyboard->gesture;
+}
+
+
+/* keyboard_get_glyphs */
+KeyboardGlyphs * keyboard_get_glyphs(Keyboard * keyboard)
+{
+	return keyboard->glyphs;
+}
+
+
+/* keyboard_get_likelihood */
+gdouble keyboard_get_likelihood(Keyboard * keyboard, unsigned int keysym)
+{
+	uint32_t weight;
+	uint32_t cursor;
+	gunichar c;
+	char buf[6];
+	size_t len;
+	size_t i;
+
+	/* unknown without a dictionary, or outside its words */
+	if(keyboard->dictionary == NULL
+			|| (weight = keyboard_dictionary_get_weight(
+					keyboard->dictionary, keyboard->cursor))
+			== 0
+			|| (c = gdk_keyval_to_unicode(keysym)) == 0
+			|| !g_unichar_isalpha(c))
+		return -1.0;
+	/* relative to the most frequent word from the letters typed */
+	len = g_unichar_to_utf8(g_unichar_tolower(c), buf);
+	for(i = 0, cursor = keyboard->cursor; i < len; i++)
+		cursor = keyboard_dictionary_next(keyboard->dictionary, cursor,
+				buf[i]);
+	return (gdouble)keyboard_dictionary_get_weight(keyboard->dictionary,
+			cursor) / weight;
+}
+
+
+/* keyboard_get_keymap */
+KeyboardKeymap * keyboard_get_keymap(Keyboard * keyboard)
+{
+	return keyboard->keymap;
+}
+
+
+/* keyboard_get_modifier */
+unsigned int keyboard_get_modifier(Keyboard * keyboard)
+{
+	return keyboard->modifier;
+}
+
+
+/* keyboard_get_stats */
+KeyboardStats * keyboard_get_stats(Keyboard * keyboard)
+{
+	return keyboard->stats;
+}
+
+
 /* keyboard_get_widget */
 GtkWidget * keyboard_get_widget(Keyboard * keyboard)
 {
@@ -972,9 +801,22 @@ void keyboard_set_layout(Keyboard * keyboard, unsigned int which)
 	size_t i;
 	GtkWidget * widget;
 
-	for(i = 0; i < keyboard->layouts_cnt; i++)
-		if((widget = keyboard_layout_get_widget(keyboard->layouts[i]))
-				== NULL)
+	if(which >= KLS_COUNT)
+		return;
+	if(keyboard->layouts[which] == NULL
+			&& _keyboard_add_layout(keyboard, which) == NULL)
+		return;
+	keyboard->layout = which;
+	keyboard_layout_apply_modifier(keyboard->layouts[which],
+			keyboard->modifier);
+	/* the suggestions are only useful along the letters */
+	if(keyboard->su_box != NULL)
+		gtk_widget_set_visible(keyboard->su_box, which == KLS_LETTERS);
+	for(i = 0; i < KLS_COUNT; i++)
+		if(keyboard->layouts[i] == NULL)
+			continue;
+		else if((widget = keyboard_layout_get_widget(
+						keyboard->layouts[i])) == NULL)
 			continue;
 		else if(i == which)
 			gtk_widget_show(widget);
@@ -986,10 +828,11 @@ void keyboard_set_layout(Keyboard * keyboard, unsigned int which)
 /* keyboard_set_modifier */
 void keyboard_set_modifier(Keyboard * keyboard, unsigned int modifier)
 {
-	size_t i;
-
-	for(i = 0; i < keyboard->layouts_cnt; i++)
-		keyboard_layout_apply_modifier(keyboard->layouts[i], modifier);
+	keyboard->modifier = modifier;
+	/* only relabel the current layout for the moment */
+	if(keyboard->layouts[keyboard->layout] != NULL)
+		keyboard_layout_apply_modifier(
+				keyboard->layouts[keyboard->layout], modifier);
 }
 
 
@@ -1010,6 +853,35 @@ void keyboard_set_page(Keyboard * keyboard, KeyboardPage page)
 
 
 /* useful */
+/* keyboard_release_modifiers */
+void keyboard_release_modifiers(Keyboard * keyboard)
+{
+	size_t i;
+
+	for(i = 0; i < KLS_COUNT; i++)
+		if(keyboard->layouts[i] != NULL)
+			keyboard_layout_release_modifiers(keyboard->layouts[i]);
+	keyboard_set_modifier(keyboard, 0);
+	keyboard_backend_flush_idle(keyboard->backend);
+}
+
+
+/* keyboard_send_stats */
+void keyboard_send_stats(Keyboard * keyboard)
+{
+	unsigned int i;
+	unsigned int j;
+
+	desktop_message_send(KEYBOARD_STATS_MESSAGE, KEYBOARD_STATS_KEYMAP, 0,
+			keyboard_keymap_get_invalidations(keyboard->keymap));
+	for(i = 0; i < KEYBOARD_STATS_COUNT; i++)
+		for(j = 0; j < KEYBOARD_STATS_VALUE_COUNT; j++)
+			desktop_message_send(KEYBOARD_STATS_MESSAGE, i, j,
+					keyboard_stats_get(keyboard->stats, i,
+						j));
+}
+
+
 /* keyboard_show */
 void keyboard_show(Keyboard * keyboard, gboolean show)
 {
@@ -1018,6 +890,9 @@ void keyboard_show(Keyboard * keyboard, gboolean show)
 #endif
 	if(show == TRUE)
 	{
+		/* until the first frame */
+		if(!gtk_widget_get_visible(keyboard->window))
+			keyboard->shown = g_get_monotonic_time();
 		gtk_window_get_size(GTK_WINDOW(keyboard->window),
 				&keyboard->width, &keyboard->height);
 		gtk_widget_show(keyboard->window);
@@ -1030,9 +905,13 @@ void keyboard_show(Keyboard * keyboard, gboolean show)
 				keyboard->x, keyboard->y);
 #endif
 	}
-	else if(keyboard->mode != KEYBOARD_MODE_EMBEDDED
-			&& keyboard->mode != KEYBOARD_MODE_WIDGET)
-		gtk_widget_hide(keyboard->window);
+	else
+	{
+		keyboard_repeat_stop(keyboard);
+		if(keyboard->mode != KEYBOARD_MODE_EMBEDDED
+				&& keyboard->mode != KEYBOARD_MODE_WIDGET)
+			gtk_widget_hide(keyboard->window);
+	}
 }
 
 
@@ -1076,38 +955,428 @@ static gboolean _about_on_closex(gpointer data)
 }
 
 
+/* keyboard_repeat_start */
+void keyboard_repeat_start(Keyboard * keyboard, KeyboardKey * key)
+{
+	keyboard_repeat_stop(keyboard);
+	if(keyboard->repeat_delay <= 0
+			|| keysym_is_modifier(keyboard_key_get_keysym(key)))
+		return;
+	keyboard->repeat_key = key;
+	keyboard->repeated = FALSE;
+	keyboard->repeat = g_timeout_add(keyboard->repeat_delay,
+			_keyboard_on_repeat, keyboard);
+}
+
+
+/* keyboard_repeat_stop */
+gboolean keyboard_repeat_stop(Keyboard * keyboard)
+{
+	if(keyboard->repeat == 0)
+		return FALSE;
+	g_source_remove(keyboard->repeat);
+	keyboard->repeat = 0;
+	keyboard->repeat_key = NULL;
+	/* the key was typed already if repeated */
+	return keyboard->repeated;
+}
+
+
+/* keyboard_suggest */
+void keyboard_suggest(Keyboard * keyboard, unsigned int keysym)
+{
+	gunichar c;
+	char buf[6];
+	size_t len;
+	size_t i;
+
+	if(keyboard->dictionary == NULL || keysym_is_modifier(keysym))
+		return;
+	keyboard->swiped = 0;
+	if(keysym == XK_BackSpace)
+	{
+		/* go through the rest of the word again */
+		if(keyboard->word_len > 0)
+			keyboard->word_len = g_utf8_find_prev_char(
+					keyboard->word, &keyboard->word[
+					keyboard->word_len]) - keyboard->word;
+		keyboard->cursor = KEYBOARD_DICTIONARY_ROOT;
+		for(i = 0; i < keyboard->word_len; i++)
+			keyboard->cursor = keyboard_dictionary_next(
+					keyboard->dictionary, keyboard->cursor,
+					keyboard->word[i]);
+	}
+	else if((c = gdk_keyval_to_unicode(keysym)) != 0
+			&& g_unichar_isalpha(c)
+			&& (len = g_unichar_to_utf8(g_unichar_tolower(c), buf))
+			< sizeof(keyboard->word) - keyboard->word_len)
+		/* only the new letter is looked up */
+		for(i = 0; i < len; i++)
+		{
+			keyboard->word[keyboard->word_len++] = buf[i];
+			keyboard->cursor = keyboard_dictionary_next(
+					keyboard->dictionary, keyboard->cursor,
+					buf[i]);
+		}
+	else
+	{
+		/* a new word starts */
+		keyboard->cursor = KEYBOARD_DICTIONARY_ROOT;
+		keyboard->word_len = 0;
+	}
+	_keyboard_suggest_update(keyboard);
+}
+
+
+/* keyboard_swipe */
+void keyboard_swipe(Keyboard * keyboard)
+{
+	char words[KEYBOARD_DICTIONARY_TOP][KEYBOARD_DICTIONARY_WORD];
+	size_t cnt;
+	char * text;
+
+	if(keyboard->gesture == NULL
+			|| (cnt = keyboard_gesture_decode(keyboard->gesture,
+					words)) == 0)
+		return;
+	/* type the best word, the others may replace it */
+	if((text = g_strdup_printf("%s ", words[0])) == NULL)
+		return;
+	keyboard_type(keyboard, text);
+	g_free(text);
+	keyboard->swiped = g_utf8_strlen(words[0], -1) + 1;
+	memcpy(keyboard->suggestions, words, sizeof(words));
+	_keyboard_suggest_show(keyboard, cnt);
+}
+
+
+/* keyboard_type */
+/* the modifiers pressed to type, and those latched on screen instead */
+static const struct
+{
+	unsigned int modifier;
+	KeySym keysym;
+	KeySym latched;
+} _type_modifiers[] =
+{
+	{ KM_SHIFT,	XK_Shift_L,		XK_Shift_L	},
+	{ KM_LEVEL3,	XK_ISO_Level3_Shift,	XK_Alt_R	}
+};
+#define TYPE_MODIFIERS	(sizeof(_type_modifiers) / sizeof(*_type_modifiers))
+
+static void _type_modifier(Keyboard * keyboard, unsigned int modifier,
+		KeyCode held[TYPE_MODIFIERS]);
+static void _type_restore(Keyboard * keyboard, KeyCode held[TYPE_MODIFIERS]);
+
+int keyboard_type(Keyboard * keyboard, char const * text)
+{
+	gunichar c;
+	KeySym keysym;
+	KeyCode keycode;
+	unsigned int modifier;
+	KeyCode held[TYPE_MODIFIERS];
+	size_t i;
+
+	if(!g_utf8_validate(text, -1, NULL))
+	{
+		_keyboard_error(keyboard, "%s", _("Invalid text"));
+		return -1;
+	}
+	/* start from the modifiers latched on screen, already pressed */
+	for(i = 0; i < TYPE_MODIFIERS; i++)
+		held[i] = (keyboard->modifier & _type_modifiers[i].modifier)
+			? keyboard_keymap_get_keycode(keyboard->keymap,
+					_type_modifiers[i].latched)
+			: NoSymbol;
+	/* the word typed is unknown from now on */
+	keyboard->cursor = KEYBOARD_DICTIONARY_ROOT;
+	keyboard->word_len = 0;
+	keyboard->swiped = 0;
+	_keyboard_suggest_update(keyboard);
+	for(; *text != '\0'; text = g_utf8_next_char(text))
+	{
+		if((c = g_utf8_get_char(text)) == '\b')
+			keysym = XK_BackSpace;
+		else if(c == '\n')
+			keysym = XK_Return;
+		else if(c == '\t')
+			keysym = XK_Tab;
+		else
+			keysym = gdk_unicode_to_keyval(c);
+		if((keycode = keyboard_keymap_get_keycode_modifier(
+						keyboard->keymap, keysym,
+						&modifier)) == NoSymbol)
+			continue;
+		_type_modifier(keyboard, modifier, held);
+		keyboard_backend_press(keyboard->backend, keycode);
+		keyboard_backend_release(keyboard->backend, keycode);
+	}
+	_type_restore(keyboard, held);
+	/* send the events in a single batch */
+	keyboard_backend_flush_idle(keyboard->backend);
+	return 0;
+}
+
+static void _type_modifier(Keyboard * keyboard, unsigned int modifier,
+		KeyCode held[TYPE_MODIFIERS])
+{
+	size_t i;
+
+	/* only press or release the modifiers changing */
+	for(i = 0; i < TYPE_MODIFIERS; i++)
+		if((modifier & _type_modifiers[i].modifier) == 0)
+		{
+			if(held[i] == NoSymbol)
+				continue;
+			keyboard_backend_release(keyboard->backend, held[i]);
+			held[i] = NoSymbol;
+		}
+		else if(held[i] == NoSymbol
+				&& (held[i] = keyboard_keymap_get_keycode(
+						keyboard->keymap,
+						_type_modifiers[i].keysym))
+				!= NoSymbol)
+			keyboard_backend_press(keyboard->backend, held[i]);
+}
+
+static void _type_restore(Keyboard * keyboard, KeyCode held[TYPE_MODIFIERS])
+{
+	KeyCode latched;
+	size_t i;
+
+	/* leave the modifiers as latched on screen */
+	for(i = 0; i < TYPE_MODIFIERS; i++)
+	{
+		latched = (keyboard->modifier & _type_modifiers[i].modifier)
+			? keyboard_keymap_get_keycode(keyboard->keymap,
+					_type_modifiers[i].latched)
+			: NoSymbol;
+		if(held[i] == latched)
+			continue;
+		if(held[i] != NoSymbol)
+			keyboard_backend_release(keyboard->backend, held[i]);
+		if(latched != NoSymbol)
+			keyboard_backend_press(keyboard->backend, latched);
+	}
+}
+
+
+/* keyboard_type_chunk */
+int keyboard_type_chunk(Keyboard * keyboard, char const * buf, size_t len,
+		gboolean last)
+{
+	int ret;
+	char * p;
+
+	if(keyboard->text_cnt + len >= KEYBOARD_TEXT_MAX
+			|| (p = realloc(keyboard->text,
+					keyboard->text_cnt + len + 1)) == NULL)
+	{
+		_keyboard_error(keyboard, "%s", _("Text too long"));
+		free(keyboard->text);
+		keyboard->text = NULL;
+		keyboard->text_cnt = 0;
+		return -1;
+	}
+	keyboard->text = p;
+	memcpy(&p[keyboard->text_cnt], buf, len);
+	keyboard->text_cnt += len;
+	p[keyboard->text_cnt] = '\0';
+	if(!last)
+		return 0;
+	ret = keyboard_type(keyboard, keyboard->text);
+	free(keyboard->text);
+	keyboard->text = NULL;
+	keyboard->text_cnt = 0;
+	return ret;
+}
+
+
+/* keyboard_key_show */
+static void _key_show_preview(Keyboard * keyboard);
+static void _key_show_preview_draw(Keyboard * keyboard, GtkWidget * widget,
+		cairo_t * cr);
+/* callbacks */
+#if GTK_CHECK_VERSION(3, 0, 0)
+static gboolean _key_show_preview_on_draw(GtkWidget * widget, cairo_t * cr,
+		gpointer data);
+#else
+static gboolean _key_show_preview_on_expose_event(GtkWidget * widget,
+		GdkEventExpose * event, gpointer data);
+static void _key_show_preview_on_realize(GtkWidget * widget,
+		gpointer data);
+#endif
+
+void keyboard_key_show(Keyboard * keyboard, KeyboardKey * key, gboolean show,
+		GdkRectangle * area)
+{
+	char const * label;
+
+	if(show == FALSE)
+	{
+		if(keyboard->pr_window != NULL)
+			gtk_widget_hide(keyboard->pr_window);
+		return;
+	}
+	if(keyboard->pr_window == NULL)
+		_key_show_preview(keyboard);
+	/* the label is drawn from the glyphs of the layouts */
+	label = keyboard_key_get_label(key);
+	if(keyboard->pr_text == NULL || strcmp(keyboard->pr_text, label) != 0)
+	{
+		free(keyboard->pr_text);
+		keyboard->pr_text = strdup(label);
+		gtk_widget_queue_draw(keyboard->pr_area);
+	}
+	/* only resize when necessary */
+	if(keyboard->pr_width != area->width + 8
+			|| keyboard->pr_height != area->height * 2)
+	{
+		keyboard->pr_width = area->width + 8;
+		keyboard->pr_height = area->height * 2;
+		gtk_widget_set_size_request(keyboard->pr_window,
+				keyboard->pr_width, keyboard->pr_height);
+	}
+	gtk_window_move(GTK_WINDOW(keyboard->pr_window), area->x - 4,
+			area->y - area->height * 2);
+	gtk_widget_show(keyboard->pr_window);
+}
+
+static void _key_show_preview(Keyboard * keyboard)
+{
+	keyboard->pr_window = gtk_window_new(GTK_WINDOW_POPUP);
+	keyboard->pr_width = -1;
+	keyboard->pr_height = -1;
+	/* drawn like the keys of the surfaces */
+	keyboard->pr_area = gtk_drawing_area_new();
+#if GTK_CHECK_VERSION(3, 0, 0)
+	g_signal_connect(keyboard->pr_area, "draw", G_CALLBACK(
+				_key_show_preview_on_draw), keyboard);
+#else
+	g_signal_connect(keyboard->pr_window, "realize", G_CALLBACK(
+				_key_show_preview_on_realize), NULL);
+	g_signal_connect(keyboard->pr_area, "expose-event", G_CALLBACK(
+				_key_show_preview_on_expose_event), keyboard);
+#endif
+	gtk_container_add(GTK_CONTAINER(keyboard->pr_window),
+			keyboard->pr_area);
+	gtk_widget_show(keyboard->pr_area);
+}
+
+static void _key_show_preview_draw(Keyboard * keyboard, GtkWidget * widget,
+		cairo_t * cr)
+{
+	GdkRectangle area;
+
+	gtk_widget_get_allocation(widget, &area);
+	area.x = 0;
+	area.y = 0;
+	cairo_set_source_rgb(cr, 0.82, 0.82, 0.82);
+	cairo_rectangle(cr, 0.5, 0.5, area.width - 1, area.height - 1);
+	cairo_fill_preserve(cr);
+	cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+	cairo_set_line_width(cr, 1.0);
+	cairo_stroke(cr);
+	if(keyboard->pr_text != NULL)
+		keyboard_glyphs_draw(keyboard->glyphs, widget, cr,
+				keyboard->pr_text, keyboard->font, 0x000000,
+				&area, 0.1);
+}
+
+/* callbacks */
+#if GTK_CHECK_VERSION(3, 0, 0)
+static gboolean _key_show_preview_on_draw(GtkWidget * widget, cairo_t * cr,
+		gpointer data)
+{
+	Keyboard * keyboard = data;
+
+	_key_show_preview_draw(keyboard, widget, cr);
+	return TRUE;
+}
+#else
+static gboolean _key_show_preview_on_expose_event(GtkWidget * widget,
+		GdkEventExpose * event, gpointer data)
+{
+	Keyboard * keyboard = data;
+	cairo_t * cr;
+
+	cr = gdk_cairo_create(gtk_widget_get_window(widget));
+	_key_show_preview_draw(keyboard, widget, cr);
+	cairo_destroy(cr);
+	return TRUE;
+}
+
+static void _key_show_preview_on_realize(GtkWidget * widget,
+		gpointer data)
+{
+	int width;
+	int height;
+	GdkBitmap * mask;
+	GdkGC * gc;
+	GdkColor black = { 0, 0, 0, 0 };
+	GdkColor white = { 0xffffffff, 0xffff, 0xffff, 0xffff };
+
+	/* XXX potential invalid assumption as to how the button is drawn */
+	gtk_window_get_size(GTK_WINDOW(widget), &width, &height);
+	mask = gdk_pixmap_new(NULL, width, height, 1);
+	gc = gdk_gc_new(mask);
+	gdk_gc_set_foreground(gc, &white);
+	gdk_draw_rectangle(mask, gc, TRUE, 0, 0, width, height);
+	gdk_gc_set_foreground(gc, &black);
+	/* left column */
+	gdk_draw_rectangle(mask, gc, TRUE, 0, 0, 1, height);
+	/* top row */
+	gdk_draw_rectangle(mask, gc, TRUE, 0, 0, width, 1);
+	/* right column */
+	gdk_draw_rectangle(mask, gc, TRUE, width - 1, 0, 1, height);
+	/* bottom row */
+	gdk_draw_rectangle(mask, gc, TRUE, 0, height - 1, width, 1);
+	/* top left corner */
+	gdk_draw_rectangle(mask, gc, TRUE, 0, 0, 2, 2);
+	/* top right corner */
+	gdk_draw_rectangle(mask, gc, TRUE, width - 2, 0, 2, 2);
+	/* bottom left corner */
+	gdk_draw_rectangle(mask, gc, TRUE, 0, height - 2, 2, 2);
+	/* bottom right corner */
+	gdk_draw_rectangle(mask, gc, TRUE, width - 2, height - 2, 2, 2);
+	gtk_widget_shape_combine_mask(widget, mask, 0, 0);
+	g_object_unref(gc);
+	g_object_unref(mask);
+}
+#endif
+
+
 /* private */
 /* keyboard_add_layout */
 static void _layout_clicked(GtkWidget * widget, gpointer data);
+static void _layout_suggestions(Keyboard * keyboard);
 static void _layout_selector(Keyboard * keyboard, KeyboardLayout * layout,
 		KeyboardLayoutDefinition * definitions,
 		size_t definitions_cnt, KeyboardLayoutSection section,
 		unsigned int row, unsigned int column, unsigned width);
 
-static GtkWidget * _keyboard_add_layout(Keyboard * keyboard,
-		KeyboardLayoutDefinition * definitions,
-		size_t definitions_cnt, KeyboardLayoutSection section)
+static KeyboardLayout * _keyboard_add_layout(Keyboard * keyboard,
+		KeyboardLayoutSection section)
 {
-	KeyboardLayout ** p;
 	KeyboardLayout * layout;
 	KeyboardKeyDefinition const * keys;
 	size_t i;
 	KeyboardKey * key;
 	GtkWidget * widget;
+	gint64 time;
 #if !GTK_CHECK_VERSION(3, 0, 0)
 	const GdkColor black = { 0x00000000, 0x0000, 0x0000, 0x0000 };
 	const GdkColor white = { 0xffffffff, 0xffff, 0xffff, 0xffff };
 	const GdkColor gray = { 0xd0d0d0d0, 0xd0d0, 0xd0d0, 0xd0d0 };
 #endif
 
-	if((p = realloc(keyboard->layouts, sizeof(*p) * (keyboard->layouts_cnt
-						+ 1))) == NULL)
-		return NULL;
-	keyboard->layouts = p;
-	if((layout = keyboard_layout_new()) == NULL)
+	time = g_get_monotonic_time();
+	if((layout = keyboard_layout_new(keyboard, keyboard->keymap,
+					keyboard->surface)) == NULL)
 		return NULL;
-	keyboard->layouts[keyboard->layouts_cnt++] = layout;
-	keys = definitions[section].keys;
+	keyboard->layouts[section] = layout;
+	keyboard_layout_set_font(layout, keyboard->font);
+	keys = keyboard->definitions[section].keys;
 	for(i = 0; keys[i].width != 0; i++)
 	{
 		key = keyboard_layout_add(layout, keys[i].row, keys[i].width,
@@ -1117,8 +1386,8 @@ static GtkWidget * _keyboard_add_layout(Keyboard * keyboard,
 #if !GTK_CHECK_VERSION(3, 0, 0)
 		keyboard_key_set_background(key, &gray);
 		keyboard_key_set_foreground(key, &black);
-#endif
 		keyboard_key_set_font(key, keyboard->font);
+#endif
 		for(; keys[i + 1].width == 0 && keys[i + 1].modifier != 0; i++)
 		{
 #if !GTK_CHECK_VERSION(3, 0, 0)
@@ -1128,13 +1397,21 @@ static GtkWidget * _keyboard_add_layout(Keyboard * keyboard,
 					keys[i + 1].keysym, keys[i + 1].label);
 		}
 	}
-	_layout_selector(keyboard, layout, definitions, definitions_cnt,
+	_layout_selector(keyboard, layout, keyboard->definitions, KLS_COUNT,
 			section, 3, 0, 3);
+	if(section == KLS_LETTERS && keyboard->dictionary != NULL)
+		_layout_suggestions(keyboard);
 	widget = keyboard_layout_get_widget(layout);
 	gtk_widget_show_all(widget);
 	gtk_widget_set_no_show_all(widget, TRUE);
 	gtk_widget_hide(widget);
-	return widget;
+	gtk_box_pack_start(GTK_BOX(keyboard->vbox), widget, TRUE, TRUE, 0);
+	if(keyboard->verbose)
+		fprintf(stderr, "%s: %s: %s %.3f ms\n", PROGNAME_KEYBOARD,
+				keyboard->definitions[section].label,
+				_("Page built in"),
+				(g_get_monotonic_time() - time) / 1000.0);
+	return layout;
 }
 
 static void _layout_clicked(GtkWidget * widget, gpointer data)
@@ -1155,6 +1432,31 @@ static void _layout_clicked(GtkWidget * widget, gpointer data)
 	}
 }
 
+static void _layout_suggestions(Keyboard * keyboard)
+{
+	unsigned long i;
+	GtkWidget * widget;
+
+	/* above the letters */
+	keyboard->su_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+	gtk_box_set_homogeneous(GTK_BOX(keyboard->su_box), TRUE);
+	for(i = 0; i < KEYBOARD_DICTIONARY_TOP; i++)
+	{
+		widget = gtk_button_new_with_label("");
+		gtk_widget_set_sensitive(widget, FALSE);
+		g_object_set_data(G_OBJECT(widget), "suggestion", (void *)i);
+		g_signal_connect(widget, "clicked", G_CALLBACK(
+					_keyboard_on_suggestion), keyboard);
+		gtk_box_pack_start(GTK_BOX(keyboard->su_box), widget, TRUE,
+				TRUE, 0);
+		keyboard->su_buttons[i] = widget;
+	}
+	gtk_widget_show_all(keyboard->su_box);
+	gtk_widget_set_no_show_all(keyboard->su_box, TRUE);
+	gtk_box_pack_start(GTK_BOX(keyboard->vbox), keyboard->su_box, FALSE,
+			TRUE, 0);
+}
+
 static void _layout_selector(Keyboard * keyboard, KeyboardLayout * layout,
 		KeyboardLayoutDefinition * definitions,
 		size_t definitions_cnt, KeyboardLayoutSection section,
@@ -1163,33 +1465,32 @@ static void _layout_selector(Keyboard * keyboard, KeyboardLayout * layout,
 	unsigned long l;
 	GtkWidget * label;
 	GtkWidget * widget;
-#if GTK_CHECK_VERSION(3, 0, 0)
-	gboolean dark = FALSE;
-	const GdkRGBA black = { 0.0, 0.0, 0.0, 1.0 };
-	const GdkRGBA white = { 1.0, 1.0, 1.0, 1.0 };
-#else
+#if !GTK_CHECK_VERSION(3, 0, 0)
 	const GdkColor black = { 0x00000000, 0x0000, 0x0000, 0x0000 };
 	const GdkColor white = { 0xffffffff, 0xffff, 0xffff, 0xffff };
 #endif
+	KeyboardLayoutCallback callbacks[KLS_COUNT] =
+	{
+		on_keyboard_set_layout_letters,
+		on_keyboard_set_layout_keypad,
+		on_keyboard_set_layout_special
+	};
 
-#if GTK_CHECK_VERSION(3, 0, 0)
-	g_object_get(gtk_settings_get_default(),
-			"gtk-application-prefer-dark-theme", &dark, NULL);
-#endif
 	l = (section + 1) % definitions_cnt;
+	if(keyboard->surface)
+	{
+		keyboard_layout_add_action(layout, row, column, width,
+				definitions[l].label, callbacks[l], keyboard);
+		return;
+	}
 	label = gtk_label_new(definitions[l].label);
+	widget = gtk_button_new();
 #if GTK_CHECK_VERSION(3, 0, 0)
-	gtk_widget_override_color(label, GTK_STATE_FLAG_NORMAL,
-			dark ? &white : &black);
+	gtk_style_context_add_class(gtk_widget_get_style_context(widget),
+			KEYBOARD_CLASS_SELECTOR);
 #else
 	gtk_widget_modify_fg(label, GTK_STATE_NORMAL, &black);
-#endif
 	gtk_widget_override_font(label, keyboard->font);
-	widget = gtk_button_new();
-#if GTK_CHECK_VERSION(3, 0, 0)
-	gtk_widget_override_background_color(widget, GTK_STATE_FLAG_NORMAL,
-			dark ? &black : &white);
-#else
 	gtk_widget_modify_bg(widget, GTK_STATE_NORMAL, &white);
 #endif
 	gtk_container_add(GTK_CONTAINER(widget), label);
@@ -1212,3 +1513,253 @@ static void _keyboard_error(Keyboard * keyboard, char const * format, ...)
 	fprintf(stderr, "\n");
 	va_end(ap);
 }
+
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+/* keyboard_style */
+static void _keyboard_style(Keyboard * keyboard)
+{
+	PangoFontDescription * font = keyboard->font;
+	PangoFontMask mask;
+	PangoStyle style;
+	gboolean dark = FALSE;
+	char family[128] = "";
+	char size[32] = "";
+	char number[G_ASCII_DTOSTR_BUF_SIZE];
+	char weight[32] = "";
+	char const * italic = "";
+	char const * p;
+	size_t i;
+	char * css;
+
+	g_object_get(gtk_settings_get_default(),
+			"gtk-application-prefer-dark-theme", &dark, NULL);
+	/* the font of the keys, as far as set */
+	mask = pango_font_description_get_set_fields(font);
+	if(mask & PANGO_FONT_MASK_FAMILY)
+	{
+		/* escaped as a CSS string */
+		i = snprintf(family, sizeof(family), " font-family: \"");
+		for(p = pango_font_description_get_family(font); *p != '\0'
+				&& i + 4 < sizeof(family); p++)
+		{
+			if((unsigned char)*p < 0x20)
+				continue;
+			if(*p == '"' || *p == '\\')
+				family[i++] = '\\';
+			family[i++] = *p;
+		}
+		snprintf(&family[i], sizeof(family) - i, "\";");
+	}
+	if(mask & PANGO_FONT_MASK_SIZE)
+		/* with a dot whatever the locale */
+		snprintf(size, sizeof(size), " font-size: %s%s;",
+				g_ascii_formatd(number, sizeof(number), "%g",
+					(double)pango_font_description_get_size(
+						font) / PANGO_SCALE),
+				pango_font_description_get_size_is_absolute(
+					font) ? "px" : "pt");
+	if(mask & PANGO_FONT_MASK_WEIGHT)
+		snprintf(weight, sizeof(weight), " font-weight: %d;",
+				CLAMP((pango_font_description_get_weight(font)
+						+ 50) / 100 * 100, 100, 900));
+	if(mask & PANGO_FONT_MASK_STYLE)
+	{
+		style = pango_font_description_get_style(font);
+		italic = (style == PANGO_STYLE_ITALIC)
+			? " font-style: italic;"
+			: (style == PANGO_STYLE_OBLIQUE)
+			? " font-style: oblique;" : " font-style: normal;";
+	}
+	css = g_strdup_printf(".%s { background-color: #8f8f8f; }\n"
+			".%s, .%s, .%s {%s%s%s%s }\n"
+			".%s { color: %s; background-color: %s;"
+			" background-image: none; }\n",
+			KEYBOARD_CLASS, KEYBOARD_KEY_CLASS,
+			KEYBOARD_KEY_CLASS_MODIFIER, KEYBOARD_CLASS_SELECTOR,
+			family, size, weight, italic, KEYBOARD_CLASS_SELECTOR,
+			dark ? "#ffffff" : "#000000",
+			dark ? "#000000" : "#ffffff");
+	gtk_css_provider_load_from_data(keyboard->css, css, -1, NULL);
+	g_free(css);
+}
+#endif
+
+
+/* keyboard_suggest_show */
+static void _keyboard_suggest_show(Keyboard * keyboard, size_t cnt)
+{
+	size_t i;
+
+	for(i = cnt; i < KEYBOARD_DICTIONARY_TOP; i++)
+		keyboard->suggestions[i][0] = '\0';
+	if(keyboard->su_box == NULL)
+		return;
+	for(i = 0; i < KEYBOARD_DICTIONARY_TOP; i++)
+	{
+		gtk_button_set_label(GTK_BUTTON(keyboard->su_buttons[i]),
+				keyboard->suggestions[i]);
+		gtk_widget_set_sensitive(keyboard->su_buttons[i], i < cnt);
+	}
+}
+
+
+/* keyboard_suggest_update */
+static void _keyboard_suggest_update(Keyboard * keyboard)
+{
+	size_t cnt = 0;
+
+	if(keyboard->dictionary == NULL)
+		return;
+	/* complete the words once started */
+	if(keyboard->word_len > 0)
+		cnt = keyboard_dictionary_complete(keyboard->dictionary,
+				keyboard->cursor, keyboard->suggestions);
+	_keyboard_suggest_show(keyboard, cnt);
+}
+
+
+/* callbacks */
+#if GTK_CHECK_VERSION(3, 0, 0)
+/* keyboard_on_draw */
+static gboolean _keyboard_on_draw(GtkWidget * widget, cairo_t * cr,
+		gpointer data)
+{
+	Keyboard * keyboard = data;
+
+	if(keyboard->shown != 0)
+	{
+		keyboard_stats_record(keyboard->stats, KEYBOARD_STATS_SHOW,
+				g_get_monotonic_time() - keyboard->shown);
+		keyboard->shown = 0;
+	}
+	return FALSE;
+}
+
+
+/* keyboard_on_theme */
+static void _keyboard_on_theme(GObject * settings, GParamSpec * pspec,
+		gpointer data)
+{
+	Keyboard * keyboard = data;
+
+	/* restyled in a single pass */
+	_keyboard_style(keyboard);
+}
+#else
+/* keyboard_on_expose_event */
+static gboolean _keyboard_on_expose_event(GtkWidget * widget,
+		GdkEventExpose * event, gpointer data)
+{
+	Keyboard * keyboard = data;
+
+	if(keyboard->shown != 0)
+	{
+		keyboard_stats_record(keyboard->stats, KEYBOARD_STATS_SHOW,
+				g_get_monotonic_time() - keyboard->shown);
+		keyboard->shown = 0;
+	}
+	return FALSE;
+}
+#endif
+
+
+/* keyboard_on_idle */
+static gboolean _keyboard_on_idle(gpointer data)
+{
+	Keyboard * keyboard = data;
+	size_t i;
+
+	/* build one page at a time, a failure is only retried when shown */
+	while((i = keyboard->source_page++) < KLS_COUNT)
+		if(keyboard->layouts[i] == NULL)
+		{
+			_keyboard_add_layout(keyboard, i);
+			return TRUE;
+		}
+	keyboard->source = 0;
+	return FALSE;
+}
+
+
+/* keyboard_on_repeat */
+static gboolean _keyboard_on_repeat(gpointer data)
+{
+	Keyboard * keyboard = data;
+	KeyCode keycode;
+
+	if((keycode = keyboard_keymap_get_keycode(keyboard->keymap,
+					keyboard_key_get_keysym(
+						keyboard->repeat_key)))
+			!= NoSymbol)
+	{
+		keyboard_backend_press(keyboard->backend, keycode);
+		keyboard_backend_release(keyboard->backend, keycode);
+		keyboard_backend_flush_idle(keyboard->backend);
+		keyboard_suggest(keyboard, keyboard_key_get_keysym(
+					keyboard->repeat_key));
+	}
+	if(keyboard->repeated)
+		return TRUE;
+	/* switch from the delay to the rate */
+	keyboard->repeated = TRUE;
+	keyboard->repeat = g_timeout_add(1000 / keyboard->repeat_rate,
+			_keyboard_on_repeat, keyboard);
+	return FALSE;
+}
+
+
+/* keyboard_on_suggestion */
+static void _suggestion_swiped(Keyboard * keyboard, unsigned long i);
+
+static void _keyboard_on_suggestion(GtkWidget * widget, gpointer data)
+{
+	Keyboard * keyboard = data;
+	unsigned long i;
+	char const * word;
+	char * text;
+
+	i = (unsigned long)g_object_get_data(G_OBJECT(widget), "suggestion");
+	if(keyboard->swiped > 0)
+	{
+		_suggestion_swiped(keyboard, i);
+		return;
+	}
+	word = keyboard->suggestions[i];
+	/* only type the rest of the word, and a space */
+	if(word[0] == '\0' || strlen(word) < keyboard->word_len
+			|| strncmp(word, keyboard->word, keyboard->word_len)
+			!= 0)
+		return;
+	if((text = g_strdup_printf("%s ", &word[keyboard->word_len])) == NULL)
+		return;
+	keyboard_type(keyboard, text);
+	g_free(text);
+}
+
+static void _suggestion_swiped(Keyboard * keyboard, unsigned long i)
+{
+	char words[KEYBOARD_DICTIONARY_TOP][KEYBOARD_DICTIONARY_WORD];
+	size_t swiped = keyboard->swiped;
+	size_t len;
+	size_t cnt;
+	char * text;
+
+	memcpy(words, keyboard->suggestions, sizeof(words));
+	if(words[i][0] == '\0')
+		return;
+	/* erase the word swiped and its space first */
+	len = strlen(words[i]);
+	if((text = malloc(swiped + len + 2)) == NULL)
+		return;
+	memset(text, '\b', swiped);
+	snprintf(&text[swiped], len + 2, "%s ", words[i]);
+	keyboard_type(keyboard, text);
+	free(text);
+	/* the other words may still replace it */
+	keyboard->swiped = g_utf8_strlen(words[i], -1) + 1;
+	memcpy(keyboard->suggestions, words, sizeof(words));
+	for(cnt = 0; cnt < KEYBOARD_DICTIONARY_TOP && words[cnt][0] != '\0';
+			cnt++);
+	_keyboard_suggest_show(keyboard, cnt);
+}
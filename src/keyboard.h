@@ -33,10 +33,20 @@
 
 # include <gtk/gtk.h>
 # include "../include/Keyboard.h"
+# include "backend.h"
+# include "gesture.h"
+# include "glyphs.h"
 # include "key.h"
+# include "keymap.h"
+# include "stats.h"
 
 
 /* Keyboard */
+/* constants */
+# define KEYBOARD_REPEAT_DELAY	500
+# define KEYBOARD_REPEAT_RATE	20
+
+
 /* types */
 typedef struct _Keyboard Keyboard;
 
@@ -52,9 +62,19 @@ typedef enum _KeyboardMode
 typedef struct _KeyboardPrefs
 {
 	int monitor;
+	char const * backend;
+	char const * dictionary;
 	char const * font;
+	int gesture;
+	int idle;
 	char const * layout;
 	KeyboardMode mode;
+	int prewarm;
+	char const * profile;
+	int repeat_delay;
+	int repeat_rate;
+	int surface;
+	int verbose;
 	int wait;
 } KeyboardPrefs;
 
@@ -64,19 +84,39 @@ Keyboard * keyboard_new(KeyboardPrefs * prefs);
 void keyboard_delete(Keyboard * keyboard);
 
 /* accessors */
+KeyboardBackend * keyboard_get_backend(Keyboard * keyboard);
+KeyboardGesture * keyboard_get_gesture(Keyboard * keyboard);
+KeyboardGlyphs * keyboard_get_glyphs(Keyboard * keyboard);
+gdouble keyboard_get_likelihood(Keyboard * keyboard, unsigned int keysym);
+KeyboardKeymap * keyboard_get_keymap(Keyboard * keyboard);
+unsigned int keyboard_get_modifier(Keyboard * keyboard);
+KeyboardStats * keyboard_get_stats(Keyboard * keyboard);
 GtkWidget * keyboard_get_widget(Keyboard * keyboard);
 
 gboolean keyboard_is_visible(Keyboard * keyboard);
 
 /* XXX be more explicit */
 void keyboard_set_layout(Keyboard * keyboard, unsigned int which);
+void keyboard_set_modifier(Keyboard * keyboard, unsigned int modifier);
 void keyboard_set_page(Keyboard * keyboard, KeyboardPage page);
 
 /* useful */
+void keyboard_release_modifiers(Keyboard * keyboard);
+void keyboard_send_stats(Keyboard * keyboard);
+
 void keyboard_show(Keyboard * keyboard, gboolean show);
+void keyboard_suggest(Keyboard * keyboard, unsigned int keysym);
+void keyboard_swipe(Keyboard * keyboard);
 void keyboard_show_about(Keyboard * keyboard);
 
+void keyboard_repeat_start(Keyboard * keyboard, KeyboardKey * key);
+gboolean keyboard_repeat_stop(Keyboard * keyboard);
+
+int keyboard_type(Keyboard * keyboard, char const * text);
+int keyboard_type_chunk(Keyboard * keyboard, char const * buf, size_t len,
+		gboolean last);
+
 void keyboard_key_show(Keyboard * keyboard, KeyboardKey * key, gboolean show,
-		GdkEventButton * event);
+		GdkRectangle * area);
 
 #endif /* !KEYBOARD_KEYBOARD_H */
@@ -28,13 +28,19 @@
 
 
 
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <locale.h>
 #include <libintl.h>
-#include <gtk/gtk.h>
-#include <Desktop.h>
+#ifdef KEYBOARDCTL_DESKTOP
+# include <gtk/gtk.h>
+# include <Desktop.h>
+#endif
 #include "../include/Keyboard.h"
 #include "../config.h"
 #define _(string) gettext(string)
@@ -46,6 +52,9 @@
 #ifndef DATADIR
 # define DATADIR	PREFIX "/share"
 #endif
+#ifndef LIBEXECDIR
+# define LIBEXECDIR	PREFIX "/libexec"
+#endif
 #ifndef LOCALEDIR
 # define LOCALEDIR	DATADIR "/locale"
 #endif
@@ -53,24 +62,350 @@
 #ifndef PROGNAME_KEYBOARDCTL
 # define PROGNAME_KEYBOARDCTL	"keyboardctl"
 #endif
+#ifndef PROGNAME_KEYBOARDCTL_DESKTOP
+# define PROGNAME_KEYBOARDCTL_DESKTOP	"keyboardctl-desktop"
+#endif
 
 
 /* keyboardctl */
 /* private */
+/* types */
+typedef struct _KeyboardctlStats
+{
+	uint32_t values[KEYBOARD_STATS_COUNT][KEYBOARD_STATS_VALUE_COUNT];
+	uint32_t invalidations;
+	int received;
+	unsigned int source;
+} KeyboardctlStats;
+
+
 /* prototypes */
-static int _keyboardctl(KeyboardMessage message, unsigned int arg1);
+static int _keyboardctl(int fd, KeyboardMessage message, uint32_t value1,
+		uint32_t value2);
+#ifndef KEYBOARDCTL_DESKTOP
+static int _keyboardctl_connect(void);
+static int _keyboardctl_fallback(char * argv[]);
+static int _keyboardctl_peer(int fd);
+static int _keyboardctl_request(int fd, KeyboardMessage message,
+		uint32_t value1, uint32_t value2, char const * text,
+		uint32_t * values, size_t count);
+#endif
+static int _keyboardctl_stats(int fd);
+static int _keyboardctl_text(int fd, char const * text);
 
+static uint32_t _batch(uint32_t values, unsigned int shift,
+		uint32_t value);
 static int _error(char const * message, int ret);
+static int _lookup(char const * names[], char const * name);
 static int _usage(void);
 
 
 /* functions */
-static int _keyboardctl(KeyboardMessage message, unsigned int arg1)
+static int _keyboardctl(int fd, KeyboardMessage message, uint32_t value1,
+		uint32_t value2)
+{
+#ifdef KEYBOARDCTL_DESKTOP
+	desktop_message_send(KEYBOARD_CLIENT_MESSAGE, message, value1, value2);
+	return 0;
+#else
+	return _keyboardctl_request(fd, message, value1, value2, NULL, NULL,
+			0);
+#endif
+}
+
+
+#ifndef KEYBOARDCTL_DESKTOP
+/* keyboardctl_connect */
+static int _keyboardctl_connect(void)
+{
+	struct sockaddr_un address;
+	char const * runtime;
+	int res;
+	int fd;
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if((runtime = getenv("XDG_RUNTIME_DIR")) != NULL
+			&& runtime[0] != '\0')
+		res = snprintf(address.sun_path, sizeof(address.sun_path),
+				"%s/%s", runtime, KEYBOARD_CONTROL_SOCKET);
+	else
+		res = snprintf(address.sun_path, sizeof(address.sun_path),
+				KEYBOARD_CONTROL_SOCKET_TMP,
+				(unsigned long)getuid());
+	if(res < 0 || (size_t)res >= sizeof(address.sun_path))
+		return -1;
+	if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return -1;
+	if(connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	/* the socket in /tmp may have been created by anyone */
+	if(_keyboardctl_peer(fd) != 0)
+	{
+		fprintf(stderr, "%s: %s: %s\n", PROGNAME_KEYBOARDCTL,
+				address.sun_path,
+				_("Not served by the current user"));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+
+/* keyboardctl_fallback */
+static int _keyboardctl_fallback(char * argv[])
+{
+	/* through Gtk+ and the X server instead */
+	execv(LIBEXECDIR "/" PROGNAME_KEYBOARDCTL_DESKTOP, argv);
+	return _error(LIBEXECDIR "/" PROGNAME_KEYBOARDCTL_DESKTOP, 2);
+}
+
+
+/* keyboardctl_peer */
+static int _keyboardctl_peer(int fd)
+{
+	uid_t uid;
+# ifdef __linux__
+	/* as struct ucred, only declared along _GNU_SOURCE */
+	struct
+	{
+		pid_t pid;
+		uid_t uid;
+		gid_t gid;
+	} cred;
+	socklen_t len = sizeof(cred);
+
+	if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+		return -1;
+	uid = cred.uid;
+# else
+	gid_t gid;
+
+	if(getpeereid(fd, &uid, &gid) != 0)
+		return -1;
+# endif
+	return (uid == getuid()) ? 0 : -1;
+}
+
+
+/* keyboardctl_request */
+static int _request_read(int fd, void * buf, size_t size);
+static int _request_write(int fd, void const * buf, size_t size);
+
+static int _keyboardctl_request(int fd, KeyboardMessage message,
+		uint32_t value1, uint32_t value2, char const * text,
+		uint32_t * values, size_t count)
+{
+	KeyboardControlRequest request;
+	KeyboardControlReply reply;
+	uint32_t value;
+	size_t i;
+
+	request.message = message;
+	request.value1 = value1;
+	request.value2 = value2;
+	/* the text follows the request, as long as its first value */
+	if(_request_write(fd, &request, sizeof(request)) != 0
+			|| (text != NULL && _request_write(fd, text, value1)
+				!= 0)
+			|| _request_read(fd, &reply, sizeof(reply)) != 0)
+		return -_error("socket", 1);
+	/* the values not expected are skipped */
+	for(i = 0; i < reply.count; i++)
+	{
+		if(_request_read(fd, &value, sizeof(value)) != 0)
+			return -_error("socket", 1);
+		if(i < count)
+			values[i] = value;
+	}
+	if(reply.status != 0 || reply.count < count)
+	{
+		fprintf(stderr, "%s: %s\n", PROGNAME_KEYBOARDCTL,
+				_("The keyboard refused the request"));
+		return -1;
+	}
+	return 0;
+}
+
+static int _request_read(int fd, void * buf, size_t size)
+{
+	char * p = buf;
+	ssize_t res;
+
+	while(size > 0)
+	{
+		if((res = read(fd, p, size)) < 0 && errno == EINTR)
+			continue;
+		if(res <= 0)
+		{
+			if(res == 0)
+				errno = ECONNRESET;
+			return -1;
+		}
+		p += res;
+		size -= res;
+	}
+	return 0;
+}
+
+static int _request_write(int fd, void const * buf, size_t size)
+{
+	char const * p = buf;
+	ssize_t res;
+
+	while(size > 0)
+	{
+		if((res = write(fd, p, size)) < 0 && errno == EINTR)
+			continue;
+		if(res < 0)
+			return -1;
+		p += res;
+		size -= res;
+	}
+	return 0;
+}
+#endif
+
+
+/* keyboardctl_stats */
+#ifdef KEYBOARDCTL_DESKTOP
+static int _stats_on_message(void * data, uint32_t value1, uint32_t value2,
+		uint32_t value3);
+static gboolean _stats_on_timeout(gpointer data);
+#endif
+
+static int _keyboardctl_stats(int fd)
+{
+	char const * stages[KEYBOARD_STATS_COUNT] = { "tap", "inject", "ack",
+		"show" };
+	KeyboardctlStats stats;
+#ifndef KEYBOARDCTL_DESKTOP
+	uint32_t values[KEYBOARD_STATS_COUNT * KEYBOARD_STATS_VALUE_COUNT + 1];
+#endif
+	uint32_t * v;
+	size_t i;
+
+	memset(&stats, 0, sizeof(stats));
+#ifdef KEYBOARDCTL_DESKTOP
+	desktop_message_register(NULL, KEYBOARD_STATS_MESSAGE,
+			_stats_on_message, &stats);
+	desktop_message_send(KEYBOARD_CLIENT_MESSAGE,
+			KEYBOARD_MESSAGE_GET_STATS, 0, 0);
+	stats.source = g_timeout_add(1000, _stats_on_timeout, &stats);
+	gtk_main();
+	if(stats.source != 0)
+		g_source_remove(stats.source);
+#else
+	if(_keyboardctl_request(fd, KEYBOARD_MESSAGE_GET_STATS, 0, 0, NULL,
+				values, sizeof(values) / sizeof(*values)) != 0)
+		return -1;
+	memcpy(stats.values, values, sizeof(stats.values));
+	stats.invalidations = values[sizeof(values) / sizeof(*values) - 1];
+	stats.received = 1;
+#endif
+	if(stats.received == 0)
+	{
+		fprintf(stderr, "%s: %s\n", PROGNAME_KEYBOARDCTL,
+				_("The keyboard did not answer"));
+		return -1;
+	}
+	printf("%-8s%10s%12s%12s%12s\n", _("Stage"), _("Samples"),
+			"p50 (ms)", "p99 (ms)", "max (ms)");
+	for(i = 0; i < KEYBOARD_STATS_COUNT; i++)
+	{
+		v = stats.values[i];
+		printf("%-8s%10u%12.3f%12.3f%12.3f\n", stages[i],
+				v[KEYBOARD_STATS_VALUE_SAMPLES],
+				v[KEYBOARD_STATS_VALUE_P50] / 1000.0,
+				v[KEYBOARD_STATS_VALUE_P99] / 1000.0,
+				v[KEYBOARD_STATS_VALUE_MAX] / 1000.0);
+	}
+	printf("%s: %u\n", _("Keymap reloads"), stats.invalidations);
+	return 0;
+}
+
+#ifdef KEYBOARDCTL_DESKTOP
+static int _stats_on_message(void * data, uint32_t value1, uint32_t value2,
+		uint32_t value3)
 {
-	desktop_message_send(KEYBOARD_CLIENT_MESSAGE, message, arg1, 0);
+	KeyboardctlStats * stats = data;
+
+	if(value1 == KEYBOARD_STATS_KEYMAP)
+	{
+		stats->invalidations = value3;
+		return 0;
+	}
+	if(value1 >= KEYBOARD_STATS_COUNT
+			|| value2 >= KEYBOARD_STATS_VALUE_COUNT)
+		return 0;
+	stats->values[value1][value2] = value3;
+	/* the values are sent in order */
+	if(value1 == KEYBOARD_STATS_LAST && value2 == KEYBOARD_STATS_VALUE_LAST)
+	{
+		stats->received = 1;
+		gtk_main_quit();
+	}
 	return 0;
 }
 
+static gboolean _stats_on_timeout(gpointer data)
+{
+	KeyboardctlStats * stats = data;
+
+	stats->source = 0;
+	gtk_main_quit();
+	return FALSE;
+}
+#endif
+
+
+/* keyboardctl_text */
+static int _keyboardctl_text(int fd, char const * text)
+{
+	size_t len = strlen(text);
+#ifdef KEYBOARDCTL_DESKTOP
+	uint32_t chunk;
+	uint32_t flags;
+	size_t i;
+
+	/* send the text in chunks, flagging the last one */
+	do
+	{
+		for(i = 0, chunk = 0; i < KEYBOARD_TEXT_CHUNK && i < len; i++)
+			chunk |= (uint32_t)(unsigned char)text[i] << (i * 8);
+		text += i;
+		len -= i;
+		flags = (len == 0) ? KEYBOARD_TEXT_LAST : 0;
+		desktop_message_send(KEYBOARD_CLIENT_MESSAGE,
+				KEYBOARD_MESSAGE_TYPE_TEXT, chunk, i | flags);
+	}
+	while(len > 0);
+	return 0;
+#else
+	if(len >= KEYBOARD_TEXT_MAX)
+	{
+		fprintf(stderr, "%s: %s\n", PROGNAME_KEYBOARDCTL,
+				_("Text too long"));
+		return -1;
+	}
+	/* send the whole text at once */
+	return _keyboardctl_request(fd, KEYBOARD_MESSAGE_TYPE_STRING, len, 0,
+			text, NULL, 0);
+#endif
+}
+
+
+/* batch */
+static uint32_t _batch(uint32_t values, unsigned int shift, uint32_t value)
+{
+	/* the last value given wins */
+	return (values & ~((uint32_t)0xff << shift)) | ((value & 0xff)
+			<< shift);
+}
+
 
 /* error */
 static int _error(char const * message, int ret)
@@ -81,12 +416,36 @@ static int _error(char const * message, int ret)
 }
 
 
+/* lookup */
+static int _lookup(char const * names[], char const * name)
+{
+	size_t i;
+
+	for(i = 0; names[i] != NULL; i++)
+		if(strcmp(names[i], name) == 0)
+			return i;
+	fprintf(stderr, "%s: %s: %s\n", PROGNAME_KEYBOARDCTL, name,
+			_("Unknown name"));
+	return -1;
+}
+
+
 /* usage */
 static int _usage(void)
 {
-	fprintf(stderr, _("Usage: %s [-H|-S]\n"
+	fprintf(stderr, _("Usage: %s [-H|-S][-l layout][-p page][-r]\n"
+"       %s -L\n"
+"       %s -t text\n"
 "  -H	Hide the keyboard\n"
-"  -S	Show the keyboard\n"), PROGNAME_KEYBOARDCTL);
+"  -L	Report the latency of the keys\n"
+"  -S	Show the keyboard\n"
+"  -l	Select a layout (letters, keypad or special)\n"
+"  -p	Select a page (default, keypad or url)\n"
+"  -r	Release the modifiers held\n"
+"  -t	Type the text given\n"
+"The changes requested at once are applied together.\n"),
+			PROGNAME_KEYBOARDCTL,
+			PROGNAME_KEYBOARDCTL, PROGNAME_KEYBOARDCTL);
 	return 1;
 }
 
@@ -96,30 +455,82 @@ static int _usage(void)
 /* main */
 int main(int argc, char * argv[])
 {
+	char const * layouts[] = { "letters", "keypad", "special",
+		NULL };
+	char const * pages[] = { "default", "keypad", "url", NULL };
 	int o;
+	int fd;
 	int message = -1;
-	int arg1;
+	uint32_t changes = 0;
+	uint32_t values = 0;
+	int value;
+	char const * text = NULL;
 
 	if(setlocale(LC_ALL, "") == NULL)
 		_error("setlocale", 1);
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
+#ifdef KEYBOARDCTL_DESKTOP
+	fd = -1;
 	gtk_init(&argc, &argv);
-	while((o = getopt(argc, argv, "HS")) != -1)
+#else
+	/* Gtk+ is only loaded without the control socket */
+	if((fd = _keyboardctl_connect()) < 0)
+		return _keyboardctl_fallback(argv);
+#endif
+	while((o = getopt(argc, argv, "HLSl:p:rt:")) != -1)
 		switch(o)
 		{
 			case 'H':
-				message = KEYBOARD_MESSAGE_SET_VISIBLE;
-				arg1 = 0;
-				break;
 			case 'S':
-				message = KEYBOARD_MESSAGE_SET_VISIBLE;
-				arg1 = 1;
+				changes |= KEYBOARD_BATCH_VISIBLE;
+				value = (o == 'S') ? 1 : 0;
+				values = _batch(values,
+						KEYBOARD_BATCH_VISIBLE_SHIFT,
+						value);
+				break;
+			case 'L':
+				message = KEYBOARD_MESSAGE_GET_STATS;
+				break;
+			case 'l':
+				if((value = _lookup(layouts, optarg)) < 0)
+					return _usage();
+				changes |= KEYBOARD_BATCH_LAYOUT;
+				values = _batch(values,
+						KEYBOARD_BATCH_LAYOUT_SHIFT,
+						value);
+				break;
+			case 'p':
+				if((value = _lookup(pages, optarg)) < 0)
+					return _usage();
+				changes |= KEYBOARD_BATCH_PAGE;
+				values = _batch(values,
+						KEYBOARD_BATCH_PAGE_SHIFT,
+						value);
+				break;
+			case 'r':
+				changes |= KEYBOARD_BATCH_MODIFIERS;
+				break;
+			case 't':
+				message = KEYBOARD_MESSAGE_TYPE_TEXT;
+				text = optarg;
 				break;
 			default:
 				return _usage();
 		}
-	if(argc != optind || message < 0)
+	if(argc != optind || (message < 0) == (changes == 0))
 		return _usage();
-	return (_keyboardctl(message, arg1) == 0) ? 0 : 2;
+	if(message == KEYBOARD_MESSAGE_GET_STATS)
+		o = _keyboardctl_stats(fd);
+	else if(message == KEYBOARD_MESSAGE_TYPE_TEXT)
+		o = _keyboardctl_text(fd, text);
+	else if(changes == KEYBOARD_BATCH_VISIBLE)
+		/* understood by every version of the keyboard */
+		o = _keyboardctl(fd, KEYBOARD_MESSAGE_SET_VISIBLE,
+				KEYBOARD_BATCH_VALUE(values, VISIBLE), 0);
+	else
+		o = _keyboardctl(fd, KEYBOARD_MESSAGE_BATCH, changes, values);
+	if(fd >= 0)
+		close(fd);
+	return (o == 0) ? 0 : 2;
 }
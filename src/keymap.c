@@ -0,0 +1,502 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef DEBUG
+# include <stdio.h>
+#endif
+#include <gdk/gdkx.h>
+#include "common.h"
+#include "keymap.h"
+
+
+/* KeyboardKeymap */
+/* private */
+/* constants */
+#define KEYBOARD_KEYMAP_POOL_SIZE	8
+
+
+/* types */
+typedef struct _KeyboardKeycode
+{
+	KeySym keysym;
+	KeyCode keycode;
+	unsigned int level;
+} KeyboardKeycode;
+
+typedef struct _KeyboardKeymapSpare
+{
+	KeyCode keycode;
+	KeySym keysym;
+	unsigned long used;
+} KeyboardKeymapSpare;
+
+struct _KeyboardKeymap
+{
+	Display * display;
+	KeyboardBackend * backend;
+
+	/* as last obtained from the server */
+	KeySym * keysyms;
+	int min;
+	int max;
+	int per;
+
+	/* sorted by keysym */
+	KeyboardKeycode * keycodes;
+	size_t keycodes_cnt;
+
+	/* unused keycodes, temporarily bound to missing keysyms */
+	KeyboardKeymapSpare spares[KEYBOARD_KEYMAP_POOL_SIZE];
+	size_t spares_cnt;
+	unsigned long spares_used;
+	unsigned long spares_flushed;	/* when last flushed */
+
+	unsigned int invalidations;
+	gulong handler;
+};
+
+
+/* prototypes */
+static gboolean _keyboard_keymap_changed(KeyboardKeymap * keymap,
+		KeySym * keysyms, int min, int max, int per);
+static int _keyboard_keymap_compare(void const * a, void const * b);
+static int _keyboard_keymap_compare_keysym(void const * a, void const * b);
+static int _keyboard_keymap_load(KeyboardKeymap * keymap, KeySym * keysyms,
+		int min, int max, int per);
+static KeyboardKeycode * _keyboard_keymap_lookup(KeyboardKeymap * keymap,
+		KeySym keysym);
+
+static KeyCode _keyboard_keymap_spare(KeyboardKeymap * keymap, KeySym keysym);
+static KeyCode _keyboard_keymap_spare_lookup(KeyboardKeymap * keymap,
+		KeySym keysym);
+static void _keyboard_keymap_spares_refresh(KeyboardKeymap * keymap,
+		KeySym * keysyms, int min, int max, int per);
+
+/* callbacks */
+static void _keyboard_keymap_on_keys_changed(gpointer data);
+
+
+/* public */
+/* functions */
+/* keyboard_keymap_new */
+KeyboardKeymap * keyboard_keymap_new(KeyboardBackend * backend)
+{
+	KeyboardKeymap * keymap;
+
+	if((keymap = malloc(sizeof(*keymap))) == NULL)
+		return NULL;
+	keymap->display = gdk_x11_get_default_xdisplay();
+	keymap->backend = backend;
+	keymap->keysyms = NULL;
+	keymap->keycodes = NULL;
+	keymap->keycodes_cnt = 0;
+	keymap->spares_cnt = 0;
+	keymap->spares_used = 0;
+	keymap->spares_flushed = 0;
+	keymap->invalidations = 0;
+	if(keyboard_keymap_refresh(keymap) != 0)
+	{
+		free(keymap);
+		return NULL;
+	}
+	/* emitted upon MappingNotify and XkbNewKeyboardNotify */
+	keymap->handler = g_signal_connect_swapped(gdk_keymap_get_default(),
+			"keys-changed", G_CALLBACK(
+				_keyboard_keymap_on_keys_changed), keymap);
+	return keymap;
+}
+
+
+/* keyboard_keymap_delete */
+void keyboard_keymap_delete(KeyboardKeymap * keymap)
+{
+	KeySym keysyms[2] = { NoSymbol, NoSymbol };
+	size_t i;
+
+	g_signal_handler_disconnect(gdk_keymap_get_default(), keymap->handler);
+	/* restore the spare keycodes */
+	for(i = 0; i < keymap->spares_cnt; i++)
+		if(keymap->spares[i].keysym != NoSymbol)
+			XChangeKeyboardMapping(keymap->display,
+					keymap->spares[i].keycode, 2, keysyms,
+					1);
+	XFlush(keymap->display);
+	if(keymap->keysyms != NULL)
+		XFree(keymap->keysyms);
+	free(keymap->keycodes);
+	free(keymap);
+}
+
+
+/* accessors */
+/* keyboard_keymap_get_invalidations */
+unsigned int keyboard_keymap_get_invalidations(KeyboardKeymap * keymap)
+{
+	return keymap->invalidations;
+}
+
+
+/* keyboard_keymap_get_keycode */
+unsigned int keyboard_keymap_get_keycode(KeyboardKeymap * keymap,
+		unsigned int keysym)
+{
+	KeyboardKeycode * p;
+	KeyCode keycode;
+
+	/* the spare keycodes first, to keep track of their use */
+	if((keycode = _keyboard_keymap_spare_lookup(keymap, keysym))
+			!= NoSymbol)
+		return keycode;
+	if((p = _keyboard_keymap_lookup(keymap, keysym)) == NULL)
+		/* missing from the server keymap */
+		return _keyboard_keymap_spare(keymap, keysym);
+	return p->keycode;
+}
+
+
+/* keyboard_keymap_get_keycode_modifier */
+unsigned int keyboard_keymap_get_keycode_modifier(KeyboardKeymap * keymap,
+		unsigned int keysym, unsigned int * modifier)
+{
+	KeyboardKeycode * p;
+	KeyCode keycode;
+
+	*modifier = KM_NONE;
+	if((keycode = _keyboard_keymap_spare_lookup(keymap, keysym))
+			!= NoSymbol)
+		return keycode;
+	if((p = _keyboard_keymap_lookup(keymap, keysym)) != NULL)
+		switch(p->level)
+		{
+			case 0:
+				return p->keycode;
+			case 1:
+				*modifier = KM_SHIFT;
+				return p->keycode;
+			case 4:
+			case 5:
+				/* the third and fourth levels of the first
+				 * group, reachable with ISO_Level3_Shift */
+				if(_keyboard_keymap_lookup(keymap,
+							XK_ISO_Level3_Shift)
+						== NULL)
+					break;
+				*modifier = (p->level == 4) ? KM_LEVEL3
+					: KM_SHIFT | KM_LEVEL3;
+				return p->keycode;
+		}
+	/* bind the other ones to a spare keycode, without any modifier */
+	return _keyboard_keymap_spare(keymap, keysym);
+}
+
+
+/* useful */
+/* keyboard_keymap_refresh */
+int keyboard_keymap_refresh(KeyboardKeymap * keymap)
+{
+	int min;
+	int max;
+	int per;
+	KeySym * keysyms;
+
+	XDisplayKeycodes(keymap->display, &min, &max);
+	if((keysyms = XGetKeyboardMapping(keymap->display, min, max - min + 1,
+					&per)) == NULL)
+		return -1;
+	return _keyboard_keymap_load(keymap, keysyms, min, max, per);
+}
+
+
+/* private */
+/* functions */
+/* keyboard_keymap_changed */
+static gboolean _keyboard_keymap_changed(KeyboardKeymap * keymap,
+		KeySym * keysyms, int min, int max, int per)
+{
+	size_t i;
+	int j;
+
+	if(keymap->keysyms == NULL || min != keymap->min || max != keymap->max
+			|| per != keymap->per)
+		return TRUE;
+	for(j = 0; j <= max - min; j++)
+	{
+		/* the spare keycodes were bound here, as already known */
+		for(i = 0; i < keymap->spares_cnt; i++)
+			if(keymap->spares[i].keycode == min + j)
+				break;
+		if(i < keymap->spares_cnt)
+		{
+			if(keysyms[j * per] != keymap->spares[i].keysym)
+				return TRUE;
+		}
+		else if(memcmp(&keysyms[j * per], &keymap->keysyms[j * per],
+					sizeof(*keysyms) * per) != 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
+/* keyboard_keymap_compare */
+static int _keyboard_keymap_compare(void const * a, void const * b)
+{
+	KeyboardKeycode const * ka = a;
+	KeyboardKeycode const * kb = b;
+
+	int ret;
+
+	if((ret = _keyboard_keymap_compare_keysym(a, b)) != 0)
+		return ret;
+	if(ka->level != kb->level)
+		return (ka->level < kb->level) ? -1 : 1;
+	return ka->keycode - kb->keycode;
+}
+
+
+/* keyboard_keymap_compare_keysym */
+static int _keyboard_keymap_compare_keysym(void const * a, void const * b)
+{
+	KeyboardKeycode const * ka = a;
+	KeyboardKeycode const * kb = b;
+
+	if(ka->keysym == kb->keysym)
+		return 0;
+	return (ka->keysym < kb->keysym) ? -1 : 1;
+}
+
+
+/* keyboard_keymap_load */
+static int _keyboard_keymap_load(KeyboardKeymap * keymap, KeySym * keysyms,
+		int min, int max, int per)
+{
+	KeyboardKeycode * p;
+	size_t cnt = 0;
+	size_t k;
+	int i;
+	int j;
+
+	_keyboard_keymap_spares_refresh(keymap, keysyms, min, max, per);
+	if((p = realloc(keymap->keycodes, sizeof(*p) * (max - min + 1) * per))
+			== NULL)
+	{
+		XFree(keysyms);
+		return -1;
+	}
+	keymap->keycodes = p;
+	/* lower levels first, like XKeysymToKeycode() */
+	for(j = 0; j < per; j++)
+		for(i = 0; i <= max - min; i++)
+		{
+			if(keysyms[i * per + j] == NoSymbol)
+				continue;
+			/* the spare keycodes are looked up separately */
+			for(k = 0; k < keymap->spares_cnt; k++)
+				if(keymap->spares[k].keycode == min + i)
+					break;
+			if(k < keymap->spares_cnt)
+				continue;
+			p[cnt].keysym = keysyms[i * per + j];
+			p[cnt].keycode = min + i;
+			p[cnt++].level = j;
+		}
+	/* kept to tell the changes apart */
+	if(keymap->keysyms != NULL)
+		XFree(keymap->keysyms);
+	keymap->keysyms = keysyms;
+	keymap->min = min;
+	keymap->max = max;
+	keymap->per = per;
+	qsort(p, cnt, sizeof(*p), _keyboard_keymap_compare);
+	/* only keep the preferred keycode for every keysym */
+	keymap->keycodes_cnt = 0;
+	for(k = 0; k < cnt; k++)
+		if(keymap->keycodes_cnt == 0
+				|| p[keymap->keycodes_cnt - 1].keysym
+				!= p[k].keysym)
+			p[keymap->keycodes_cnt++] = p[k];
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s() %lu keysyms (%u invalidations)\n",
+			__func__, (unsigned long)keymap->keycodes_cnt,
+			keymap->invalidations);
+#endif
+	return 0;
+}
+
+
+/* keyboard_keymap_lookup */
+static KeyboardKeycode * _keyboard_keymap_lookup(KeyboardKeymap * keymap,
+		KeySym keysym)
+{
+	KeyboardKeycode k;
+
+	k.keysym = keysym;
+	return bsearch(&k, keymap->keycodes, keymap->keycodes_cnt, sizeof(k),
+			_keyboard_keymap_compare_keysym);
+}
+
+
+/* keyboard_keymap_spare */
+static KeyCode _keyboard_keymap_spare(KeyboardKeymap * keymap, KeySym keysym)
+{
+	KeyboardKeymapSpare * spare = NULL;
+	KeySym keysyms[2];
+	KeyCode keycode;
+	size_t i;
+	size_t j;
+
+	if(keysym == NoSymbol)
+		return NoSymbol;
+	if((keycode = _keyboard_keymap_spare_lookup(keymap, keysym))
+			!= NoSymbol)
+		/* already bound */
+		return keycode;
+	for(i = 0; i < keymap->spares_cnt; i++)
+		if(spare == NULL || spare->used > keymap->spares[i].used)
+			/* least recently used */
+			spare = &keymap->spares[i];
+	if(spare == NULL)
+		return NoSymbol;
+	/* the events queued with this keycode must be sent before */
+	if(spare->used > keymap->spares_flushed)
+	{
+		keyboard_backend_flush(keymap->backend);
+		keymap->spares_flushed = keymap->spares_used;
+	}
+	/* the keysym evicted must not be typed with this keycode anymore */
+	for(i = 0, j = 0; i < keymap->keycodes_cnt; i++)
+		if(keymap->keycodes[i].keycode != spare->keycode)
+			keymap->keycodes[j++] = keymap->keycodes[i];
+	keymap->keycodes_cnt = j;
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s() binding keysym 0x%lx to keycode %u\n",
+			__func__, keysym, spare->keycode);
+#endif
+	/* bind it for every level */
+	keysyms[0] = keysym;
+	keysyms[1] = keysym;
+	XChangeKeyboardMapping(keymap->display, spare->keycode, 2, keysyms, 1);
+	/* the server must know the binding before the first injection */
+	XSync(keymap->display, False);
+	spare->keysym = keysym;
+	spare->used = ++keymap->spares_used;
+	return spare->keycode;
+}
+
+
+/* keyboard_keymap_spare_lookup */
+static KeyCode _keyboard_keymap_spare_lookup(KeyboardKeymap * keymap,
+		KeySym keysym)
+{
+	size_t i;
+
+	if(keysym == NoSymbol)
+		return NoSymbol;
+	for(i = 0; i < keymap->spares_cnt; i++)
+		if(keymap->spares[i].keysym == keysym)
+		{
+			keymap->spares[i].used = ++keymap->spares_used;
+			return keymap->spares[i].keycode;
+		}
+	return NoSymbol;
+}
+
+
+/* keyboard_keymap_spares_refresh */
+static void _keyboard_keymap_spares_refresh(KeyboardKeymap * keymap,
+		KeySym * keysyms, int min, int max, int per)
+{
+	KeyboardKeymapSpare * spare;
+	size_t i;
+	int j;
+	int k;
+
+	/* forget the spare keycodes re-assigned by someone else */
+	for(i = 0; i < keymap->spares_cnt;)
+	{
+		spare = &keymap->spares[i];
+		j = (spare->keycode - min) * per;
+		if(spare->keycode >= min && spare->keycode <= max
+				&& (keysyms[j] == NoSymbol
+					|| keysyms[j] == spare->keysym))
+		{
+			i++;
+			continue;
+		}
+		*spare = keymap->spares[--keymap->spares_cnt];
+	}
+	/* look for additional unused keycodes */
+	for(j = max - min; j >= 0
+			&& keymap->spares_cnt < KEYBOARD_KEYMAP_POOL_SIZE; j--)
+	{
+		for(k = 0; k < per; k++)
+			if(keysyms[j * per + k] != NoSymbol)
+				break;
+		if(k < per)
+			continue;
+		for(i = 0; i < keymap->spares_cnt; i++)
+			if(keymap->spares[i].keycode == min + j)
+				break;
+		if(i < keymap->spares_cnt)
+			continue;
+		spare = &keymap->spares[keymap->spares_cnt++];
+		spare->keycode = min + j;
+		spare->keysym = NoSymbol;
+		spare->used = 0;
+	}
+}
+
+
+/* callbacks */
+/* keyboard_keymap_on_keys_changed */
+static void _keyboard_keymap_on_keys_changed(gpointer data)
+{
+	KeyboardKeymap * keymap = data;
+	int min;
+	int max;
+	int per;
+	KeySym * keysyms;
+
+	XDisplayKeycodes(keymap->display, &min, &max);
+	if((keysyms = XGetKeyboardMapping(keymap->display, min, max - min + 1,
+					&per)) == NULL)
+		return;
+	/* also notified for the spare keycodes bound here */
+	if(_keyboard_keymap_changed(keymap, keysyms, min, max, per) == FALSE)
+	{
+		XFree(keysyms);
+		return;
+	}
+	keymap->invalidations++;
+	_keyboard_keymap_load(keymap, keysyms, min, max, per);
+}
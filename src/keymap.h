@@ -0,0 +1,56 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+
+#ifndef KEYBOARD_KEYMAP_H
+# define KEYBOARD_KEYMAP_H
+
+# include "backend.h"
+
+/* KeyboardKeymap */
+/* types */
+typedef struct _KeyboardKeymap KeyboardKeymap;
+
+
+/* functions */
+KeyboardKeymap * keyboard_keymap_new(KeyboardBackend * backend);
+void keyboard_keymap_delete(KeyboardKeymap * keymap);
+
+/* accessors */
+unsigned int keyboard_keymap_get_invalidations(KeyboardKeymap * keymap);
+unsigned int keyboard_keymap_get_keycode(KeyboardKeymap * keymap,
+		unsigned int keysym);
+unsigned int keyboard_keymap_get_keycode_modifier(KeyboardKeymap * keymap,
+		unsigned int keysym, unsigned int * modifier);
+
+/* useful */
+int keyboard_keymap_refresh(KeyboardKeymap * keymap);
+
+#endif /* !KEYBOARD_KEYMAP_H */
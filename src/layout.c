@@ -29,13 +29,14 @@
 
 
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #ifdef DEBUG
 # include <stdio.h>
 #endif
 #define XK_LATIN1
 #define XK_MISCELLANY
 #include <X11/keysymdef.h>
-#include <X11/extensions/XTest.h>
 #include <gdk/gdkx.h>
 #include "common.h"
 #include "layout.h"
@@ -43,13 +44,74 @@
 
 /* KeyboardLayout */
 /* private */
+/* constants */
+#define KEYBOARD_LAYOUT_COLUMN_WIDTH	16
+#define KEYBOARD_LAYOUT_ROW_HEIGHT	32
+
+/* hit-testing: a touch only goes to a likelier neighbour within MARGIN of
+ * the edges of its key; at 0.35 key from the centre, the spread favours the
+ * key by (0.65^2 - 0.35^2) / (2 * SPREAD^2) = 1.7, and the language model
+ * gives a neighbour at most log((1 + PRIOR) / PRIOR) = 2.4 back */
+#define KEYBOARD_LAYOUT_SPREAD		0.3	/* of the touches, in keys */
+#define KEYBOARD_LAYOUT_PRIOR		0.1	/* for the unexpected letters */
+#define KEYBOARD_LAYOUT_MARGIN		0.15	/* of the keys, on each side */
+
+/* latency */
+#define KEYBOARD_LAYOUT_ACK_SAMPLE	16	/* one injection out of */
+
+
 /* types */
 typedef struct _KeyboardKeyRow KeyboardKeyRow;
+typedef struct _KeyboardLayoutModifier KeyboardLayoutModifier;
+
+typedef struct _KeyboardLayoutKey
+{
+	KeyboardKey * key;
+	unsigned int row;
+	unsigned int column;
+	unsigned int width;
+
+	/* actions */
+	char * label;
+	KeyboardLayoutCallback callback;
+	void * data;
+} KeyboardLayoutKey;
+
+struct _KeyboardLayoutModifier
+{
+	gboolean indexed;
+	/* the keys with a variant for this combination of modifiers */
+	KeyboardLayoutKey ** keys;
+	size_t keys_cnt;
+};
 
 struct _KeyboardLayout
 {
 	KeyboardKeyRow * rows;
 	size_t rows_cnt;
+	unsigned int columns;
+
+	Keyboard * keyboard;
+	KeyboardKeymap * keymap;
+
+	/* modifiers */
+	unsigned int modifier;
+	KeyboardLayoutModifier modifiers[KM_COUNT];
+
+	/* hit-testing, the key at every row and column */
+	KeyboardLayoutKey ** grid;
+
+	/* rendering */
+	gboolean surface;
+	PangoFontDescription * font;
+	KeyboardLayoutKey * pressed;
+	gboolean repeated;
+	KeyboardGesture * gesture;		/* while followed */
+
+	/* latency */
+	guint ack;
+	gint64 ack_time;
+	unsigned int ack_count;
 
 	/* widgets */
 	GtkWidget * widget;
@@ -57,20 +119,68 @@ struct _KeyboardLayout
 
 struct _KeyboardKeyRow
 {
-	KeyboardKey ** keys;
+	KeyboardLayoutKey * keys;
 	size_t keys_cnt;
 	unsigned int width;
 };
 
 
 /* prototypes */
+static KeyboardKeyRow * _keyboard_layout_row(KeyboardLayout * layout,
+		unsigned int row);
+static KeyboardLayoutKey * _keyboard_layout_append(KeyboardLayout * layout,
+		unsigned int row, unsigned int column, unsigned int width);
+static void _keyboard_layout_activate(KeyboardLayout * layout,
+		KeyboardKey * key);
+static void _keyboard_layout_apply(KeyboardLayout * layout,
+		KeyboardLayoutKey * key, unsigned int modifier);
+static KeyboardLayoutModifier * _keyboard_layout_modifier(
+		KeyboardLayout * layout, unsigned int modifier);
+static void _keyboard_layout_modifiers_reset(KeyboardLayout * layout);
+static gint64 _keyboard_layout_event_time(GdkEventButton * event);
+
+/* surface */
+static void _keyboard_layout_draw(KeyboardLayout * layout, cairo_t * cr,
+		GdkRectangle * clip);
+static void _keyboard_layout_draw_key(KeyboardLayout * layout, cairo_t * cr,
+		KeyboardGlyphs * glyphs, KeyboardLayoutKey * key,
+		GdkRectangle * area);
+static void _keyboard_layout_gesture(KeyboardLayout * layout,
+		GdkEventButton * event, GdkRectangle * area);
+static int _keyboard_layout_index(KeyboardLayout * layout);
+static KeyboardLayoutKey * _keyboard_layout_lookup(KeyboardLayout * layout,
+		gdouble x, gdouble y);
+static void _keyboard_layout_rectangle(KeyboardLayout * layout,
+		KeyboardLayoutKey * key, GdkRectangle * area);
+
 /* callbacks */
+static gboolean _on_key_button_press(GtkWidget * widget,
+		GdkEventButton * event, gpointer data);
+static gboolean _on_key_button_release(GtkWidget * widget,
+		GdkEventButton * event, gpointer data);
 static void _on_key_clicked(GtkWidget * widget, gpointer data);
 
+static gboolean _on_layout_ack(gpointer data);
+
+static gboolean _on_layout_button_press(GtkWidget * widget,
+		GdkEventButton * event, gpointer data);
+static gboolean _on_layout_button_release(GtkWidget * widget,
+		GdkEventButton * event, gpointer data);
+static gboolean _on_layout_motion_notify(GtkWidget * widget,
+		GdkEventMotion * event, gpointer data);
+#if GTK_CHECK_VERSION(3, 0, 0)
+static gboolean _on_layout_draw(GtkWidget * widget, cairo_t * cr,
+		gpointer data);
+#else
+static gboolean _on_layout_expose_event(GtkWidget * widget,
+		GdkEventExpose * event, gpointer data);
+#endif
+
 
 /* public */
 /* functions */
-KeyboardLayout * keyboard_layout_new(void)
+KeyboardLayout * keyboard_layout_new(Keyboard * keyboard,
+		KeyboardKeymap * keymap, gboolean surface)
 {
 	KeyboardLayout * layout;
 
@@ -78,6 +188,42 @@ KeyboardLayout * keyboard_layout_new(void)
 		return NULL;
 	layout->rows = NULL;
 	layout->rows_cnt = 0;
+	layout->columns = 0;
+	layout->keyboard = keyboard;
+	layout->keymap = keymap;
+	layout->modifier = 0;
+	memset(layout->modifiers, 0, sizeof(layout->modifiers));
+	layout->grid = NULL;
+	layout->surface = surface;
+	layout->font = NULL;
+	layout->pressed = NULL;
+	layout->repeated = FALSE;
+	layout->gesture = NULL;
+	layout->ack = 0;
+	layout->ack_time = 0;
+	layout->ack_count = 0;
+	if(surface)
+	{
+		/* the keys are all drawn on a single surface */
+		layout->widget = gtk_drawing_area_new();
+		gtk_widget_add_events(layout->widget, GDK_BUTTON_PRESS_MASK
+				| GDK_BUTTON_RELEASE_MASK
+				| GDK_BUTTON1_MOTION_MASK);
+		g_signal_connect(layout->widget, "button-press-event",
+				G_CALLBACK(_on_layout_button_press), layout);
+		g_signal_connect(layout->widget, "button-release-event",
+				G_CALLBACK(_on_layout_button_release), layout);
+		g_signal_connect(layout->widget, "motion-notify-event",
+				G_CALLBACK(_on_layout_motion_notify), layout);
+#if GTK_CHECK_VERSION(3, 0, 0)
+		g_signal_connect(layout->widget, "draw", G_CALLBACK(
+					_on_layout_draw), layout);
+#else
+		g_signal_connect(layout->widget, "expose-event", G_CALLBACK(
+					_on_layout_expose_event), layout);
+#endif
+		return layout;
+	}
 #ifdef DEBUG
 	fprintf(stderr, "DEBUG: %s() gtk_table_new(%u, %u)\n", __func__, 1, 1);
 #endif
@@ -86,6 +232,31 @@ KeyboardLayout * keyboard_layout_new(void)
 }
 
 
+/* keyboard_layout_delete */
+void keyboard_layout_delete(KeyboardLayout * layout)
+{
+	size_t i;
+	size_t j;
+
+	if(layout->ack != 0)
+		g_source_remove(layout->ack);
+	for(i = 0; i < layout->rows_cnt; i++)
+	{
+		for(j = 0; j < layout->rows[i].keys_cnt; j++)
+			if(layout->rows[i].keys[j].key != NULL)
+				keyboard_key_delete(layout->rows[i].keys[j].key);
+			else
+				free(layout->rows[i].keys[j].label);
+		free(layout->rows[i].keys);
+	}
+	free(layout->rows);
+	_keyboard_layout_modifiers_reset(layout);
+	free(layout->grid);
+	free(layout);
+}
+
+
+/* accessors */
 /* keyboard_layout_get_widget */
 GtkWidget * keyboard_layout_get_widget(KeyboardLayout * layout)
 {
@@ -93,64 +264,111 @@ GtkWidget * keyboard_layout_get_widget(KeyboardLayout * layout)
 }
 
 
+/* keyboard_layout_set_font */
+void keyboard_layout_set_font(KeyboardLayout * layout,
+		PangoFontDescription * font)
+{
+	layout->font = font;
+	if(layout->surface)
+		gtk_widget_queue_draw(layout->widget);
+}
+
+
 /* useful */
 /* keyboard_layout_add */
 KeyboardKey * keyboard_layout_add(KeyboardLayout * layout, unsigned int row,
 		unsigned int width, unsigned int keysym, char const * label)
 {
 	KeyboardKey * ret = NULL;
-	KeyboardKeyRow * p = &layout->rows[row];
-	KeyboardKey ** q;
+	KeyboardKeyRow * r;
+	KeyboardLayoutKey * p;
+	unsigned int column;
 	GtkAttachOptions options = GTK_EXPAND | GTK_SHRINK | GTK_FILL;
 	GtkWidget * widget;
 
-	if(row >= layout->rows_cnt)
+	if((r = _keyboard_layout_row(layout, row)) == NULL)
+		return NULL;
+	column = r->width;
+	if(keysym == 0 || label == NULL)
 	{
-		if((p = realloc(layout->rows, sizeof(*p) * (row + 1))) == NULL)
-			return NULL;
-		layout->rows = p;
-		for(; layout->rows_cnt <= row; layout->rows_cnt++)
-		{
-			layout->rows[layout->rows_cnt].keys = NULL;
-			layout->rows[layout->rows_cnt].keys_cnt = 0;
-			layout->rows[layout->rows_cnt].width = 0;
-		}
-		p = &layout->rows[row];
+		/* blank space */
+		r->width += width;
+		if(r->width > layout->columns)
+			layout->columns = r->width;
+		return NULL;
 	}
-	if((q = realloc(p->keys, sizeof(*q) * (p->keys_cnt + 1))) == NULL)
+	if(width == 0)
+		width = 1;
+	if((ret = keyboard_key_new(keysym, label, !layout->surface)) == NULL)
 		return NULL;
-	p->keys = q;
-	q = &p->keys[p->keys_cnt];
-	if(keysym != 0 && label != NULL)
+	if((p = _keyboard_layout_append(layout, row, column, width)) == NULL)
 	{
-		if((ret = keyboard_key_new(keysym, label)) == NULL)
-			return NULL;
-		widget = keyboard_key_get_widget(ret);
-		g_object_set_data(G_OBJECT(widget), "key", ret);
-		g_signal_connect(G_OBJECT(widget), "clicked", G_CALLBACK(
-					_on_key_clicked), layout);
-		if(width == 0)
-			width = 1;
+		keyboard_key_delete(ret);
+		return NULL;
+	}
+	p->key = ret;
+	if(layout->surface)
+	{
+		gtk_widget_set_size_request(layout->widget,
+				layout->columns * KEYBOARD_LAYOUT_COLUMN_WIDTH,
+				layout->rows_cnt * KEYBOARD_LAYOUT_ROW_HEIGHT);
+		return ret;
+	}
+	widget = keyboard_key_get_widget(ret);
+	g_object_set_data(G_OBJECT(widget), "key", ret);
+	g_signal_connect(G_OBJECT(widget), "button-press-event", G_CALLBACK(
+				_on_key_button_press), layout);
+	g_signal_connect(G_OBJECT(widget), "button-release-event", G_CALLBACK(
+				_on_key_button_release), layout);
+	g_signal_connect(G_OBJECT(widget), "clicked", G_CALLBACK(
+				_on_key_clicked), layout);
 #ifdef DEBUG
-		fprintf(stderr, "DEBUG: %s() gtk_table_resize(%u, %u)\n",
-				__func__, (unsigned)layout->rows_cnt,
-				(unsigned)p->width + width);
-		fprintf(stderr, "DEBUG: %s() %s(%u, %u, %u, %u)\n", __func__,
-				"gtk_table_attach", p->width, p->width + width,
-				row, row + 1);
+	fprintf(stderr, "DEBUG: %s() gtk_table_resize(%u, %u)\n", __func__,
+			(unsigned)layout->rows_cnt, column + width);
+	fprintf(stderr, "DEBUG: %s() %s(%u, %u, %u, %u)\n", __func__,
+			"gtk_table_attach", column, column + width, row,
+			row + 1);
 #endif
-		gtk_table_resize(GTK_TABLE(layout->widget),
-				layout->rows_cnt, p->width + width);
-		gtk_table_attach(GTK_TABLE(layout->widget), widget, p->width,
-				p->width + width, row, row + 1, options,
-				options, 2, 2);
-		p->keys[p->keys_cnt++] = ret;
-	}
-	p->width += width;
+	gtk_table_resize(GTK_TABLE(layout->widget), layout->rows_cnt,
+			column + width);
+	gtk_table_attach(GTK_TABLE(layout->widget), widget, column,
+			column + width, row, row + 1, options, options, 2, 2);
 	return ret;
 }
 
 
+/* keyboard_layout_add_action */
+int keyboard_layout_add_action(KeyboardLayout * layout, unsigned int row,
+		unsigned int column, unsigned int width, char const * label,
+		KeyboardLayoutCallback callback, void * data)
+{
+	KeyboardLayoutKey * p;
+	GtkWidget * widget;
+
+	if(!layout->surface)
+	{
+		widget = gtk_button_new_with_label(label);
+		g_signal_connect_swapped(widget, "clicked", G_CALLBACK(
+					callback), data);
+		keyboard_layout_add_widget(layout, row, column, column + width,
+				widget);
+		return 0;
+	}
+	if((p = _keyboard_layout_append(layout, row, column, 0)) == NULL)
+		return -1;
+	/* overlaps the keys already defined */
+	p->width = width;
+	if((p->label = strdup(label)) == NULL)
+	{
+		layout->rows[row].keys_cnt--;
+		return -1;
+	}
+	p->callback = callback;
+	p->data = data;
+	return 0;
+}
+
+
 /* keyboard_layout_add_widget */
 void keyboard_layout_add_widget(KeyboardLayout * layout, unsigned int row,
 		unsigned int column, unsigned int width, GtkWidget * widget)
@@ -166,52 +384,754 @@ void keyboard_layout_add_widget(KeyboardLayout * layout, unsigned int row,
 void keyboard_layout_apply_modifier(KeyboardLayout * layout,
 		unsigned int modifier)
 {
+	KeyboardLayoutModifier * from = NULL;
+	KeyboardLayoutModifier * to = NULL;
 	size_t i;
 	size_t j;
 
+	modifier %= KM_COUNT;
+	if(modifier == layout->modifier)
+		return;
+	if((layout->modifier != KM_NONE && (from = _keyboard_layout_modifier(
+						layout, layout->modifier))
+				== NULL)
+			|| (modifier != KM_NONE && (to = _keyboard_layout_modifier(
+						layout, modifier)) == NULL))
+	{
+		/* fallback to every key of the layout */
+		for(i = 0; i < layout->rows_cnt; i++)
+			for(j = 0; j < layout->rows[i].keys_cnt; j++)
+				_keyboard_layout_apply(layout,
+						&layout->rows[i].keys[j],
+						modifier);
+		layout->modifier = modifier;
+		return;
+	}
+	/* only the keys with a variant for either state may change */
+	if(from != NULL)
+		for(i = 0; i < from->keys_cnt; i++)
+			_keyboard_layout_apply(layout, from->keys[i], modifier);
+	if(to != NULL)
+		for(i = 0; i < to->keys_cnt; i++)
+			_keyboard_layout_apply(layout, to->keys[i], modifier);
+	layout->modifier = modifier;
+}
+
+
+/* keyboard_layout_draw */
+void keyboard_layout_draw(KeyboardLayout * layout, cairo_t * cr)
+{
+	if(layout->surface)
+		_keyboard_layout_draw(layout, cr, NULL);
+}
+
+
+/* keyboard_layout_release_modifiers */
+void keyboard_layout_release_modifiers(KeyboardLayout * layout)
+{
+	KeyboardBackend * backend;
+	KeyboardLayoutKey * key;
+	GtkWidget * widget;
+	GdkRectangle area;
+	KeySym keysym;
+	KeyCode keycode;
+	size_t i;
+	size_t j;
+
+	backend = keyboard_get_backend(layout->keyboard);
 	for(i = 0; i < layout->rows_cnt; i++)
 		for(j = 0; j < layout->rows[i].keys_cnt; j++)
-			keyboard_key_apply_modifier(layout->rows[i].keys[j],
-					modifier);
+		{
+			key = &layout->rows[i].keys[j];
+			if(key->key == NULL)
+				continue;
+			keysym = keyboard_key_get_keysym(key->key);
+			/* the locks are left to the server */
+			if(!keysym_is_modifier(keysym) || keysym == XK_Num_Lock
+					|| !keyboard_key_get_active(key->key))
+				continue;
+			/* without activating the key again */
+			if((widget = keyboard_key_get_widget(key->key)) != NULL)
+				g_signal_handlers_block_by_func(widget,
+						_on_key_clicked, layout);
+			keyboard_key_set_active(key->key, FALSE);
+			if(widget != NULL)
+				g_signal_handlers_unblock_by_func(widget,
+						_on_key_clicked, layout);
+			else if(layout->surface)
+			{
+				_keyboard_layout_rectangle(layout, key, &area);
+				gtk_widget_queue_draw_area(layout->widget,
+						area.x, area.y, area.width,
+						area.height);
+			}
+			if((keycode = keyboard_keymap_get_keycode(
+							layout->keymap, keysym))
+					!= NoSymbol)
+				keyboard_backend_release(backend, keycode);
+		}
 }
 
 
 /* private */
 /* functions */
-/* on_key_clicked */
-static void _on_key_clicked(GtkWidget * widget, gpointer data)
+/* keyboard_layout_row */
+static KeyboardKeyRow * _keyboard_layout_row(KeyboardLayout * layout,
+		unsigned int row)
 {
-	KeyboardLayout * layout = data;
-	KeyboardKey * key;
-	Display * display;
+	KeyboardKeyRow * p;
+
+	if(row >= layout->rows_cnt)
+	{
+		if((p = realloc(layout->rows, sizeof(*p) * (row + 1))) == NULL)
+			return NULL;
+		layout->rows = p;
+		for(; layout->rows_cnt <= row; layout->rows_cnt++)
+		{
+			layout->rows[layout->rows_cnt].keys = NULL;
+			layout->rows[layout->rows_cnt].keys_cnt = 0;
+			layout->rows[layout->rows_cnt].width = 0;
+		}
+	}
+	return &layout->rows[row];
+}
+
+
+/* keyboard_layout_append */
+static KeyboardLayoutKey * _keyboard_layout_append(KeyboardLayout * layout,
+		unsigned int row, unsigned int column, unsigned int width)
+{
+	KeyboardKeyRow * p;
+	KeyboardLayoutKey * q;
+
+	if((p = _keyboard_layout_row(layout, row)) == NULL)
+		return NULL;
+	if((q = realloc(p->keys, sizeof(*q) * (p->keys_cnt + 1))) == NULL)
+		return NULL;
+	p->keys = q;
+	/* the indexes may point to the previous keys */
+	_keyboard_layout_modifiers_reset(layout);
+	free(layout->grid);
+	layout->grid = NULL;
+	q = &p->keys[p->keys_cnt++];
+	q->key = NULL;
+	q->row = row;
+	q->column = column;
+	q->width = width;
+	q->label = NULL;
+	q->callback = NULL;
+	q->data = NULL;
+	if(column + width > p->width)
+		p->width = column + width;
+	if(p->width > layout->columns)
+		layout->columns = p->width;
+	return q;
+}
+
+
+/* keyboard_layout_activate */
+static void _activate_stats(KeyboardLayout * layout, KeyboardKey * key,
+		gint64 start);
+
+static void _keyboard_layout_activate(KeyboardLayout * layout,
+		KeyboardKey * key)
+{
+	KeyboardBackend * backend;
 	KeySym keysym;
 	KeyCode keycode;
 	gboolean active;
+	unsigned int modifier;
+	gint64 start;
 
-	key = g_object_get_data(G_OBJECT(widget), "key");
+	start = g_get_monotonic_time();
 	keysym = keyboard_key_get_keysym(key);
-	display = gdk_x11_get_default_xdisplay();
-	if((keycode = XKeysymToKeycode(display, keysym)) == NoSymbol)
+	if((keycode = keyboard_keymap_get_keycode(layout->keymap, keysym))
+			== NoSymbol)
 		return;
-	XTestGrabControl(display, True);
+	backend = keyboard_get_backend(layout->keyboard);
 	if(keysym_is_modifier(keysym) != 0)
 	{
-		active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(
-					widget));
-		if(keysym != XK_Num_Lock) /* XXX ugly workaround */
-			XTestFakeKeyEvent(display, keycode, active ? True
-					: False, 0);
+		active = keyboard_key_get_active(key);
+		if(keysym == XK_Num_Lock) /* XXX ugly workaround */
+		{
+			keyboard_backend_press(backend, keycode);
+			keyboard_backend_release(backend, keycode);
+		}
+		else if(active)
+			keyboard_backend_press(backend, keycode);
+		else
+			keyboard_backend_release(backend, keycode);
+		modifier = keyboard_get_modifier(layout->keyboard);
+		if(active)
+			modifier |= keysym_get_modifier(keysym);
 		else
+			modifier &= ~keysym_get_modifier(keysym);
+		keyboard_set_modifier(layout->keyboard, modifier);
+	}
+	else
+	{
+		keyboard_backend_press(backend, keycode);
+		keyboard_backend_release(backend, keycode);
+		keyboard_suggest(layout->keyboard, keysym);
+	}
+	keyboard_backend_flush_idle(backend);
+	_activate_stats(layout, key, start);
+}
+
+static void _activate_stats(KeyboardLayout * layout, KeyboardKey * key,
+		gint64 start)
+{
+	KeyboardStats * stats;
+	gint64 now;
+	gint64 pressed;
+
+	stats = keyboard_get_stats(layout->keyboard);
+	now = g_get_monotonic_time();
+	if((pressed = keyboard_key_get_pressed(key)) != 0)
+		keyboard_stats_record(stats, KEYBOARD_STATS_TAP, now - pressed);
+	keyboard_key_set_pressed(key, 0);
+	keyboard_stats_record(stats, KEYBOARD_STATS_INJECT, now - start);
+	/* wait for the server once idle, for one injection at a time and
+	 * only once in a while, as this blocks */
+	if(layout->ack != 0 || layout->ack_count++ % KEYBOARD_LAYOUT_ACK_SAMPLE
+			!= 0 || (keyboard_backend_get_capabilities(
+					keyboard_get_backend(layout->keyboard))
+				& KBC_SERVER) == 0)
+		return;
+	layout->ack_time = now;
+	layout->ack = g_idle_add_full(G_PRIORITY_HIGH_IDLE, _on_layout_ack,
+			layout, NULL);
+}
+
+
+/* keyboard_layout_apply */
+static void _keyboard_layout_apply(KeyboardLayout * layout,
+		KeyboardLayoutKey * key, unsigned int modifier)
+{
+	GdkRectangle area;
+
+	if(key->key == NULL
+			|| keyboard_key_apply_modifier(key->key, modifier)
+			== FALSE)
+		return;
+	if(layout->surface == FALSE)
+		return;
+	_keyboard_layout_rectangle(layout, key, &area);
+	gtk_widget_queue_draw_area(layout->widget, area.x, area.y, area.width,
+			area.height);
+}
+
+
+/* keyboard_layout_modifier */
+static KeyboardLayoutModifier * _keyboard_layout_modifier(
+		KeyboardLayout * layout, unsigned int modifier)
+{
+	KeyboardLayoutModifier * p = &layout->modifiers[modifier];
+	KeyboardLayoutKey ** q;
+	KeyboardLayoutKey * key;
+	size_t i;
+	size_t j;
+
+	if(p->indexed)
+		return p;
+	/* index the keys affected by this combination of modifiers */
+	for(i = 0; i < layout->rows_cnt; i++)
+		for(j = 0; j < layout->rows[i].keys_cnt; j++)
+		{
+			key = &layout->rows[i].keys[j];
+			if(key->key == NULL || !keyboard_key_has_modifier(
+						key->key, modifier))
+				continue;
+			if((q = realloc(p->keys, sizeof(*q)
+							* (p->keys_cnt + 1)))
+					== NULL)
+			{
+				free(p->keys);
+				p->keys = NULL;
+				p->keys_cnt = 0;
+				return NULL;
+			}
+			p->keys = q;
+			p->keys[p->keys_cnt++] = key;
+		}
+	p->indexed = TRUE;
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s(0x%x) %lu keys\n", __func__, modifier,
+			(unsigned long)p->keys_cnt);
+#endif
+	return p;
+}
+
+
+/* keyboard_layout_modifiers_reset */
+static void _keyboard_layout_modifiers_reset(KeyboardLayout * layout)
+{
+	size_t i;
+
+	for(i = 0; i < KM_COUNT; i++)
+	{
+		free(layout->modifiers[i].keys);
+		layout->modifiers[i].indexed = FALSE;
+		layout->modifiers[i].keys = NULL;
+		layout->modifiers[i].keys_cnt = 0;
+	}
+}
+
+
+/* keyboard_layout_event_time */
+static gint64 _keyboard_layout_event_time(GdkEventButton * event)
+{
+	gint64 now;
+	guint32 elapsed;
+
+	/* the X server stamps the events with the monotonic clock, in ms */
+	now = g_get_monotonic_time();
+	elapsed = (guint32)(now / 1000) - event->time;
+	/* unless from elsewhere, or so it seems */
+	if(event->time == GDK_CURRENT_TIME || elapsed > 10000)
+		return now;
+	return now - (gint64)elapsed * 1000;
+}
+
+
+/* surface */
+/* keyboard_layout_draw */
+static void _keyboard_layout_draw(KeyboardLayout * layout, cairo_t * cr,
+		GdkRectangle * clip)
+{
+	KeyboardGlyphs * glyphs;
+	GdkRectangle area;
+	size_t i;
+	size_t j;
+
+	/* the labels are shared with the other layouts */
+	glyphs = keyboard_get_glyphs(layout->keyboard);
+	for(i = 0; i < layout->rows_cnt; i++)
+		for(j = 0; j < layout->rows[i].keys_cnt; j++)
 		{
-			XTestFakeKeyEvent(display, keycode, True, 0);
-			XTestFakeKeyEvent(display, keycode, False, 0);
+			_keyboard_layout_rectangle(layout,
+					&layout->rows[i].keys[j], &area);
+			/* only redraw the damaged keys */
+			if(clip != NULL && !gdk_rectangle_intersect(clip,
+						&area, NULL))
+				continue;
+			_keyboard_layout_draw_key(layout, cr, glyphs,
+					&layout->rows[i].keys[j], &area);
 		}
-		keyboard_layout_apply_modifier(layout, active ? keysym : 0);
+}
+
+
+/* keyboard_layout_draw_key */
+static void _keyboard_layout_draw_key(KeyboardLayout * layout, cairo_t * cr,
+		KeyboardGlyphs * glyphs, KeyboardLayoutKey * key,
+		GdkRectangle * area)
+{
+	char const * label;
+	double background;
+
+	if(key->key != NULL)
+	{
+		label = keyboard_key_get_label(key->key);
+		background = (key == layout->pressed
+				|| keyboard_key_get_active(key->key))
+			? 0.56 : 0.82;
 	}
 	else
 	{
-		XTestFakeKeyEvent(display, keycode, True, 0);
-		XTestFakeKeyEvent(display, keycode, False, 0);
+		label = key->label;
+		background = (key == layout->pressed) ? 0.82 : 1.0;
 	}
-	XTestGrabControl(display, False);
+	cairo_set_source_rgb(cr, background, background, background);
+	cairo_rectangle(cr, area->x, area->y, area->width, area->height);
+	cairo_fill_preserve(cr);
+	cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+	cairo_set_line_width(cr, 1.0);
+	cairo_stroke(cr);
+	keyboard_glyphs_draw(glyphs, layout->widget, cr, label, layout->font,
+			0x000000, area, 0.5);
 }
+
+
+/* keyboard_layout_gesture */
+static void _keyboard_layout_gesture(KeyboardLayout * layout,
+		GdkEventButton * event, GdkRectangle * area)
+{
+	KeyboardLayoutKey * key;
+	GdkRectangle r;
+	gunichar c;
+	size_t i;
+	size_t j;
+
+	/* only from the letters */
+	layout->gesture = NULL;
+	c = gdk_keyval_to_unicode(keyboard_key_get_keysym(
+				layout->pressed->key));
+	if(!g_unichar_isalpha(c) || (layout->gesture = keyboard_get_gesture(
+					layout->keyboard)) == NULL)
+		return;
+	keyboard_gesture_start(layout->gesture, area->width);
+	for(i = 0; i < layout->rows_cnt; i++)
+		for(j = 0; j < layout->rows[i].keys_cnt; j++)
+		{
+			key = &layout->rows[i].keys[j];
+			if(key->key == NULL)
+				continue;
+			c = gdk_keyval_to_unicode(keyboard_key_get_keysym(
+						key->key));
+			if(!g_unichar_isalpha(c))
+				continue;
+			_keyboard_layout_rectangle(layout, key, &r);
+			keyboard_gesture_add_key(layout->gesture, c,
+					r.x + r.width / 2.0,
+					r.y + r.height / 2.0);
+		}
+	keyboard_gesture_add_point(layout->gesture, event->x, event->y);
+}
+
+
+/* keyboard_layout_index */
+static int _keyboard_layout_index(KeyboardLayout * layout)
+{
+	KeyboardLayoutKey ** grid;
+	KeyboardLayoutKey * key;
+	size_t i;
+	size_t j;
+	unsigned int k;
+
+	if((grid = calloc(layout->rows_cnt * layout->columns, sizeof(*grid)))
+			== NULL)
+		return -1;
+	/* the keys defined first take precedence */
+	for(i = 0; i < layout->rows_cnt; i++)
+		for(j = 0; j < layout->rows[i].keys_cnt; j++)
+		{
+			key = &layout->rows[i].keys[j];
+			for(k = key->column; k < key->column + key->width
+					&& k < layout->columns; k++)
+				if(grid[i * layout->columns + k] == NULL)
+					grid[i * layout->columns + k] = key;
+		}
+	layout->grid = grid;
+	return 0;
+}
+
+
+/* keyboard_layout_lookup */
+static gboolean _lookup_edge(KeyboardLayoutKey * key, gdouble x, gdouble y,
+		gdouble width, gdouble height);
+static gdouble _lookup_score(KeyboardLayout * layout, KeyboardLayoutKey * key,
+		gdouble x, gdouble y, gdouble width, gdouble height);
+
+static KeyboardLayoutKey * _keyboard_layout_lookup(KeyboardLayout * layout,
+		gdouble x, gdouble y)
+{
+	GtkAllocation a;
+	gdouble width;
+	gdouble height;
+	unsigned int row;
+	unsigned int column;
+	unsigned int i;
+	unsigned int j;
+	KeyboardLayoutKey * ret;
+	KeyboardLayoutKey * key;
+	gdouble score;
+	gdouble s;
+
+	gtk_widget_get_allocation(layout->widget, &a);
+	if(layout->rows_cnt == 0 || layout->columns == 0 || x < 0.0
+			|| y < 0.0 || x >= a.width || y >= a.height)
+		return NULL;
+	if(layout->grid == NULL && _keyboard_layout_index(layout) != 0)
+		return NULL;
+	width = (gdouble)a.width / layout->columns;
+	height = (gdouble)a.height / layout->rows_cnt;
+	row = y / height;
+	column = x / width;
+	ret = layout->grid[row * layout->columns + column];
+	/* near the edges, the letters expected next are favoured */
+	if(ret == NULL || !_lookup_edge(ret, x, y, width, height)
+			|| (score = _lookup_score(layout, ret, x, y, width,
+					height)) == HUGE_VAL)
+		return ret;
+	for(i = (row > 0) ? row - 1 : 0; i <= row + 1 && i < layout->rows_cnt;
+			i++)
+		for(j = (column > 2) ? column - 2 : 0;
+				j <= column + 2 && j < layout->columns; j++)
+		{
+			if((key = layout->grid[i * layout->columns + j]) == NULL
+					|| key == ret)
+				continue;
+			if((s = _lookup_score(layout, key, x, y, width, height))
+					< score)
+			{
+				ret = key;
+				score = s;
+			}
+		}
+	return ret;
+}
+
+static gboolean _lookup_edge(KeyboardLayoutKey * key, gdouble x, gdouble y,
+		gdouble width, gdouble height)
+{
+	gdouble dx;
+	gdouble dy;
+
+	/* a clear hit stays with its key */
+	dx = fabs(x - (key->column + key->width / 2.0) * width)
+		/ (key->width * width);
+	dy = fabs(y - (key->row + 0.5) * height) / height;
+	return (dx > 0.5 - KEYBOARD_LAYOUT_MARGIN
+			|| dy > 0.5 - KEYBOARD_LAYOUT_MARGIN) ? TRUE : FALSE;
+}
+
+static gdouble _lookup_score(KeyboardLayout * layout, KeyboardLayoutKey * key,
+		gdouble x, gdouble y, gdouble width, gdouble height)
+{
+	gdouble likelihood;
+	gdouble dx;
+	gdouble dy;
+
+	/* only the letters, and only with a dictionary */
+	if(key->key == NULL || (likelihood = keyboard_get_likelihood(
+					layout->keyboard,
+					keyboard_key_get_keysym(key->key)))
+			< 0.0)
+		return HUGE_VAL;
+	/* the distance to the centre, in keys */
+	dx = (x - (key->column + key->width / 2.0) * width)
+		/ (key->width * width);
+	dy = (y - (key->row + 0.5) * height) / height;
+	return (dx * dx + dy * dy) / (2.0 * KEYBOARD_LAYOUT_SPREAD
+			* KEYBOARD_LAYOUT_SPREAD)
+		- log(likelihood + KEYBOARD_LAYOUT_PRIOR);
+}
+
+
+/* keyboard_layout_rectangle */
+static void _keyboard_layout_rectangle(KeyboardLayout * layout,
+		KeyboardLayoutKey * key, GdkRectangle * area)
+{
+	GtkAllocation a;
+	gdouble width;
+	gdouble height;
+
+	gtk_widget_get_allocation(layout->widget, &a);
+	width = (gdouble)a.width / layout->columns;
+	height = (gdouble)a.height / layout->rows_cnt;
+	/* same spacing as with the widgets */
+	area->x = key->column * width + 2;
+	area->y = key->row * height + 2;
+	area->width = key->width * width - 4;
+	area->height = height - 4;
+}
+
+
+/* callbacks */
+/* on_key_button_press */
+static gboolean _on_key_button_press(GtkWidget * widget,
+		GdkEventButton * event, gpointer data)
+{
+	KeyboardLayout * layout = data;
+	KeyboardKey * key;
+	GdkRectangle area;
+
+	key = g_object_get_data(G_OBJECT(widget), "key");
+	/* no click follows a release off the key */
+	layout->repeated = FALSE;
+	keyboard_repeat_start(layout->keyboard, key);
+	area.x = event->x_root - event->x;
+	area.y = event->y_root - event->y;
+#if GTK_CHECK_VERSION(2, 24, 0)
+	area.width = gdk_window_get_width(event->window);
+	area.height = gdk_window_get_height(event->window);
+#else
+	gdk_window_get_size(event->window, &area.width, &area.height);
+#endif
+	keyboard_key_show(layout->keyboard, key, TRUE, &area);
+	return FALSE;
+}
+
+
+/* on_key_button_release */
+static gboolean _on_key_button_release(GtkWidget * widget,
+		GdkEventButton * event, gpointer data)
+{
+	KeyboardLayout * layout = data;
+	KeyboardKey * key;
+
+	key = g_object_get_data(G_OBJECT(widget), "key");
+	/* this happens before the click */
+	keyboard_key_set_pressed(key, _keyboard_layout_event_time(event));
+	layout->repeated = keyboard_repeat_stop(layout->keyboard);
+	keyboard_key_show(layout->keyboard, key, FALSE, NULL);
+	return FALSE;
+}
+
+
+/* on_key_clicked */
+static void _on_key_clicked(GtkWidget * widget, gpointer data)
+{
+	KeyboardLayout * layout = data;
+	KeyboardKey * key;
+
+	if(layout->repeated)
+	{
+		layout->repeated = FALSE;
+		return;
+	}
+	key = g_object_get_data(G_OBJECT(widget), "key");
+	_keyboard_layout_activate(layout, key);
+}
+
+
+/* on_layout_ack */
+static gboolean _on_layout_ack(gpointer data)
+{
+	KeyboardLayout * layout = data;
+
+	/* the server has processed the events injected once replying */
+	XSync(gdk_x11_get_default_xdisplay(), False);
+	keyboard_stats_record(keyboard_get_stats(layout->keyboard),
+			KEYBOARD_STATS_ACK, g_get_monotonic_time()
+			- layout->ack_time);
+	layout->ack = 0;
+	return FALSE;
+}
+
+
+/* on_layout_button_press */
+static gboolean _on_layout_button_press(GtkWidget * widget,
+		GdkEventButton * event, gpointer data)
+{
+	KeyboardLayout * layout = data;
+	GdkRectangle area;
+	gint x;
+	gint y;
+
+	if(event->type != GDK_BUTTON_PRESS || event->button != 1)
+		return FALSE;
+	if((layout->pressed = _keyboard_layout_lookup(layout, event->x,
+					event->y)) == NULL)
+		return FALSE;
+	_keyboard_layout_rectangle(layout, layout->pressed, &area);
+	gtk_widget_queue_draw_area(widget, area.x, area.y, area.width,
+			area.height);
+	/* the actions are not previewed */
+	if(layout->pressed->key == NULL)
+		return TRUE;
+	keyboard_repeat_start(layout->keyboard, layout->pressed->key);
+	_keyboard_layout_gesture(layout, event, &area);
+	gdk_window_get_origin(event->window, &x, &y);
+	area.x += x;
+	area.y += y;
+	keyboard_key_show(layout->keyboard, layout->pressed->key, TRUE, &area);
+	return TRUE;
+}
+
+
+/* on_layout_button_release */
+static gboolean _on_layout_button_release(GtkWidget * widget,
+		GdkEventButton * event, gpointer data)
+{
+	KeyboardLayout * layout = data;
+	KeyboardLayoutKey * pressed = layout->pressed;
+	GdkRectangle area;
+	gboolean repeated = FALSE;
+	gboolean swiped;
+
+	if(event->button != 1 || pressed == NULL)
+		return FALSE;
+	layout->pressed = NULL;
+	if(pressed->key != NULL)
+	{
+		keyboard_key_set_pressed(pressed->key,
+				_keyboard_layout_event_time(event));
+		keyboard_key_show(layout->keyboard, pressed->key, FALSE, NULL);
+		repeated = keyboard_repeat_stop(layout->keyboard);
+	}
+	_keyboard_layout_rectangle(layout, pressed, &area);
+	gtk_widget_queue_draw_area(widget, area.x, area.y, area.width,
+			area.height);
+	/* whole words are typed along the gestures instead */
+	if(layout->gesture != NULL)
+	{
+		keyboard_gesture_add_point(layout->gesture, event->x,
+				event->y);
+		swiped = keyboard_gesture_is_swipe(layout->gesture);
+		layout->gesture = NULL;
+		if(swiped)
+		{
+			keyboard_swipe(layout->keyboard);
+			return TRUE;
+		}
+	}
+	/* only activate when released over the same key, unless repeated */
+	if(repeated || _keyboard_layout_lookup(layout, event->x, event->y)
+			!= pressed)
+		return TRUE;
+	if(pressed->key == NULL)
+	{
+		pressed->callback(pressed->data);
+		return TRUE;
+	}
+	if(keysym_is_modifier(keyboard_key_get_keysym(pressed->key)))
+		keyboard_key_set_active(pressed->key, !keyboard_key_get_active(
+					pressed->key));
+	_keyboard_layout_activate(layout, pressed->key);
+	return TRUE;
+}
+
+
+/* on_layout_motion_notify */
+static gboolean _on_layout_motion_notify(GtkWidget * widget,
+		GdkEventMotion * event, gpointer data)
+{
+	KeyboardLayout * layout = data;
+	gboolean swiped;
+
+	if(layout->gesture == NULL || layout->pressed == NULL)
+		return FALSE;
+	swiped = keyboard_gesture_is_swipe(layout->gesture);
+	keyboard_gesture_add_point(layout->gesture, event->x, event->y);
+	/* the key pressed is not typed once swiping */
+	if(!swiped && keyboard_gesture_is_swipe(layout->gesture))
+	{
+		keyboard_repeat_stop(layout->keyboard);
+		keyboard_key_show(layout->keyboard, layout->pressed->key,
+				FALSE, NULL);
+	}
+	return TRUE;
+}
+
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+/* on_layout_draw */
+static gboolean _on_layout_draw(GtkWidget * widget, cairo_t * cr,
+		gpointer data)
+{
+	KeyboardLayout * layout = data;
+	GdkRectangle clip;
+
+	if(gdk_cairo_get_clip_rectangle(cr, &clip))
+		_keyboard_layout_draw(layout, cr, &clip);
+	else
+		_keyboard_layout_draw(layout, cr, NULL);
+	return TRUE;
+}
+#else
+/* on_layout_expose_event */
+static gboolean _on_layout_expose_event(GtkWidget * widget,
+		GdkEventExpose * event, gpointer data)
+{
+	KeyboardLayout * layout = data;
+	cairo_t * cr;
+
+	cr = gdk_cairo_create(gtk_widget_get_window(widget));
+	gdk_cairo_rectangle(cr, &event->area);
+	cairo_clip(cr);
+	_keyboard_layout_draw(layout, cr, &event->area);
+	cairo_destroy(cr);
+	return TRUE;
+}
+#endif
@@ -33,26 +33,40 @@
 
 # include <gtk/gtk.h>
 # include "key.h"
+# include "keyboard.h"
+# include "keymap.h"
 
 
 /* Keyboard */
 /* types */
 typedef struct _KeyboardLayout KeyboardLayout;
 
+typedef void (*KeyboardLayoutCallback)(void * data);
+
 
 /* functions */
-KeyboardLayout * keyboard_layout_new(void);
+KeyboardLayout * keyboard_layout_new(Keyboard * keyboard,
+		KeyboardKeymap * keymap, gboolean surface);
 void keyboard_layout_delete(KeyboardLayout * layout);
 
 /* accessors */
 GtkWidget * keyboard_layout_get_widget(KeyboardLayout * layout);
 
+void keyboard_layout_set_font(KeyboardLayout * layout,
+		PangoFontDescription * font);
+
 /* useful */
 KeyboardKey * keyboard_layout_add(KeyboardLayout * layout, unsigned int row,
 		unsigned int width, unsigned int keysym, char const * label);
+int keyboard_layout_add_action(KeyboardLayout * layout, unsigned int row,
+		unsigned int column, unsigned int width, char const * label,
+		KeyboardLayoutCallback callback, void * data);
 void keyboard_layout_add_widget(KeyboardLayout * layout, unsigned int row,
 		unsigned int column, unsigned int width, GtkWidget * widget);
 void keyboard_layout_apply_modifier(KeyboardLayout * layout,
 		unsigned int modifier);
+/* only with the keys drawn on a single surface, as currently allocated */
+void keyboard_layout_draw(KeyboardLayout * layout, cairo_t * cr);
+void keyboard_layout_release_modifiers(KeyboardLayout * layout);
 
 #endif /* !KEYBOARD_LAYOUT_H */
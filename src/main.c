@@ -89,16 +89,26 @@ static int _error(char const * message, int ret)
 /* usage */
 static int _usage(void)
 {
-	fprintf(stderr, _("Usage: %s [-d|-p|-w|-x][-f font][-l layout]"
-"[-m monitor][-n]\n"
+	fprintf(stderr, _("Usage: %s [-d|-p|-w|-x][-b][-D dictionary][-f font]"
+"[-g][-i backend][-l layout][-m monitor][-n][-P filename]\n"
+"       [-r delay[,rate]][-s][-v][-W]\n"
 "  -d	Start in docked mode\n"
 "  -l	Select a different layout\n"
 "  -p	Start as a popup window\n"
 "  -w	Start in windowed mode\n"
 "  -x	Start in embedded mode\n"
+"  -D	Suggest words from a dictionary\n"
 "  -f	Set the font used for the keys\n"
+"  -g	Type whole words with gestures (with -D and -s)\n"
+"  -i	Select the backend injecting the keys (xtest, uinput, null)\n"
 "  -m	Place on a particular monitor (in docked or popup mode)\n"
-"  -n	Start without showing up directly (if not embedded)\n"),
+"  -n	Start without showing up directly (if not embedded)\n"
+"  -P	Report the time spent starting up, and append it to a file\n"
+"  -b	Build the other pages in the background\n"
+"  -r	Set the delay (in ms) and rate (per second) of the repetition\n"
+"  -s	Draw the keys on a single surface\n"
+"  -v	Report the time spent building every page\n"
+"  -W	Prepare the window while hidden, to show up faster (with -n)\n"),
 			PROGNAME_KEYBOARD);
 	return 1;
 }
@@ -118,16 +128,30 @@ int main(int argc, char * argv[])
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 	memset(&prefs, 0, sizeof(prefs));
+	prefs.repeat_delay = KEYBOARD_REPEAT_DELAY;
+	prefs.repeat_rate = KEYBOARD_REPEAT_RATE;
 	gtk_init(&argc, &argv);
-	while((o = getopt(argc, argv, "df:l:m:npwx")) != -1)
+	while((o = getopt(argc, argv, "bdD:f:gi:l:m:nP:pr:svWwx")) != -1)
 		switch(o)
 		{
+			case 'b':
+				prefs.idle = 1;
+				break;
 			case 'd':
 				prefs.mode = KEYBOARD_MODE_DOCKED;
 				break;
+			case 'D':
+				prefs.dictionary = optarg;
+				break;
 			case 'f':
 				prefs.font = optarg;
 				break;
+			case 'g':
+				prefs.gesture = 1;
+				break;
+			case 'i':
+				prefs.backend = optarg;
+				break;
 			case 'l':
 				prefs.layout = optarg;
 				break;
@@ -139,9 +163,32 @@ int main(int argc, char * argv[])
 			case 'n':
 				prefs.wait = 1;
 				break;
+			case 'P':
+				prefs.profile = optarg;
+				break;
 			case 'p':
 				prefs.mode = KEYBOARD_MODE_POPUP;
 				break;
+			case 'r':
+				prefs.repeat_delay = strtol(optarg, &p, 10);
+				if(optarg[0] == '\0' || prefs.repeat_delay < 0)
+					return _usage();
+				if(*p == ',')
+					prefs.repeat_rate = strtol(p + 1, &p,
+							10);
+				if(*p != '\0' || prefs.repeat_rate <= 0
+						|| prefs.repeat_rate > 1000)
+					return _usage();
+				break;
+			case 's':
+				prefs.surface = 1;
+				break;
+			case 'v':
+				prefs.verbose = 1;
+				break;
+			case 'W':
+				prefs.prewarm = 1;
+				break;
 			case 'w':
 				prefs.mode = KEYBOARD_MODE_WINDOWED;
 				break;
@@ -151,7 +198,8 @@ int main(int argc, char * argv[])
 			default:
 				return _usage();
 		}
-	if(optind != argc)
+	if(optind != argc || (prefs.gesture && (prefs.dictionary == NULL
+					|| !prefs.surface)))
 		return _usage();
 	return (_keyboard(&prefs) == 0) ? 0 : 2;
 }
@@ -0,0 +1,158 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <System.h>
+#include "profile.h"
+#include "../config.h"
+
+
+/* KeyboardProfile */
+/* private */
+/* constants */
+#define KEYBOARD_PROFILE_PHASES		16
+
+
+/* types */
+typedef struct _KeyboardProfilePhase
+{
+	char const * name;
+	gint64 duration;
+	unsigned long requests;
+} KeyboardProfilePhase;
+
+struct _KeyboardProfile
+{
+	Display * display;
+	gint64 start;
+	gint64 time;
+	unsigned long request;
+
+	KeyboardProfilePhase phases[KEYBOARD_PROFILE_PHASES];
+	size_t phases_cnt;
+};
+
+
+/* public */
+/* functions */
+/* keyboard_profile_new */
+KeyboardProfile * keyboard_profile_new(Display * display)
+{
+	KeyboardProfile * profile;
+
+	if((profile = malloc(sizeof(*profile))) == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		return NULL;
+	}
+	profile->display = display;
+	profile->start = g_get_monotonic_time();
+	profile->time = profile->start;
+	profile->request = (display != NULL) ? NextRequest(display) : 0;
+	profile->phases_cnt = 0;
+	return profile;
+}
+
+
+/* keyboard_profile_delete */
+void keyboard_profile_delete(KeyboardProfile * profile)
+{
+	free(profile);
+}
+
+
+/* useful */
+/* keyboard_profile_mark */
+void keyboard_profile_mark(KeyboardProfile * profile, char const * name)
+{
+	KeyboardProfilePhase * phase;
+	gint64 now;
+	unsigned long request;
+
+	if(profile == NULL)
+		return;
+	now = g_get_monotonic_time();
+	/* the requests sent to the X server, replied to or not */
+	request = (profile->display != NULL)
+		? NextRequest(profile->display) : 0;
+	if(profile->phases_cnt < KEYBOARD_PROFILE_PHASES)
+	{
+		phase = &profile->phases[profile->phases_cnt++];
+		phase->name = name;
+		phase->duration = now - profile->time;
+		phase->requests = request - profile->request;
+	}
+	profile->time = now;
+	profile->request = request;
+}
+
+
+/* keyboard_profile_print */
+void keyboard_profile_print(KeyboardProfile * profile, char const * prefix)
+{
+	size_t i;
+
+	for(i = 0; i < profile->phases_cnt; i++)
+		fprintf(stderr, "%s: %s: %.3f ms, %lu X requests\n", prefix,
+				profile->phases[i].name,
+				profile->phases[i].duration / 1000.0,
+				profile->phases[i].requests);
+	fprintf(stderr, "%s: %s: %.3f ms\n", prefix, "total",
+			(profile->time - profile->start) / 1000.0);
+}
+
+
+/* keyboard_profile_save */
+int keyboard_profile_save(KeyboardProfile * profile, char const * filename)
+{
+	FILE * fp;
+	size_t i;
+
+	/* one JSON object per run, to compare versions and hardware */
+	if((fp = fopen(filename, "a")) == NULL)
+		return -error_set_code(1, "%s: %s", filename, strerror(errno));
+	fprintf(fp, "{ \"package\": \"%s\", \"version\": \"%s\", "
+			"\"total_ms\": %.3f, \"phases\": [", PACKAGE, VERSION,
+			(profile->time - profile->start) / 1000.0);
+	for(i = 0; i < profile->phases_cnt; i++)
+		fprintf(fp, "%s { \"phase\": \"%s\", \"ms\": %.3f, "
+				"\"requests\": %lu }", (i > 0) ? "," : "",
+				profile->phases[i].name,
+				profile->phases[i].duration / 1000.0,
+				profile->phases[i].requests);
+	fputs(" ] }\n", fp);
+	if(fclose(fp) != 0)
+		return -error_set_code(1, "%s: %s", filename, strerror(errno));
+	return 0;
+}
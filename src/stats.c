@@ -0,0 +1,183 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+
+
+/* KeyboardStats */
+/* private */
+/* constants */
+/* four buckets per power of two, up to about an hour */
+#define KEYBOARD_STATS_SUBBUCKETS	4
+#define KEYBOARD_STATS_BUCKETS		(32 * KEYBOARD_STATS_SUBBUCKETS)
+
+
+/* types */
+typedef struct _KeyboardStatsHistogram
+{
+	uint32_t buckets[KEYBOARD_STATS_BUCKETS];
+	uint32_t count;
+	uint32_t max;
+} KeyboardStatsHistogram;
+
+struct _KeyboardStats
+{
+	KeyboardStatsHistogram stages[KEYBOARD_STATS_COUNT];
+};
+
+
+/* prototypes */
+static unsigned int _keyboard_stats_bucket(uint32_t duration);
+static uint32_t _keyboard_stats_bucket_max(unsigned int bucket);
+static uint32_t _keyboard_stats_percentile(KeyboardStatsHistogram * histogram,
+		unsigned int percent);
+
+
+/* public */
+/* functions */
+/* keyboard_stats_new */
+KeyboardStats * keyboard_stats_new(void)
+{
+	KeyboardStats * stats;
+
+	if((stats = malloc(sizeof(*stats))) == NULL)
+		return NULL;
+	memset(stats, 0, sizeof(*stats));
+	return stats;
+}
+
+
+/* keyboard_stats_delete */
+void keyboard_stats_delete(KeyboardStats * stats)
+{
+	free(stats);
+}
+
+
+/* accessors */
+/* keyboard_stats_get */
+uint32_t keyboard_stats_get(KeyboardStats * stats, KeyboardStatsStage stage,
+		KeyboardStatsValue value)
+{
+	KeyboardStatsHistogram * histogram;
+
+	if(stage >= KEYBOARD_STATS_COUNT)
+		return 0;
+	histogram = &stats->stages[stage];
+	switch(value)
+	{
+		case KEYBOARD_STATS_VALUE_SAMPLES:
+			return histogram->count;
+		case KEYBOARD_STATS_VALUE_P50:
+			return _keyboard_stats_percentile(histogram, 50);
+		case KEYBOARD_STATS_VALUE_P99:
+			return _keyboard_stats_percentile(histogram, 99);
+		case KEYBOARD_STATS_VALUE_MAX:
+			return histogram->max;
+	}
+	return 0;
+}
+
+
+/* useful */
+/* keyboard_stats_record */
+void keyboard_stats_record(KeyboardStats * stats, KeyboardStatsStage stage,
+		int64_t duration)
+{
+	KeyboardStatsHistogram * histogram;
+	uint32_t d;
+
+	if(stage >= KEYBOARD_STATS_COUNT || duration < 0)
+		return;
+	histogram = &stats->stages[stage];
+	d = (duration > UINT32_MAX) ? UINT32_MAX : duration;
+	histogram->buckets[_keyboard_stats_bucket(d)]++;
+	if(histogram->count < UINT32_MAX)
+		histogram->count++;
+	if(d > histogram->max)
+		histogram->max = d;
+}
+
+
+/* private */
+/* functions */
+/* keyboard_stats_bucket */
+static unsigned int _keyboard_stats_bucket(uint32_t duration)
+{
+	unsigned int msb;
+
+	if(duration < KEYBOARD_STATS_SUBBUCKETS)
+		return duration;
+	for(msb = 0; (duration >> msb) > 1; msb++);
+	/* the power of two, then the two bits below it */
+	return (msb - 1) * KEYBOARD_STATS_SUBBUCKETS
+		+ ((duration >> (msb - 2)) & (KEYBOARD_STATS_SUBBUCKETS - 1));
+}
+
+
+/* keyboard_stats_bucket_max */
+static uint32_t _keyboard_stats_bucket_max(unsigned int bucket)
+{
+	unsigned int msb;
+	uint64_t min;
+
+	if(bucket < KEYBOARD_STATS_SUBBUCKETS)
+		return bucket;
+	msb = bucket / KEYBOARD_STATS_SUBBUCKETS + 1;
+	min = (uint64_t)(KEYBOARD_STATS_SUBBUCKETS
+			+ bucket % KEYBOARD_STATS_SUBBUCKETS) << (msb - 2);
+	min += ((uint64_t)1 << (msb - 2)) - 1;
+	return (min > UINT32_MAX) ? UINT32_MAX : min;
+}
+
+
+/* keyboard_stats_percentile */
+static uint32_t _keyboard_stats_percentile(KeyboardStatsHistogram * histogram,
+		unsigned int percent)
+{
+	uint64_t rank;
+	uint64_t cnt = 0;
+	unsigned int i;
+	uint32_t ret;
+
+	if(histogram->count == 0)
+		return 0;
+	rank = ((uint64_t)histogram->count * percent + 99) / 100;
+	for(i = 0; i < KEYBOARD_STATS_BUCKETS; i++)
+		if((cnt += histogram->buckets[i]) >= rank)
+			break;
+	/* report the upper bound of the bucket, within the maximum seen */
+	ret = _keyboard_stats_bucket_max(i);
+	return (ret < histogram->max) ? ret : histogram->max;
+}
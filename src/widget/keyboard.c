@@ -31,17 +31,35 @@
 #include <gtk/gtk.h>
 #include <System.h>
 #include <Desktop.h>
+#include "../backend.h"
 #include "../callbacks.h"
 #include "../common.h"
+#include "../control.h"
+#include "../definition.h"
+#include "../dictionary.h"
+#include "../gesture.h"
+#include "../glyphs.h"
+#include "../keymap.h"
 #include "../layout.h"
 #include "../key.h"
 #include "../keyboard.h"
+#include "../profile.h"
+#include "../stats.h"
 
+#include "../backend.c"
 #include "../callbacks.c"
 #include "../common.c"
+#include "../control.c"
+#include "../definition.c"
+#include "../dictionary.c"
+#include "../gesture.c"
+#include "../glyphs.c"
+#include "../keymap.c"
 #include "../layout.c"
 #include "../key.c"
 #include "../keyboard.c"
+#include "../profile.c"
+#include "../stats.c"
 
 
 /* KeyboardWidget */
@@ -87,8 +105,19 @@ static KeyboardWidget * _keyboard_init(char const * name)
 	if((keyboard = object_new(sizeof(*keyboard))) == NULL)
 		return NULL;
 	prefs.monitor = -1;
+	prefs.backend = NULL;
+	prefs.dictionary = NULL;
 	prefs.font = NULL;
+	prefs.gesture = 0;
+	prefs.idle = 0;
+	prefs.layout = NULL;
 	prefs.mode = KEYBOARD_MODE_WIDGET;
+	prefs.prewarm = 0;
+	prefs.profile = NULL;
+	prefs.repeat_delay = KEYBOARD_REPEAT_DELAY;
+	prefs.repeat_rate = KEYBOARD_REPEAT_RATE;
+	prefs.surface = 0;
+	prefs.verbose = 0;
 	prefs.wait = 0;
 	if((keyboard->keyboard = keyboard_new(&prefs)) == NULL)
 	{
@@ -0,0 +1,458 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#if GTK_CHECK_VERSION(3, 0, 0)
+# include <gtk/gtkx.h>
+#endif
+#include <gdk/gdkx.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XTest.h>
+
+#ifndef PROGNAME_BENCH
+# define PROGNAME_BENCH		"bench"
+#endif
+
+
+/* private */
+/* constants */
+#define BENCH_COUNT		200
+/* the taps go to the keys along the first row */
+#define BENCH_KEYS		10
+#define BENCH_ROWS		4
+/* in milliseconds */
+#define BENCH_TIMEOUT_START	10000
+#define BENCH_TIMEOUT_TAP	1000
+
+
+/* types */
+typedef struct _Bench
+{
+	/* preferences */
+	char const * program;
+	char ** arguments;
+	int arguments_cnt;
+	gboolean embedded;
+	unsigned int count;
+
+	Display * display;
+	GPid pid;
+	Window keyboard;
+	GtkWidget * probe;
+	GtkWidget * socket;
+	gboolean done;
+	gboolean timeout;
+
+	/* results */
+	gint64 mapped;
+	unsigned int received;
+	gint64 elapsed;
+	gint64 latency;
+	gint64 latency_max;
+	unsigned long rss;
+	unsigned long hwm;
+} Bench;
+
+
+/* prototypes */
+static int _bench(Bench * bench);
+static Window _bench_find(Bench * bench);
+static void _bench_memory(Bench * bench);
+static void _bench_print(Bench * bench);
+static int _bench_start(Bench * bench);
+static void _bench_stop(Bench * bench);
+static int _bench_taps(Bench * bench);
+static int _bench_wait(Bench * bench, unsigned int timeout);
+
+static int _error(char const * message, int ret);
+static int _usage(void);
+
+/* callbacks */
+static gboolean _bench_on_key_press(GtkWidget * widget, GdkEventKey * event,
+		gpointer data);
+static void _bench_on_plug_added(GtkWidget * widget, gpointer data);
+static gboolean _bench_on_poll(gpointer data);
+static gboolean _bench_on_timeout(gpointer data);
+
+
+/* functions */
+/* bench */
+static int _bench(Bench * bench)
+{
+	int ret;
+	GtkWidget * window;
+
+	bench->display = gdk_x11_get_default_xdisplay();
+	/* the probe receives the keys typed */
+	bench->probe = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+	gtk_window_set_title(GTK_WINDOW(bench->probe), "Probe");
+	gtk_window_set_default_size(GTK_WINDOW(bench->probe), 200, 100);
+	g_signal_connect(bench->probe, "key-press-event", G_CALLBACK(
+				_bench_on_key_press), bench);
+	gtk_widget_show(bench->probe);
+	if(bench->embedded)
+	{
+		/* the keyboard is embedded in a window of its own */
+		window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+		gtk_window_set_accept_focus(GTK_WINDOW(window), FALSE);
+		gtk_window_move(GTK_WINDOW(window), 0, 200);
+		bench->socket = gtk_socket_new();
+		gtk_widget_set_size_request(bench->socket, 640, 240);
+		g_signal_connect(bench->socket, "plug-added", G_CALLBACK(
+					_bench_on_plug_added), bench);
+		gtk_container_add(GTK_CONTAINER(window), bench->socket);
+		gtk_widget_show_all(window);
+	}
+	while(gtk_events_pending())
+		gtk_main_iteration();
+	if((ret = _bench_start(bench)) == 0)
+	{
+		ret = _bench_taps(bench);
+		_bench_memory(bench);
+	}
+	_bench_stop(bench);
+	if(ret == 0)
+		_bench_print(bench);
+	return ret;
+}
+
+
+/* bench_find */
+static Window _bench_find(Bench * bench)
+{
+	Window ret = None;
+	Window root;
+	Window parent;
+	Window * children;
+	unsigned int cnt;
+	unsigned int i;
+	XWindowAttributes attributes;
+	XClassHint hint;
+	char const * name;
+
+	/* the keyboard is a top-level window named after the program */
+	if((name = strrchr(bench->program, '/')) != NULL)
+		name++;
+	else
+		name = bench->program;
+	if(XQueryTree(bench->display, DefaultRootWindow(bench->display), &root,
+				&parent, &children, &cnt) == 0)
+		return None;
+	for(i = 0; ret == None && i < cnt; i++)
+	{
+		if(XGetWindowAttributes(bench->display, children[i],
+					&attributes) == 0
+				|| attributes.map_state != IsViewable
+				|| XGetClassHint(bench->display, children[i],
+					&hint) == 0)
+			continue;
+		if(hint.res_name != NULL && strcmp(hint.res_name, name) == 0)
+			ret = children[i];
+		XFree(hint.res_name);
+		XFree(hint.res_class);
+	}
+	XFree(children);
+	return ret;
+}
+
+
+/* bench_memory */
+static void _bench_memory(Bench * bench)
+{
+	char * filename;
+	FILE * fp;
+	char buf[128];
+
+	filename = g_strdup_printf("/proc/%d/status", (int)bench->pid);
+	fp = fopen(filename, "r");
+	g_free(filename);
+	if(fp == NULL)
+		return;
+	while(fgets(buf, sizeof(buf), fp) != NULL)
+		if(sscanf(buf, "VmRSS: %lu", &bench->rss) != 1)
+			sscanf(buf, "VmHWM: %lu", &bench->hwm);
+	fclose(fp);
+}
+
+
+/* bench_print */
+static void _bench_print(Bench * bench)
+{
+	double elapsed = bench->elapsed / 1000000.0;
+
+	/* one JSON object per run */
+	printf("{ \"mode\": \"%s\", \"taps\": %u, \"received\": %u, "
+			"\"taps_per_second\": %.1f, \"latency_avg_ms\": %.3f, "
+			"\"latency_max_ms\": %.3f, \"mapped_ms\": %.3f, "
+			"\"rss_kb\": %lu, \"hwm_kb\": %lu }\n",
+			bench->embedded ? "embedded" : "popup", bench->count,
+			bench->received, (elapsed > 0.0)
+			? bench->received / elapsed : 0.0,
+			(bench->received > 0)
+			? bench->latency / 1000.0 / bench->received : 0.0,
+			bench->latency_max / 1000.0, bench->mapped / 1000.0,
+			bench->rss, bench->hwm);
+}
+
+
+/* bench_start */
+static int _bench_start(Bench * bench)
+{
+	char ** argv;
+	int i;
+	int fd = -1;
+	GError * error = NULL;
+	char buf[32];
+	ssize_t len;
+	gint64 start;
+	guint source = 0;
+
+	argv = g_new(char *, bench->arguments_cnt + 3);
+	argv[0] = (char *)bench->program;
+	argv[1] = bench->embedded ? "-x" : "-p";
+	for(i = 0; i < bench->arguments_cnt; i++)
+		argv[i + 2] = bench->arguments[i];
+	argv[i + 2] = NULL;
+	start = g_get_monotonic_time();
+	if(g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_SEARCH_PATH
+				| G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL,
+				&bench->pid, NULL, bench->embedded ? &fd : NULL,
+				NULL, &error) == FALSE)
+	{
+		_error(error->message, 1);
+		g_error_free(error);
+		g_free(argv);
+		return -1;
+	}
+	g_free(argv);
+	bench->done = FALSE;
+	if(bench->embedded)
+	{
+		/* the keyboard prints the ID of its window */
+		len = read(fd, buf, sizeof(buf) - 1);
+		close(fd);
+		if(len <= 0)
+			return -_error("Could not obtain the keyboard", 1);
+		buf[len] = '\0';
+		bench->keyboard = strtoul(buf, NULL, 10);
+		gtk_socket_add_id(GTK_SOCKET(bench->socket), bench->keyboard);
+	}
+	else
+		source = g_timeout_add(10, _bench_on_poll, bench);
+	if(_bench_wait(bench, BENCH_TIMEOUT_START) != 0)
+	{
+		if(source != 0)
+			g_source_remove(source);
+		return -_error("The keyboard did not show up", 1);
+	}
+	/* until the window is mapped, the first frame is drawn later */
+	bench->mapped = g_get_monotonic_time() - start;
+	/* let it settle */
+	while(gtk_events_pending())
+		gtk_main_iteration();
+	XSync(bench->display, False);
+	return 0;
+}
+
+
+/* bench_stop */
+static void _bench_stop(Bench * bench)
+{
+	if(bench->pid <= 0)
+		return;
+	kill(bench->pid, SIGTERM);
+	waitpid(bench->pid, NULL, 0);
+	g_spawn_close_pid(bench->pid);
+	bench->pid = 0;
+}
+
+
+/* bench_taps */
+static int _bench_taps(Bench * bench)
+{
+	Window probe;
+	Window child;
+	XWindowAttributes attributes;
+	int x;
+	int y;
+	unsigned int i;
+	gint64 start;
+	gint64 time;
+
+	probe = GDK_WINDOW_XID(gtk_widget_get_window(bench->probe));
+	if(XGetWindowAttributes(bench->display, bench->keyboard, &attributes)
+			== 0 || XTranslateCoordinates(bench->display,
+				bench->keyboard,
+				DefaultRootWindow(bench->display), 0, 0, &x,
+				&y, &child) == False)
+		return -_error("Could not locate the keyboard", 1);
+	y += attributes.height / (BENCH_ROWS * 2);
+	start = g_get_monotonic_time();
+	for(i = 0; i < bench->count; i++)
+	{
+		/* one key at a time, waiting for the probe to receive it */
+		XSetInputFocus(bench->display, probe, RevertToParent,
+				CurrentTime);
+		XTestFakeMotionEvent(bench->display, -1, x + attributes.width
+				* (2 * (i % BENCH_KEYS) + 1) / (2 * BENCH_KEYS),
+				y, 0);
+		XTestFakeButtonEvent(bench->display, 1, True, 0);
+		XTestFakeButtonEvent(bench->display, 1, False, 0);
+		XFlush(bench->display);
+		time = g_get_monotonic_time();
+		bench->done = FALSE;
+		if(_bench_wait(bench, BENCH_TIMEOUT_TAP) != 0)
+			continue;
+		time = g_get_monotonic_time() - time;
+		bench->latency += time;
+		if(time > bench->latency_max)
+			bench->latency_max = time;
+	}
+	bench->elapsed = g_get_monotonic_time() - start;
+	return 0;
+}
+
+
+/* bench_wait */
+static int _bench_wait(Bench * bench, unsigned int timeout)
+{
+	guint source;
+
+	bench->timeout = FALSE;
+	source = g_timeout_add(timeout, _bench_on_timeout, bench);
+	while(bench->done == FALSE && bench->timeout == FALSE)
+		gtk_main_iteration();
+	if(bench->timeout == FALSE)
+		g_source_remove(source);
+	return (bench->done == TRUE) ? 0 : -1;
+}
+
+
+/* error */
+static int _error(char const * message, int ret)
+{
+	fprintf(stderr, "%s: %s\n", PROGNAME_BENCH, message);
+	return ret;
+}
+
+
+/* usage */
+static int _usage(void)
+{
+	fprintf(stderr, "Usage: %s [-e|-p][-n count] [program [argument...]]\n"
+"  -e	Embed the keyboard\n"
+"  -p	Start the keyboard as a popup (default)\n"
+"  -n	Number of taps (default: %u)\n", PROGNAME_BENCH, BENCH_COUNT);
+	return 1;
+}
+
+
+/* callbacks */
+/* bench_on_key_press */
+static gboolean _bench_on_key_press(GtkWidget * widget, GdkEventKey * event,
+		gpointer data)
+{
+	Bench * bench = data;
+
+	bench->received++;
+	bench->done = TRUE;
+	return TRUE;
+}
+
+
+/* bench_on_plug_added */
+static void _bench_on_plug_added(GtkWidget * widget, gpointer data)
+{
+	Bench * bench = data;
+
+	bench->done = TRUE;
+}
+
+
+/* bench_on_poll */
+static gboolean _bench_on_poll(gpointer data)
+{
+	Bench * bench = data;
+
+	if((bench->keyboard = _bench_find(bench)) == None)
+		return TRUE;
+	bench->done = TRUE;
+	return FALSE;
+}
+
+
+/* bench_on_timeout */
+static gboolean _bench_on_timeout(gpointer data)
+{
+	Bench * bench = data;
+
+	bench->timeout = TRUE;
+	return FALSE;
+}
+
+
+/* public */
+/* functions */
+/* main */
+int main(int argc, char * argv[])
+{
+	int o;
+	Bench bench;
+	char * p;
+
+	memset(&bench, 0, sizeof(bench));
+	bench.program = "keyboard";
+	bench.count = BENCH_COUNT;
+	/* the results are always formatted the same */
+	gtk_disable_setlocale();
+	gtk_init(&argc, &argv);
+	while((o = getopt(argc, argv, "en:p")) != -1)
+		switch(o)
+		{
+			case 'e':
+				bench.embedded = TRUE;
+				break;
+			case 'n':
+				bench.count = strtoul(optarg, &p, 10);
+				if(optarg[0] == '\0' || *p != '\0'
+						|| bench.count == 0)
+					return _usage();
+				break;
+			case 'p':
+				bench.embedded = FALSE;
+				break;
+			default:
+				return _usage();
+		}
+	/* the additional arguments are passed on to the keyboard */
+	if(optind < argc)
+	{
+		bench.program = argv[optind];
+		bench.arguments = &argv[optind + 1];
+		bench.arguments_cnt = argc - optind - 1;
+	}
+	return (_bench(&bench) == 0) ? 0 : 2;
+}
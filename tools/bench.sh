@@ -0,0 +1,118 @@
+#!/bin/sh
+#$Id$
+#Copyright (c) 2026 Pierre Pronchery <khorben@defora.org>
+#This file is part of DeforaOS Desktop Keyboard
+#This program is free software: you can redistribute it and/or modify
+#it under the terms of the GNU General Public License as published by
+#the Free Software Foundation, version 3 of the License.
+#
+#This program is distributed in the hope that it will be useful,
+#but WITHOUT ANY WARRANTY; without even the implied warranty of
+#MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#GNU General Public License for more details.
+#
+#You should have received a copy of the GNU General Public License
+#along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#variables
+COUNT=200
+DISPLAYNUM=":99"
+MODES="embedded popup"
+PROGNAME="bench.sh"
+#executables
+BENCH="${0%/bench.sh}/bench"
+KEYBOARD="${0%/bench.sh}/../src/keyboard"
+XVFB="Xvfb"
+
+
+#functions
+#bench
+_bench()
+{
+	ret=0
+
+	#start a private X server
+	$XVFB "$DISPLAYNUM" -screen 0 1024x768x24 -nolisten tcp \
+		> /dev/null 2>&1 &
+	xvfb=$!
+	i=0
+	while [ ! -S "/tmp/.X11-unix/X${DISPLAYNUM#:}" ]; do
+		if [ $i -ge 50 ] || ! kill -0 $xvfb 2> /dev/null; then
+			_error "Could not start $XVFB"
+			kill $xvfb 2> /dev/null
+			return 2
+		fi
+		sleep 0.1
+		i=$((i + 1))
+	done
+
+	#one JSON object per mode
+	for mode in $MODES; do
+		case "$mode" in
+			embedded)
+				option="-e"
+				;;
+			popup)
+				option="-p"
+				;;
+			*)
+				_error "$mode: Unknown mode"
+				ret=2
+				continue
+				;;
+		esac
+		DISPLAY="$DISPLAYNUM" "$BENCH" $option -n "$COUNT" -- \
+			"$KEYBOARD" "$@" || ret=2
+	done
+	kill $xvfb
+	wait $xvfb 2> /dev/null
+	return $ret
+}
+
+
+#error
+_error()
+{
+	echo "$PROGNAME: $@" 1>&2
+	return 2
+}
+
+
+#usage
+_usage()
+{
+	echo "Usage: $PROGNAME [-D display][-k keyboard][-m modes][-n count] [argument...]" 1>&2
+	echo "  -D	X display to run on (default: $DISPLAYNUM)" 1>&2
+	echo "  -k	Keyboard program to measure" 1>&2
+	echo "  -m	Modes to measure (default: \"$MODES\")" 1>&2
+	echo "  -n	Number of taps for every mode (default: $COUNT)" 1>&2
+	return 1
+}
+
+
+#main
+while getopts "D:k:m:n:" name; do
+	case "$name" in
+		D)
+			DISPLAYNUM="$OPTARG"
+			;;
+		k)
+			KEYBOARD="$OPTARG"
+			;;
+		m)
+			MODES="$OPTARG"
+			;;
+		n)
+			COUNT="$OPTARG"
+			;;
+		?)
+			_usage
+			exit $?
+			;;
+	esac
+done
+shift $((OPTIND - 1))
+
+_bench "$@"
@@ -0,0 +1,116 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include "../src/dictionary.c"
+
+
+/* private */
+/* prototypes */
+static int _dictionary_compile(char const * source, char const * filename);
+static int _dictionary_lookup(char const * filename, int argc,
+		char * argv[]);
+
+static int _usage(void);
+
+
+/* functions */
+/* dictionary_compile */
+static int _dictionary_compile(char const * source, char const * filename)
+{
+	if(keyboard_dictionary_compile(source, filename) != 0)
+		return -1;
+	return 0;
+}
+
+
+/* dictionary_lookup */
+static int _dictionary_lookup(char const * filename, int argc,
+		char * argv[])
+{
+	KeyboardDictionary * dictionary;
+	char words[KEYBOARD_DICTIONARY_TOP][KEYBOARD_DICTIONARY_WORD];
+	uint32_t cursor;
+	char const * p;
+	size_t cnt;
+	size_t i;
+	int j;
+
+	if((dictionary = keyboard_dictionary_new_from_file(filename)) == NULL)
+		return -1;
+	for(j = 0; j < argc; j++)
+	{
+		/* as when typing, one byte at a time */
+		cursor = KEYBOARD_DICTIONARY_ROOT;
+		for(p = argv[j]; *p != '\0'; p++)
+			cursor = keyboard_dictionary_next(dictionary, cursor,
+					*p);
+		cnt = keyboard_dictionary_complete(dictionary, cursor, words);
+		printf("%s:", argv[j]);
+		for(i = 0; i < cnt; i++)
+			printf(" %s", words[i]);
+		putchar('\n');
+	}
+	keyboard_dictionary_delete(dictionary);
+	return 0;
+}
+
+
+/* usage */
+static int _usage(void)
+{
+	fputs("Usage: dictionary -c source filename\n"
+"       dictionary -l filename prefix...\n"
+"  -c	Compile a list of words, one per line with an optional frequency\n"
+"  -l	Look the completions of prefixes up\n", stderr);
+	return 1;
+}
+
+
+/* public */
+/* functions */
+/* main */
+int main(int argc, char * argv[])
+{
+	int o;
+	int lookup = -1;
+
+	while((o = getopt(argc, argv, "cl")) != -1)
+		switch(o)
+		{
+			case 'c':
+				lookup = 0;
+				break;
+			case 'l':
+				lookup = 1;
+				break;
+			default:
+				return _usage();
+		}
+	if(lookup == 1 && optind + 1 < argc)
+		o = _dictionary_lookup(argv[optind], argc - optind - 1,
+				&argv[optind + 1]);
+	else if(lookup == 0 && optind + 2 == argc)
+		o = _dictionary_compile(argv[optind], argv[optind + 1]);
+	else
+		return _usage();
+	if(o != 0)
+		error_print("dictionary");
+	return (o == 0) ? 0 : 2;
+}
@@ -0,0 +1,204 @@
+/* $Id$ */
+/* Copyright (c) 2026 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop Keyboard */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+
+
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include "../src/common.c"
+#include "../src/definition.c"
+
+
+/* private */
+/* types */
+typedef KeyboardDefinition * (*LayoutLoader)(char const * name);
+
+
+/* prototypes */
+static int _layout_benchmark(char const * source, unsigned int count);
+static int _layout_compile(char const * source, char const * filename);
+
+static int _usage(void);
+
+
+/* functions */
+/* layout_benchmark */
+static int _benchmark_compile(char const * source, char const * filename,
+		unsigned int count);
+static int _benchmark_load(char const * what, LayoutLoader loader,
+		char const * name, unsigned int count);
+static void _benchmark_print(char const * what, gint64 first, gint64 total,
+		unsigned int count);
+
+static int _layout_benchmark(char const * source, unsigned int count)
+{
+	int ret = 0;
+	char * filename;
+	char * name;
+
+	filename = g_strdup_printf("%s/layout-%u%s", g_get_tmp_dir(),
+			(unsigned)getpid(), KEYBOARD_DEFINITION_CACHE);
+	/* the built-in layout of the same name if any */
+	name = g_path_get_basename(source);
+	if(g_str_has_suffix(name, KEYBOARD_DEFINITION_SOURCE))
+		name[strlen(name) - strlen(KEYBOARD_DEFINITION_SOURCE)] = '\0';
+	if(_benchmark_load("built-in", keyboard_definition_new_builtin, name,
+				count) != 0)
+		error_print("layout");
+	if((ret = _benchmark_compile(source, filename, count)) == 0)
+		ret = _benchmark_load("compiled",
+				keyboard_definition_new_from_file, filename,
+				count);
+	unlink(filename);
+	g_free(name);
+	g_free(filename);
+	return ret;
+}
+
+static int _benchmark_compile(char const * source, char const * filename,
+		unsigned int count)
+{
+	unsigned int i;
+	gint64 first = 0;
+	gint64 total = 0;
+	gint64 time;
+
+	for(i = 0; i < count; i++)
+	{
+		time = g_get_monotonic_time();
+		if(keyboard_definition_compile(source, filename) != 0)
+			return -1;
+		time = g_get_monotonic_time() - time;
+		if(i == 0)
+			first = time;
+		total += time;
+	}
+	_benchmark_print("text", first, total, count);
+	return 0;
+}
+
+static int _benchmark_load(char const * what, LayoutLoader loader,
+		char const * name, unsigned int count)
+{
+	KeyboardDefinition * definition;
+	KeyboardKeyDefinition const * keys;
+	unsigned int i;
+	size_t j;
+	size_t k;
+	size_t len = 0;
+	gint64 first = 0;
+	gint64 total = 0;
+	gint64 time;
+
+	for(i = 0; i < count; i++)
+	{
+		time = g_get_monotonic_time();
+		if((definition = loader(name)) == NULL)
+			return -1;
+		/* go through every key as when building the pages */
+		for(j = 0; j < KLS_COUNT; j++)
+			if((keys = keyboard_definition_get_keys(definition, j))
+					!= NULL)
+				for(k = 0; keys[k].width != 0
+						|| keys[k].modifier != 0; k++)
+					if(keys[k].label != NULL)
+						len += strlen(keys[k].label);
+		keyboard_definition_delete(definition);
+		time = g_get_monotonic_time() - time;
+		if(i == 0)
+			first = time;
+		total += time;
+	}
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s() %lu bytes of labels\n", __func__,
+			(unsigned long)len);
+#endif
+	_benchmark_print(what, first, total, count);
+	return 0;
+}
+
+static void _benchmark_print(char const * what, gint64 first, gint64 total,
+		unsigned int count)
+{
+	/* the first iteration is the closest to a cold startup */
+	printf("%s: first %.3f ms, average %.3f ms (%u runs)\n", what,
+			first / 1000.0, total / 1000.0 / count, count);
+}
+
+
+/* layout_compile */
+static int _layout_compile(char const * source, char const * filename)
+{
+	if(keyboard_definition_compile(source, filename) != 0)
+		return -1;
+	return 0;
+}
+
+
+/* usage */
+static int _usage(void)
+{
+	fputs("Usage: layout -c source filename\n"
+"       layout -b [-n count] source\n"
+"  -c	Compile a layout\n"
+"  -b	Benchmark the built-in, text and compiled forms of a layout\n"
+"  -n	Number of iterations (default: 1000)\n", stderr);
+	return 1;
+}
+
+
+/* public */
+/* functions */
+/* main */
+int main(int argc, char * argv[])
+{
+	int o;
+	int benchmark = -1;
+	unsigned int count = 1000;
+	char * p;
+
+	while((o = getopt(argc, argv, "bcn:")) != -1)
+		switch(o)
+		{
+			case 'b':
+				benchmark = 1;
+				break;
+			case 'c':
+				benchmark = 0;
+				break;
+			case 'n':
+				count = strtoul(optarg, &p, 10);
+				if(optarg[0] == '\0' || *p != '\0' || count == 0)
+					return _usage();
+				break;
+			default:
+				return _usage();
+		}
+	if(benchmark == 1 && optind + 1 == argc)
+		o = _layout_benchmark(argv[optind], count);
+	else if(benchmark == 0 && optind + 2 == argc)
+		o = _layout_compile(argv[optind], argv[optind + 1]);
+	else
+		return _usage();
+	if(o != 0)
+		error_print("layout");
+	return (o == 0) ? 0 : 2;
+}
@@ -1,5 +1,5 @@
 /* $Id$ */
-/* Copyright (c) 2012 Pierre Pronchery <khorben@defora.org> */
+/* Copyright (c) 2012-2026 Pierre Pronchery <khorben@defora.org> */
 /* This file is part of DeforaOS Desktop Keyboard */
 /* This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -15,19 +15,294 @@
 
 
 
+#include <sys/select.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <gtk/gtk.h>
+#include <X11/Xlib.h>
+#include <X11/Xproto.h>
+#include <X11/extensions/record.h>
+#include "../src/backend.c"
+
+
+/* constants */
+#define PROGNAME_SNOOPER	"snooper"
+
+#define SNOOPER_MAGIC		"KbdR"
+#define SNOOPER_VERSION		1
+
+
+/* types */
+/* the log starts with a header, followed by the events */
+typedef struct _SnooperHeader
+{
+	char magic[4];
+	uint32_t version;
+} SnooperHeader;
+
+typedef struct _SnooperEvent
+{
+	uint32_t time;			/* in ms, since the first event */
+	uint8_t keycode;
+	uint8_t pressed;
+	uint8_t padding[2];
+} SnooperEvent;
+
+typedef struct _SnooperRecord
+{
+	FILE * fp;
+	char const * filename;
+	unsigned long count;
+	Time first;
+	int error;
+} SnooperRecord;
+
+
+/* variables */
+static volatile sig_atomic_t _snooper_stop = 0;
 
 
 /* prototypes */
+static int _snooper(void);
+static int _snooper_record(char const * filename);
+static int _snooper_replay(char const * filename, char const * name,
+		int fast);
+
+static int _error(char const * message, int ret);
+static int _usage(void);
+
 /* callbacks */
 static gint _snooper_on_key_snoop(GtkWidget * grab, GdkEventKey * event,
 		gpointer data);
+static void _snooper_on_record(XPointer data, XRecordInterceptData * record);
+static void _snooper_on_signal(int signum);
 
 
 /* functions */
+/* snooper */
+static int _snooper(void)
+{
+	guint id;
+
+	id = gtk_key_snooper_install(_snooper_on_key_snoop, NULL);
+	gtk_main();
+	gtk_key_snooper_remove(id);
+	return 0;
+}
+
+
+/* snooper_record */
+static int _snooper_record(char const * filename)
+{
+	SnooperRecord record;
+	SnooperHeader header;
+	Display * control;
+	Display * data;
+	int major;
+	int minor;
+	XRecordRange * range;
+	XRecordClientSpec clients = XRecordAllClients;
+	XRecordContext context;
+	fd_set rfds;
+	struct timeval tv;
+	int fd;
+
+	/* the keystrokes are only for the user to read */
+	if((fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0)
+		return -_error(filename, 1);
+	if(fchmod(fd, 0600) != 0 || (record.fp = fdopen(fd, "wb")) == NULL)
+	{
+		close(fd);
+		return -_error(filename, 1);
+	}
+	record.filename = filename;
+	record.count = 0;
+	record.first = 0;
+	record.error = 0;
+	memcpy(header.magic, SNOOPER_MAGIC, sizeof(header.magic));
+	header.version = SNOOPER_VERSION;
+	if(fwrite(&header, sizeof(header), 1, record.fp) != 1)
+	{
+		fclose(record.fp);
+		return -_error(filename, 1);
+	}
+	/* the events are received on a connection of their own */
+	if((control = XOpenDisplay(NULL)) == NULL
+			|| (data = XOpenDisplay(NULL)) == NULL)
+	{
+		if(control != NULL)
+			XCloseDisplay(control);
+		fclose(record.fp);
+		fprintf(stderr, "%s: %s\n", PROGNAME_SNOOPER,
+				"Could not open the display");
+		return -1;
+	}
+	if(!XRecordQueryVersion(control, &major, &minor)
+			|| (range = XRecordAllocRange()) == NULL)
+	{
+		XCloseDisplay(data);
+		XCloseDisplay(control);
+		fclose(record.fp);
+		fprintf(stderr, "%s: %s\n", PROGNAME_SNOOPER,
+				"The RECORD extension is not available");
+		return -1;
+	}
+	range->device_events.first = KeyPress;
+	range->device_events.last = KeyRelease;
+	context = XRecordCreateContext(control, 0, &clients, 1, &range, 1);
+	XFree(range);
+	XSync(control, False);
+	if(context == 0 || !XRecordEnableContextAsync(data, context,
+				_snooper_on_record, (XPointer)&record))
+	{
+		if(context != 0)
+			XRecordFreeContext(control, context);
+		XCloseDisplay(data);
+		XCloseDisplay(control);
+		fclose(record.fp);
+		fprintf(stderr, "%s: %s\n", PROGNAME_SNOOPER,
+				"Could not record the events");
+		return -1;
+	}
+	signal(SIGINT, _snooper_on_signal);
+	signal(SIGTERM, _snooper_on_signal);
+	/* until interrupted */
+	while(!_snooper_stop && record.error == 0)
+	{
+		XRecordProcessReplies(data);
+		FD_ZERO(&rfds);
+		FD_SET(ConnectionNumber(data), &rfds);
+		tv.tv_sec = 0;
+		tv.tv_usec = 100000;
+		if(select(ConnectionNumber(data) + 1, &rfds, NULL, NULL, &tv)
+				< 0 && errno != EINTR)
+			break;
+	}
+	XRecordDisableContext(control, context);
+	XRecordFreeContext(control, context);
+	XSync(control, False);
+	XRecordProcessReplies(data);
+	XCloseDisplay(data);
+	XCloseDisplay(control);
+	if(fclose(record.fp) != 0 && record.error == 0)
+		record.error = -_error(filename, 1);
+	fprintf(stderr, "%s: %s: %lu events recorded\n", PROGNAME_SNOOPER,
+			filename, record.count);
+	return record.error;
+}
+
+
+/* snooper_replay */
+static int _snooper_replay(char const * filename, char const * name,
+		int fast)
+{
+	int ret = 0;
+	FILE * fp;
+	SnooperHeader header;
+	SnooperEvent event;
+	KeyboardBackend * backend;
+	uint32_t held[256 / 32];
+	unsigned long count = 0;
+	gint64 start;
+	gint64 late = 0;
+	gint64 t;
+	double elapsed;
+	size_t i;
+
+	if((fp = fopen(filename, "rb")) == NULL)
+		return -_error(filename, 1);
+	if(fread(&header, sizeof(header), 1, fp) != 1
+			|| memcmp(header.magic, SNOOPER_MAGIC,
+				sizeof(header.magic)) != 0
+			|| header.version != SNOOPER_VERSION)
+	{
+		fclose(fp);
+		fprintf(stderr, "%s: %s: %s\n", PROGNAME_SNOOPER, filename,
+				"Invalid log");
+		return -1;
+	}
+	if((backend = keyboard_backend_new(name)) == NULL)
+	{
+		fclose(fp);
+		error_print(PROGNAME_SNOOPER);
+		return -1;
+	}
+	memset(held, 0, sizeof(held));
+	start = g_get_monotonic_time();
+	while(ret == 0 && fread(&event, sizeof(event), 1, fp) == 1)
+	{
+		/* as recorded, unless as fast as possible */
+		t = start + (gint64)event.time * 1000;
+		if(!fast && t > g_get_monotonic_time())
+			g_usleep(t - g_get_monotonic_time());
+		if(event.pressed)
+			ret = keyboard_backend_press(backend, event.keycode);
+		else
+			ret = keyboard_backend_release(backend, event.keycode);
+		if(ret == 0)
+			ret = keyboard_backend_flush(backend);
+		if(!fast && (t = g_get_monotonic_time() - t) > late)
+			late = t;
+		if(event.pressed)
+			held[event.keycode / 32] |= (uint32_t)1
+				<< (event.keycode % 32);
+		else
+			held[event.keycode / 32] &= ~((uint32_t)1
+					<< (event.keycode % 32));
+		count++;
+	}
+	elapsed = (g_get_monotonic_time() - start) / 1000000.0;
+	if(ret != 0)
+		error_print(PROGNAME_SNOOPER);
+	else if(ferror(fp))
+		ret = -_error(filename, 1);
+	fclose(fp);
+	/* the recording may have stopped with keys still held */
+	for(i = 0; i < 256; i++)
+		if(held[i / 32] & ((uint32_t)1 << (i % 32)))
+			keyboard_backend_release(backend, i);
+	keyboard_backend_flush(backend);
+	keyboard_backend_delete(backend);
+	printf("{ \"backend\": \"%s\", \"events\": %lu, \"seconds\": %.3f, "
+			"\"events_per_second\": %.1f, "
+			"\"late_max_ms\": %.3f }\n",
+			(name != NULL) ? name : "xtest", count, elapsed,
+			(elapsed > 0.0) ? count / elapsed : 0.0,
+			late / 1000.0);
+	return ret;
+}
+
+
+/* error */
+static int _error(char const * message, int ret)
+{
+	fputs(PROGNAME_SNOOPER ": ", stderr);
+	perror(message);
+	return ret;
+}
+
+
+/* usage */
+static int _usage(void)
+{
+	fputs("Usage: " PROGNAME_SNOOPER " [-o log]\n"
+"       " PROGNAME_SNOOPER " -r log [-f][-i backend]\n"
+"  -o	Record the keys pressed and released, until interrupted\n"
+"  -r	Replay the keys recorded, through a backend of the keyboard\n"
+"  -f	Replay as fast as possible\n"
+"  -i	Select the backend injecting the keys (xtest, uinput, null)\n",
+			stderr);
+	return 1;
+}
+
+
 /* callbacks */
 /* snooper_on_key_snoop */
 static gint _snooper_on_key_snoop(GtkWidget * grab, GdkEventKey * event,
@@ -40,11 +315,37 @@ static gint _snooper_on_key_snoop(GtkWidget * grab, GdkEventKey * event,
 }
 
 
-/* usage */
-static int _usage(void)
+/* snooper_on_record */
+static void _snooper_on_record(XPointer data, XRecordInterceptData * record)
 {
-	fputs("Usage: snooper\n", stderr);
-	return 1;
+	SnooperRecord * r = (SnooperRecord *)data;
+	xEvent const * xevent;
+	SnooperEvent event;
+
+	if(record->category != XRecordFromServer || r->error != 0)
+	{
+		XRecordFreeData(record);
+		return;
+	}
+	xevent = (xEvent const *)record->data;
+	if(r->count == 0)
+		r->first = record->server_time;
+	memset(&event, 0, sizeof(event));
+	event.time = record->server_time - r->first;
+	event.keycode = xevent->u.u.detail;
+	event.pressed = (xevent->u.u.type == KeyPress) ? 1 : 0;
+	XRecordFreeData(record);
+	if(fwrite(&event, sizeof(event), 1, r->fp) != 1)
+		r->error = -_error(r->filename, 1);
+	else
+		r->count++;
+}
+
+
+/* snooper_on_signal */
+static void _snooper_on_signal(int signum)
+{
+	_snooper_stop = 1;
 }
 
 
@@ -52,19 +353,38 @@ static int _usage(void)
 int main(int argc, char * argv[])
 {
 	int o;
-	guint id;
+	char const * output = NULL;
+	char const * replay = NULL;
+	char const * backend = NULL;
+	int fast = 0;
 
 	gtk_init(&argc, &argv);
-	while((o = getopt(argc, argv, "")) != -1)
+	while((o = getopt(argc, argv, "fi:o:r:")) != -1)
 		switch(o)
 		{
+			case 'f':
+				fast = 1;
+				break;
+			case 'i':
+				backend = optarg;
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			case 'r':
+				replay = optarg;
+				break;
 			default:
 				return _usage();
 		}
-	if(optind != argc)
+	if(optind != argc || (output != NULL && replay != NULL)
+			|| (replay == NULL && (fast || backend != NULL)))
 		return _usage();
-	id = gtk_key_snooper_install(_snooper_on_key_snoop, NULL);
-	gtk_main();
-	gtk_key_snooper_remove(id);
-	return 0;
+	if(output != NULL)
+		o = _snooper_record(output);
+	else if(replay != NULL)
+		o = _snooper_replay(replay, backend, fast);
+	else
+		o = _snooper();
+	return (o == 0) ? 0 : 2;
 }